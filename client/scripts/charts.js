@@ -15,89 +15,232 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+/*
+ * Fixed size history of wind samples in typed arrays, oldest sample is overwritten.
+ */
+class WindHistory {
+  constructor(capacity) {
+    this.capacity = capacity;
+    this.time = new Float64Array(capacity);
+    this.speed = new Float64Array(capacity);
+    this.cross = new Float64Array(capacity);
+    // Index of next write and number of valid samples
+    this.head = 0;
+    this.length = 0;
+  }
+
+  // Append count samples of stride 3 (time, speed, cross) from chunk
+  Append(chunk, count) {
+    for (let i = 0; i < count; i += 1) {
+      const o = i * 3;
+      this.time[this.head] = chunk[o];
+      this.speed[this.head] = Math.abs(chunk[o + 1]);
+      this.cross[this.head] = Math.abs(chunk[o + 2]);
+      this.head = (this.head + 1) % this.capacity;
+    }
+    this.length = Math.min(this.length + count, this.capacity);
+  }
+
+  // Ring index of i-th sample, 0 is oldest
+  Index(i) {
+    return (this.head - this.length + i + this.capacity) % this.capacity;
+  }
+
+  // Position of first sample at or after time t, binary search
+  LowerBound(t) {
+    let lo = 0;
+    let hi = this.length;
+    while (lo < hi) {
+      const mid = (lo + hi) >>> 1;
+      if (this.time[this.Index(mid)] < t) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+}
+
 class WindspeedChart {
-  constructor(element, windspeed, crosswind) {
+  constructor(element, capacity) {
     // DOM element id where chart is plotted in
     this.element = element;
-    // Add first data pair
-    this.windSpeedData = [
-      {
-        date: new Date(),
-        speed: windspeed,
-        cross: crosswind
-      }
-    ];
-    // Accessor that creates min and max values from date in data
-    this.xExtent = fc.extentDate().accessors([(d) => d.date]);
+    this.history = new WindHistory(capacity);
+    // Visible time span [s]
+    this.span = 60;
+    // Plot area width in pixel, one min/max pair per pixel column is drawn
+    this.width = 1000;
+    this.dirty = true;
+    // Decimated plot points, reused every frame
+    this.plotTime = new Float64Array(4 * 4096);
+    this.plotSpeed = new Float64Array(4 * 4096);
+    this.plotCross = new Float64Array(4 * 4096);
+    // Data joined to the chart are indices into the plot arrays
+    this.points = [];
+    // Compliance limits [kts], same defaults as the server
+    this.windLimit = 10;
+    this.crossWindLimit = 5;
     // Windspeed as line series
     this.windSpeed = fc
-      .seriesSvgLine()
-      .mainValue((d) => d.speed)
-      .crossValue((d) => d.date)
-      .decorate((sel) => sel.enter().attr('style', 'stroke: red !important; stroke-width: 2px;'));
+      .seriesCanvasLine()
+      .mainValue((i) => this.plotSpeed[i])
+      .crossValue((i) => this.plotTime[i])
+      .decorate((context) => {
+        context.strokeStyle = 'red';
+        context.lineWidth = 2;
+      });
 
     this.crossWindSpeed = fc
-      .seriesSvgLine()
-      .mainValue((d) => d.cross)
-      .crossValue((d) => d.date)
-      .decorate((sel) => sel.enter().attr('style', 'stroke: blue !important; stroke-width: 2px;'));
+      .seriesCanvasLine()
+      .mainValue((i) => this.plotCross[i])
+      .crossValue((i) => this.plotTime[i])
+      .decorate((context) => {
+        context.strokeStyle = 'blue';
+        context.lineWidth = 2;
+      });
     // Grid lines
-    this.windSpeedGridLines = fc
-      .annotationSvgGridline()
-      .yTicks(15)
-      .xTicks(12)
-      .xDecorate((sel) => sel.enter().classed('xWindSpeedGridLines', true))
-      .yDecorate((sel) => sel.enter().classed('yWindSpeedGridLines', true));
+    this.windSpeedGridLines = fc.annotationCanvasGridline().yTicks(15).xTicks(12);
     // Cross wind limit line
-    this.crossWindLimit = fc
-      .annotationSvgLine()
-      .orient('horizontal')
-      .value(5)
-      .decorate((sel) =>
-        sel.enter().attr('style', 'stroke: blue !important; stroke-width: 2px; stroke-dasharray: 5,5;')
-      );
+    this.crossWindLimitLine = fc
+      .annotationCanvasLine()
+      .label(() => '')
+      .decorate((context) => {
+        context.strokeStyle = 'blue';
+        context.lineWidth = 2;
+        context.setLineDash([5, 5]);
+      });
     // Total wind limit line
-    this.totalWindLimit = fc
-      .annotationSvgLine()
-      .orient('horizontal')
-      .value(10)
-      .decorate((sel) =>
-        sel.enter().attr('style', 'stroke: red !important; stroke-width: 2px; stroke-dasharray: 5,5;')
-      );
-    // Combine all chart elements in multi series
+    this.totalWindLimitLine = fc
+      .annotationCanvasLine()
+      .label(() => '')
+      .decorate((context) => {
+        context.strokeStyle = 'red';
+        context.lineWidth = 2;
+        context.setLineDash([5, 5]);
+      });
+    // Combine all chart elements in multi series, limit lines get their value as data
     this.multiWindSpeedSeries = fc
-      .seriesSvgMulti()
-      .series([this.windSpeedGridLines, this.windSpeed, this.crossWindSpeed, this.crossWindLimit, this.totalWindLimit]);
-    // Define windspeed chart
+      .seriesCanvasMulti()
+      .series([
+        this.windSpeedGridLines,
+        this.windSpeed,
+        this.crossWindSpeed,
+        this.crossWindLimitLine,
+        this.totalWindLimitLine
+      ])
+      .mapping((data, index, series) => {
+        switch (series[index]) {
+          case this.crossWindLimitLine:
+            return [this.crossWindLimit];
+          case this.totalWindLimitLine:
+            return [this.windLimit];
+          default:
+            return data;
+        }
+      });
+    // Define windspeed chart, time axis in seconds
     this.windSpeedChart = fc
-      .chartCartesian(d3.scaleTime(), d3.scaleLinear())
+      .chartCartesian(d3.scaleLinear(), d3.scaleLinear())
       .yOrient('right')
       .yDomain([0, 15])
-      .xDomain(this.xExtent(this.windSpeedData))
-      .svgPlotArea(this.multiWindSpeedSeries)
+      .xDomain([-this.span, 0])
+      .canvasPlotArea(this.multiWindSpeedSeries)
       .xLabel('Time [s]')
       .yLabel('Windspeed [kts]')
-      .xTickFormat(d3.timeFormat('%S'))
-      .yTicks(15);
-    // Draw windspeed chart first time
-    this.windSpeedChart.xDomain(this.xExtent(this.windSpeedData));
-    d3.select(this.element).datum(this.windSpeedData).call(this.windSpeedChart);
+      .yTicks(15)
+      .decorate((selection) => {
+        selection.select('.plot-area').on('measure.windspeed', (event) => {
+          this.width = Math.max(1, Math.min(4096, Math.floor(event.detail.width)));
+          this.dirty = true;
+        });
+      });
+    this.SetSpan(this.span);
   }
 
-  // Update windspeed chart with new value
-  Update(windspeed, crosswind) {
-    this.windSpeedData.push({
-      date: new Date(),
-      speed: windspeed,
-      cross: crosswind
-    });
-    // Keep only last 60s of windspeed data
-    if (this.windSpeedData.length > 60) {
-      this.windSpeedData.shift();
+  // Append samples received from communication worker
+  Append(chunk, count) {
+    if (count > 0) {
+      this.history.Append(chunk, count);
+      this.dirty = true;
     }
+  }
 
-    this.windSpeedChart.xDomain(this.xExtent(this.windSpeedData));
-    d3.select(this.element).datum(this.windSpeedData).call(this.windSpeedChart);
+  // Change visible time span [s]
+  SetSpan(span) {
+    this.span = span;
+    if (span > 60) {
+      this.windSpeedChart.xLabel('Time [min]').xTickFormat((t) => (t / 60).toFixed(0));
+    } else {
+      this.windSpeedChart.xLabel('Time [s]').xTickFormat((t) => t.toFixed(0));
+    }
+    this.dirty = true;
+  }
+
+  // Reduce visible samples to min and max per pixel column, time relative to newest sample
+  Decimate() {
+    const h = this.history;
+    this.points.length = 0;
+    if (h.length === 0) {
+      return;
+    }
+    const now = h.time[h.Index(h.length - 1)];
+    const start = h.LowerBound(now - this.span);
+    const visible = h.length - start;
+    let n = 0;
+    if (visible <= 2 * this.width) {
+      for (let i = start; i < h.length; i += 1) {
+        const k = h.Index(i);
+        this.plotTime[n] = h.time[k] - now;
+        this.plotSpeed[n] = h.speed[k];
+        this.plotCross[n] = h.cross[k];
+        n += 1;
+      }
+    } else {
+      const bucket = this.span / this.width;
+      let i = start;
+      while (i < h.length) {
+        let k = h.Index(i);
+        // End of pixel column holding this sample, empty columns are skipped
+        const end = now - this.span + (Math.floor((h.time[k] - now + this.span) / bucket) + 1) * bucket;
+        let speedMin = h.speed[k];
+        let speedMax = speedMin;
+        let crossMin = h.cross[k];
+        let crossMax = crossMin;
+        const t = h.time[k] - now;
+        for (i += 1; i < h.length; i += 1) {
+          k = h.Index(i);
+          if (h.time[k] > end) {
+            break;
+          }
+          speedMin = Math.min(speedMin, h.speed[k]);
+          speedMax = Math.max(speedMax, h.speed[k]);
+          crossMin = Math.min(crossMin, h.cross[k]);
+          crossMax = Math.max(crossMax, h.cross[k]);
+        }
+        this.plotTime[n] = t;
+        this.plotSpeed[n] = speedMin;
+        this.plotCross[n] = crossMin;
+        this.plotTime[n + 1] = t;
+        this.plotSpeed[n + 1] = speedMax;
+        this.plotCross[n + 1] = crossMax;
+        n += 2;
+      }
+    }
+    for (let i = 0; i < n; i += 1) {
+      this.points.push(i);
+    }
+  }
+
+  // Redraw chart if new samples arrived, called once per animation frame
+  Render() {
+    if (!this.dirty) {
+      return;
+    }
+    this.dirty = false;
+    this.Decimate();
+    this.windSpeedChart.xDomain([-this.span, 0]);
+    d3.select(this.element).datum(this.points).call(this.windSpeedChart);
   }
 }
 
@@ -25,47 +25,62 @@ const ServerCmd = Object.freeze({
   TimeSync: 0x6f
 });
 
+/* Events pushed by server, same as in meteoserver.h. */
+const ServerEvent = Object.freeze({
+  Compliance: 0x81,
+  Summary: 0x82
+});
+
+importScripts('packet.js');
+
 /*
- * Data received from meteo websocket server.
+ * Data received from meteo websocket server, layout generated from server/schema.h.
  */
-const serverData = Object.seal({
-  recordStatus: 0,
-  localTime: 0,
-  maws_second: 0,
-  maws_minute: 0,
-  maws_hour: 0,
-  day: 0,
-  month: 0,
-  year: 0,
-  topNumber: 0,
-  flightNumber: 0,
-  gpsStatus: 0,
-  gpsMode: 0,
-  gpsSatellitesVisible: 0,
-  gpsSatellitesUsed: 0,
-  gpsTime: 0,
-  gpsHDOP: 0,
-  gpsPDOP: 0,
-  gpsLat: 0,
-  gpsLon: 0,
-  gpsAltMsl: 0,
-  runwayElevation: 0,
-  runwayHeading: 0,
-  fromToStatus: 0,
-  temperature: 0,
-  humidity: 0,
-  baroPressure: 0,
-  windDirection: 0,
-  windDirectionMean: 0,
-  windspeed: 0,
-  windspeedMean: 0,
-  crossWindspeed: 0,
-  crossWindspeedMean: 0,
-  headWindspeed: 0,
-  QFE: 0,
-  QNH: 0,
-  barometerHeight: 0
-});
+const serverData = Object.seal(createPacket());
+
+/*
+ * Wind history samples are batched in Float64Array chunks of SAMPLE_STRIDE values
+ * per packet: local time [s], mean wind speed [kts] and cross wind speed [kts].
+ * A chunk is transferred to the main thread once per animation frame and handed
+ * back with the 'ready' command, so no garbage is produced at full packet rate.
+ */
+const SAMPLE_STRIDE = 3;
+const CHUNK_SAMPLES = 4096;
+const freeChunks = [];
+let chunk = null;
+let chunkCount = 0;
+/* Main thread has drawn the last frame and waits for data */
+let mainReady = true;
+
+/*
+ * Append wind sample of last decoded packet to current chunk.
+ */
+function appendSample() {
+  if (chunk === null) {
+    chunk = freeChunks.pop() || new Float64Array(CHUNK_SAMPLES * SAMPLE_STRIDE);
+    chunkCount = 0;
+  }
+  if (chunkCount === CHUNK_SAMPLES) {
+    /* Main thread stalled, drop oldest sample */
+    chunk.copyWithin(0, SAMPLE_STRIDE);
+    chunkCount -= 1;
+  }
+  const o = chunkCount * SAMPLE_STRIDE;
+  chunk[o] = serverData.localTime;
+  chunk[o + 1] = serverData.windspeedMean;
+  chunk[o + 2] = serverData.crossWindspeed;
+  chunkCount += 1;
+}
+
+/*
+ * Send latest packet and pending samples for the next frame.
+ */
+function flushSamples() {
+  self.postMessage({ cmd: 'data', data: serverData, samples: chunk, count: chunkCount }, [chunk.buffer]);
+  chunk = null;
+  chunkCount = 0;
+  mainReady = false;
+}
 
 /*
  * Websocket for server communication.
@@ -110,41 +125,30 @@ function connect8080() {
     } else {
       const arr = new Uint8Array(e.data);
       const dv = new DataView(arr.buffer, 0, arr.length);
-      serverData.gpsHDOP = dv.getFloat64(0, true);
-      serverData.gpsPDOP = dv.getFloat64(8, true);
-      serverData.gpsLat = dv.getFloat64(16, true);
-      serverData.gpsLon = dv.getFloat64(24, true);
-      serverData.gpsAltMsl = dv.getFloat64(32, true);
-      serverData.temperature = dv.getFloat64(40, true);
-      serverData.baroPressure = dv.getFloat64(48, true);
-      serverData.windspeed = dv.getFloat64(56, true);
-      serverData.windspeedMean = dv.getFloat64(64, true);
-      serverData.crossWindspeed = dv.getFloat64(72, true);
-      serverData.crossWindspeedMean = dv.getFloat64(80, true);
-      serverData.headWindspeed = dv.getFloat64(88, true);
-      serverData.QFE = dv.getFloat64(96, true);
-      serverData.QNH = dv.getFloat64(104, true);
-      serverData.gpsTime = dv.getFloat64(112, true);
-      serverData.localTime = dv.getFloat64(120, true);
-      serverData.flightNumber = dv.getInt16(128, true);
-      serverData.runwayHeading = dv.getInt16(130, true);
-      serverData.runwayElevation = dv.getInt16(132, true);
-      serverData.windDirection = dv.getInt16(134, true);
-      serverData.windDirectionMean = dv.getInt16(136, true);
-      serverData.barometerHeight = dv.getInt8(138, true);
-      serverData.maws_hour = dv.getInt8(139, true);
-      serverData.maws_minute = dv.getInt8(140, true);
-      serverData.maws_second = dv.getInt8(141, true);
-      serverData.humidity = dv.getInt8(142, true);
-      serverData.topNumber = dv.getInt8(143, true);
-      serverData.gpsStatus = dv.getInt8(144, true);
-      serverData.gpsMode = dv.getInt8(145, true);
-      serverData.gpsSatellitesVisible = dv.getInt8(146, true);
-      serverData.gpsSatellitesUsed = dv.getInt8(147, true);
-      serverData.recordStatus = dv.getInt8(148, true);
-      serverData.fromToStatus = dv.getInt8(149, true);
-
-      self.postMessage({ cmd: 'data', data: serverData });
+      if (arr.length === 11 && arr[0] === ServerEvent.Compliance) {
+        self.postMessage({
+          cmd: 'compliance',
+          data: {
+            compliance: dv.getUint8(1),
+            changed: dv.getUint8(2),
+            localTime: dv.getFloat64(3, true)
+          }
+        });
+        return;
+      }
+      if (arr.length === SUMMARY_SIZE && arr[0] === ServerEvent.Summary) {
+        self.postMessage({ cmd: 'summary', data: decodeSummary(dv) });
+        return;
+      }
+      if (arr.length !== PACKET_SIZE) {
+        console.error(`Unexpected frame length: ${arr.length}`);
+        return;
+      }
+      decodePacket(dv, serverData);
+      appendSample();
+      if (mainReady) {
+        flushSamples();
+      }
     }
   };
 
@@ -188,6 +192,16 @@ self.onmessage = (e) => {
     case 'connect':
       connect8080();
       break;
+    case 'ready':
+      /* Frame drawn, chunk comes back for reuse */
+      if (msg.data !== null && msg.data.length === CHUNK_SAMPLES * SAMPLE_STRIDE) {
+        freeChunks.push(msg.data);
+      }
+      mainReady = true;
+      if (chunkCount > 0) {
+        flushSamples();
+      }
+      break;
     case 'start':
       if (socket8080 !== null && socket8080.readyState === 1) {
         const buf = new ArrayBuffer(4);
@@ -24,9 +24,15 @@ let runwayElevation = -1;
 // Create worker thread for server communication.
 const serverCommunicationWorker = new Worker('./scripts/communication.worker.js');
 // Init charts
-const windspeedChart = new WindspeedChart('#windspeedChart', 0, 0);
+// Wind history holds 4 h at 20 packets per second
+const windspeedChart = new WindspeedChart('#windspeedChart', 4 * 3600 * 20);
 const humidityChart = new HumidityChart('#humidityChart', 0, 0);
 
+// Latest packet and sample chunk from worker, drawn on next animation frame
+let frameData = null;
+let frameChunk = null;
+let frameRequested = false;
+
 const gpsStatus = [
   'No Fix', // No Fix
   'SPS', // plain GPS (SPS Mode), without DGPS, PPS, RTK, DR, etc.
@@ -47,6 +53,24 @@ const gpsMode = [
   '3D' // 3 good for altitude/climb too
 ];
 
+// Server quality control flags per field, see server/qc.h
+const qcFlags = [
+  [0x01, 'out of range'],
+  [0x02, 'spike'],
+  [0x04, 'sensor stuck'],
+  [0x08, 'no data']
+];
+
+// Show failed quality checks of a value in red, the reason as tooltip
+function ShowQuality(id, flags) {
+  const el = document.getElementById(id);
+  el.classList.toggle('text-danger', flags !== 0);
+  el.title = qcFlags
+    .filter(([bit]) => flags & bit)
+    .map(([, text]) => text)
+    .join(', ');
+}
+
 // Update local time indication periodically
 function UpdateGui(serverData) {
   // GPS time and date
@@ -162,6 +186,11 @@ function UpdateGui(serverData) {
   document.getElementById('windspeedMean').innerHTML = `${serverData.windspeedMean.toFixed(1)}`;
   document.getElementById('windDirection').innerHTML = `${serverData.windDirection.toFixed(0)}`;
   document.getElementById('windspeed').innerHTML = `${serverData.windspeed.toFixed(1)}`;
+  ShowQuality('temperature', serverData.qcTemperature);
+  ShowQuality('humidity', serverData.qcHumidity);
+  ShowQuality('pressure', serverData.qcPressure);
+  ShowQuality('windspeed', serverData.qcWindspeed);
+  ShowQuality('windDirection', serverData.qcWindDirection);
 
   if (serverData.crossWindspeed < 0.0) {
     document.getElementById('crossWindspeedLabel').innerHTML = 'Crosswind from left [kts]';
@@ -187,10 +216,26 @@ function UpdateGui(serverData) {
   ).attributes.transform.value = `matrix(1,0,0,1,70,70) rotate(${serverData.windDirectionMean},0,0)`;
 
   // Update charts
-  windspeedChart.Update(Math.abs(serverData.windspeedMean), Math.abs(serverData.crossWindspeed));
+  windspeedChart.Render();
   humidityChart.Update(serverData.temperature, serverData.humidity);
 }
 
+// Draw latest data once per display frame, then hand sample chunk back to worker
+function OnAnimationFrame() {
+  frameRequested = false;
+  UpdateGui(frameData);
+  serverCommunicationWorker.postMessage({ cmd: 'ready', data: frameChunk }, [frameChunk.buffer]);
+  frameChunk = null;
+}
+
+// Change visible history of windspeed chart
+function OnHistorySpanChange(ev) {
+  windspeedChart.SetSpan(Number.parseInt(ev.target.value, 10));
+  if (frameData !== null) {
+    windspeedChart.Render();
+  }
+}
+
 // Start/stop recording
 function OnRecordButtonClick(ev) {
   if (recordStatus === 0) {
@@ -247,14 +292,27 @@ function OnTimeSyncButtonClick(ev) {
   });
 }
 
-// Show new noty of specific type
-function showNoty(text, type) {
+// Run acceptance at a glance, the run is valid only if it stayed within limits throughout
+function ShowRunSummary(s) {
+  const percent = (part) => (s.seconds > 0 ? Math.round((100 * part) / s.seconds) : 0);
+  const f = s.fields;
+  const text =
+    `<b>F${s.flightNumber} TOP ${s.topNumber}</b>: ${s.seconds} s, ${percent(s.secondsValid)}% within limits<br>` +
+    `Max wind ${f.windspeed.max.toFixed(1)} kt, gust ${f.gust.max.toFixed(1)} kt<br>` +
+    `Max cross wind ${f.crossWind.max.toFixed(1)} kt, head wind ${f.headWindMean.max.toFixed(1)} kt<br>` +
+    `Temp ${f.temperature.mean.toFixed(1)} °C, hum ${f.humidity.mean.toFixed(0)}%<br>` +
+    `GPS 3D ${percent(s.secondsGps3d)}%, min ${s.gpsSatellitesMin} sats, HDOP ≤ ${s.gpsHdopMax.toFixed(1)}`;
+  showNoty(text, s.seconds > 0 && s.secondsValid === s.seconds ? 'success' : 'warning', false);
+}
+
+// Show new noty of specific type, timeout false keeps it until clicked
+function showNoty(text, type, timeout = 1500) {
   new Noty({
     layout: 'topLeft',
     progressBar: false,
     text,
     theme: 'bootstrap-v4',
-    timeout: 1500,
+    timeout,
     type,
     container: '#noty'
   }).show();
@@ -275,7 +333,28 @@ document.addEventListener('DOMContentLoaded', () => {
         document.getElementById('linkSpeed').innerHTML = `${msg.data}Mbps`;
         break;
       case 'data':
-        UpdateGui(msg.data);
+        // Worker sends at most one message per frame and waits for 'ready'
+        frameData = msg.data;
+        frameChunk = msg.samples;
+        windspeedChart.Append(msg.samples, msg.count);
+        if (!frameRequested) {
+          frameRequested = true;
+          requestAnimationFrame(OnAnimationFrame);
+        }
+        break;
+      case 'compliance':
+        // Server evaluates the configured window and wind limits, bit 7 is overall validity
+        if (msg.data.changed & 0x80) {
+          if (msg.data.compliance & 0x80) {
+            showNoty('Conditions within limits', 'success');
+          } else {
+            showNoty('Conditions out of limits', 'warning');
+          }
+        }
+        break;
+      case 'summary':
+        // Sent once when a recording stops, also written next to the recording
+        ShowRunSummary(msg.data);
         break;
       default:
         console.error(`Unknown command: ${msg.cmd}`);
@@ -288,6 +367,7 @@ document.addEventListener('DOMContentLoaded', () => {
   document.getElementById('timeSyncButton').addEventListener('click', OnTimeSyncButtonClick);
   document.getElementById('elevationInput').addEventListener('change', OnElevationInputChange);
   document.getElementById('runwayHeadingInput').addEventListener('change', OnRunwayHeadingInputChange);
+  document.getElementById('historySpanSelect').addEventListener('change', OnHistorySpanChange);
 
   // Finally, connect to weather station
   serverCommunicationWorker.postMessage({
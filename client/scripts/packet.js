@@ -0,0 +1,169 @@
+// Generated by server/schemagen from server/schema.h, do not edit.
+/* exported PACKET_SIZE, createPacket, decodePacket, SUMMARY_SIZE, SUMMARY_FIELDS, decodeSummary */
+
+const PACKET_SIZE = 624;
+
+/*
+ * New packet object with all fields zero.
+ */
+function createPacket() {
+  return {
+    gpsHDOP: 0,
+    gpsPDOP: 0,
+    gpsLat: 0,
+    gpsLon: 0,
+    gpsAltMsl: 0,
+    temperature: 0,
+    baroPressure: 0,
+    windspeed: 0,
+    windspeedMean: 0,
+    crossWindspeed: 0,
+    crossWindspeedMean: 0,
+    headWindspeed: 0,
+    QFE: 0,
+    QNH: 0,
+    gpsTime: 0,
+    localTime: 0,
+    windRollup: Array.from({ length: 4 }, () => ({
+      mean: 0,
+      min: 0,
+      max: 0,
+      std: 0,
+      gust: 0,
+      lull: 0,
+      directionMean: 0,
+      directionStd: 0,
+    })),
+    windDirectionStd: 0,
+    speedOfSound: 0,
+    absorption: Array.from({ length: 24 }, () => ({
+      alpha: 0,
+    })),
+    publishSeq: 0,
+    flightNumber: 0,
+    runwayHeading: 0,
+    runwayElevation: 0,
+    windDirection: 0,
+    windDirectionMean: 0,
+    barometerHeight: 0,
+    maws_hour: 0,
+    maws_minute: 0,
+    maws_second: 0,
+    humidity: 0,
+    topNumber: 0,
+    gpsStatus: 0,
+    gpsMode: 0,
+    gpsSatellitesVisible: 0,
+    gpsSatellitesUsed: 0,
+    recordStatus: 0,
+    fromToStatus: 0,
+    compliance: 0,
+    qcTemperature: 0,
+    qcHumidity: 0,
+    qcPressure: 0,
+    qcWindspeed: 0,
+    qcWindDirection: 0,
+  };
+}
+
+/*
+ * Decode packet from DataView dv into packet object d.
+ */
+function decodePacket(dv, d) {
+  d.gpsHDOP = dv.getFloat64(0, true);
+  d.gpsPDOP = dv.getFloat64(8, true);
+  d.gpsLat = dv.getFloat64(16, true);
+  d.gpsLon = dv.getFloat64(24, true);
+  d.gpsAltMsl = dv.getFloat64(32, true);
+  d.temperature = dv.getFloat64(40, true);
+  d.baroPressure = dv.getFloat64(48, true);
+  d.windspeed = dv.getFloat64(56, true);
+  d.windspeedMean = dv.getFloat64(64, true);
+  d.crossWindspeed = dv.getFloat64(72, true);
+  d.crossWindspeedMean = dv.getFloat64(80, true);
+  d.headWindspeed = dv.getFloat64(88, true);
+  d.QFE = dv.getFloat64(96, true);
+  d.QNH = dv.getFloat64(104, true);
+  d.gpsTime = dv.getFloat64(112, true);
+  d.localTime = dv.getFloat64(120, true);
+  for (let i = 0; i < 4; i += 1) {
+    const o = 128 + i * 64;
+    const e = d.windRollup[i];
+    e.mean = dv.getFloat64(o + 0, true);
+    e.min = dv.getFloat64(o + 8, true);
+    e.max = dv.getFloat64(o + 16, true);
+    e.std = dv.getFloat64(o + 24, true);
+    e.gust = dv.getFloat64(o + 32, true);
+    e.lull = dv.getFloat64(o + 40, true);
+    e.directionMean = dv.getFloat64(o + 48, true);
+    e.directionStd = dv.getFloat64(o + 56, true);
+  }
+  d.windDirectionStd = dv.getFloat64(384, true);
+  d.speedOfSound = dv.getFloat64(392, true);
+  for (let i = 0; i < 24; i += 1) {
+    const o = 400 + i * 8;
+    const e = d.absorption[i];
+    e.alpha = dv.getFloat64(o + 0, true);
+  }
+  d.publishSeq = dv.getUint32(592, true);
+  d.flightNumber = dv.getUint16(596, true);
+  d.runwayHeading = dv.getUint16(598, true);
+  d.runwayElevation = dv.getUint16(600, true);
+  d.windDirection = dv.getUint16(602, true);
+  d.windDirectionMean = dv.getUint16(604, true);
+  d.barometerHeight = dv.getUint8(606);
+  d.maws_hour = dv.getUint8(607);
+  d.maws_minute = dv.getUint8(608);
+  d.maws_second = dv.getUint8(609);
+  d.humidity = dv.getUint8(610);
+  d.topNumber = dv.getUint8(611);
+  d.gpsStatus = dv.getUint8(612);
+  d.gpsMode = dv.getUint8(613);
+  d.gpsSatellitesVisible = dv.getUint8(614);
+  d.gpsSatellitesUsed = dv.getUint8(615);
+  d.recordStatus = dv.getUint8(616);
+  d.fromToStatus = dv.getUint8(617);
+  d.compliance = dv.getUint8(618);
+  d.qcTemperature = dv.getUint8(619);
+  d.qcHumidity = dv.getUint8(620);
+  d.qcPressure = dv.getUint8(621);
+  d.qcWindspeed = dv.getUint8(622);
+  d.qcWindDirection = dv.getUint8(623);
+}
+
+const SUMMARY_SIZE = 272;
+
+const SUMMARY_FIELDS = Object.freeze([
+  'temperature',
+  'humidity',
+  'pressure',
+  'QNH',
+  'windspeed',
+  'windspeedMean',
+  'crossWind',
+  'crossWindMean',
+  'headWindMean',
+  'gust',
+]);
+
+/*
+ * Decode run summary event from DataView dv.
+ */
+function decodeSummary(dv) {
+  const d = {
+    topNumber: dv.getUint8(1),
+    flightNumber: dv.getUint16(2, true),
+    start: dv.getUint32(4, true),
+    seconds: dv.getUint32(8, true),
+    secondsValid: dv.getUint32(12, true),
+    secondsGps3d: dv.getUint32(16, true),
+    gpsSatellitesMin: dv.getUint8(20),
+    gpsHdopMax: dv.getFloat64(24, true),
+    fields: {}
+  };
+  SUMMARY_FIELDS.forEach((name, i) => {
+    const o = 32 + i * 24;
+    d.fields[name] = { mean: dv.getFloat64(o, true), min: dv.getFloat64(o + 8, true), max: dv.getFloat64(o + 16, true) };
+  });
+  return d;
+}
@@ -0,0 +1,67 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <math.h>
+#include "absorption.h"
+
+#define T0 293.15     // Reference temperature [K]
+#define T01 273.16    // Triple point isotherm temperature [K]
+#define P_REF 1013.25 // Reference pressure [hPa]
+#define C0 343.2      // Speed of sound at T0 [m/s]
+
+#define ABSORPTION_FREQ_B(X, i, nominal, f) f,
+
+static const double band_freq[ABSORPTION_NUM_BANDS] = {ABSORPTION_BANDS(ABSORPTION_FREQ_B, _)};
+
+/**
+ * Absorption coefficients of all bands.
+ * temperature [degC], relative humidity [%], pressure [hPa].
+ */
+void absorption_compute(double temperature, double humidity, double pressure,
+                        t_absorption_band bands[ABSORPTION_NUM_BANDS])
+{
+    double t = temperature + 273.15;
+    double tr = t / T0;
+    double pr = pressure / P_REF;
+    // Molar concentration of water vapour [%]
+    double psat = pow(10.0, -6.8346 * pow(T01 / t, 1.261) + 4.6151);
+    double h = humidity * psat / pr;
+    // Relaxation frequencies of oxygen and nitrogen [Hz]
+    double fro = pr * (24.0 + 4.04e4 * h * (0.02 + h) / (0.391 + h));
+    double frn = pr / sqrt(tr) * (9.0 + 280.0 * h * exp(-4.170 * (cbrt(1.0 / tr) - 1.0)));
+    // Band independent factors, 8.686 dB/Np and per 100 m
+    double classic = 868.6 * 1.84e-11 / pr * sqrt(tr);
+    double vib = 868.6 * pow(tr, -2.5);
+    double ko = vib * 0.01275 * exp(-2239.1 / t) * fro;
+    double kn = vib * 0.1068 * exp(-3352.0 / t) * frn;
+    double fro2 = fro * fro;
+    double frn2 = frn * frn;
+
+    // alpha = f^2 (classic + ko / (fro^2 + f^2) + kn / (frn^2 + f^2))
+    for (int i = 0; i < ABSORPTION_NUM_BANDS; i++)
+    {
+        double f2 = band_freq[i] * band_freq[i];
+        bands[i].alpha = f2 * (classic + ko / (fro2 + f2) + kn / (frn2 + f2));
+    }
+}
+
+/**
+ * Speed of sound in air at temperature [degC], ISO 9613-1 [m/s].
+ */
+double speed_of_sound(double temperature)
+{
+    return C0 * sqrt((temperature + 273.15) / T0);
+}
@@ -0,0 +1,76 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Atmospheric sound absorption per ISO 9613-1 (SAE ARP 5534), for the
+// one-third octave bands used in noise certification.
+//
+// The coefficients depend on temperature, humidity and pressure only through
+// the two relaxation frequencies of oxygen and nitrogen. Those and the band
+// independent factors are computed once per sample, the band loop is then
+// pure arithmetic over the constant frequency table and is vectorized by the
+// compiler.
+
+#ifndef ABSORPTION_H
+#define ABSORPTION_H
+
+#define ABSORPTION_NUM_BANDS 24
+
+// One-third octave bands 50 Hz to 10 kHz, B(X, index, nominal name, exact
+// midband frequency 1000 * 10^(k/10) [Hz]). X is passed through for users
+// expanding other lists from it, see RECORD_ABSORPTION_COLUMNS.
+#define ABSORPTION_BANDS(B, X)         \
+    B(X, 0, "50", 50.1187)             \
+    B(X, 1, "63", 63.0957)             \
+    B(X, 2, "80", 79.4328)             \
+    B(X, 3, "100", 100.0000)           \
+    B(X, 4, "125", 125.8925)           \
+    B(X, 5, "160", 158.4893)           \
+    B(X, 6, "200", 199.5262)           \
+    B(X, 7, "250", 251.1886)           \
+    B(X, 8, "315", 316.2278)           \
+    B(X, 9, "400", 398.1072)           \
+    B(X, 10, "500", 501.1872)          \
+    B(X, 11, "630", 630.9573)          \
+    B(X, 12, "800", 794.3282)          \
+    B(X, 13, "1000", 1000.0000)        \
+    B(X, 14, "1250", 1258.9254)        \
+    B(X, 15, "1600", 1584.8932)        \
+    B(X, 16, "2000", 1995.2623)        \
+    B(X, 17, "2500", 2511.8864)        \
+    B(X, 18, "3150", 3162.2777)        \
+    B(X, 19, "4000", 3981.0717)        \
+    B(X, 20, "5000", 5011.8723)        \
+    B(X, 21, "6300", 6309.5734)        \
+    B(X, 22, "8000", 7943.2823)        \
+    B(X, 23, "10000", 10000.0000)
+
+// Packet element of one band
+#define ABSORPTION_BAND_FIELDS(F) \
+    F(double, alpha, alpha, Float64) /* [dB/100 m] */
+
+#define ABSORPTION_BAND_STRUCT_F(type, name, js_name, js_type) type name;
+
+typedef struct
+{
+    ABSORPTION_BAND_FIELDS(ABSORPTION_BAND_STRUCT_F)
+} t_absorption_band;
+
+void absorption_compute(double temperature, double humidity, double pressure,
+                        t_absorption_band bands[ABSORPTION_NUM_BANDS]);
+double speed_of_sound(double temperature);
+
+#endif /* ABSORPTION_H */
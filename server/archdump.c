@@ -0,0 +1,125 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Print a time range of the long-term archive as CSV.
+// Times are UTC. Only the partitions and slots of the range are read.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include "archive.h"
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -d DIR        Archive directory [default: " ARCHIVE_PATH "]\n"
+            "  -l LEVEL      1m or 10m [default: 10m]\n"
+            "  -f YYYY-MM-DD[THH:MM]  First interval, UTC [default: 7 days ago]\n"
+            "  -t YYYY-MM-DD[THH:MM]  End of range, UTC [default: now]\n",
+            name);
+}
+
+/**
+ * Parse a UTC date with optional time of day.
+ */
+static int parse_time(const char *s, time_t *t)
+{
+    struct tm tm;
+    const char *end;
+
+    memset(&tm, 0, sizeof(tm));
+    end = strptime(s, "%Y-%m-%d", &tm);
+    if (end != NULL && *end == 'T')
+        end = strptime(end + 1, "%H:%M", &tm);
+    if (end == NULL || *end != '\0')
+        return EXIT_FAILURE;
+    *t = timegm(&tm);
+    return EXIT_SUCCESS;
+}
+
+static int print_record(const t_archive_record *rec, void *user)
+{
+    time_t start = (time_t)rec->start;
+    struct tm tm;
+    char date[32];
+    int i;
+
+    (void)user;
+    gmtime_r(&start, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    printf("%s;%u;%u;%0.1f", date, rec->samples, rec->direction, rec->direction_std);
+    for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+        printf(";%0.2f;%0.2f;%0.2f", rec->field[i].mean, rec->field[i].min, rec->field[i].max);
+    putchar('\n');
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = ARCHIVE_PATH;
+    int level = archive_level("10m");
+    time_t to = time(NULL);
+    time_t from = to - 7 * ARCHIVE_DAY;
+    int opt;
+    int i;
+
+    while ((opt = getopt(argc, argv, "d:l:f:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'l':
+            level = archive_level(optarg);
+            if (level < 0)
+            {
+                fprintf(stderr, "Unknown level %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'f':
+        case 't':
+            if (parse_time(optarg, opt == 'f' ? &from : &to) != EXIT_SUCCESS)
+            {
+                fprintf(stderr, "Invalid time %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("START;SAMPLES;DIRECTION_MEAN;DIRECTION_STD");
+    for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+        printf(";%s_MEAN;%s_MIN;%s_MAX", archive_headers[i], archive_headers[i], archive_headers[i]);
+    printf("\nUTC;#;deg;deg");
+    for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+        printf(";%s;%s;%s", archive_units[i], archive_units[i], archive_units[i]);
+    putchar('\n');
+    return archive_read(dir, level, from, to, print_record, NULL);
+}
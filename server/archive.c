@@ -0,0 +1,463 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <float.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "archive.h"
+
+#define ARCHIVE_READ_RECORDS 256 // Records per read
+
+const unsigned int archive_intervals[ARCHIVE_NUM_LEVELS] = {60, 600};
+const char *const archive_level_names[ARCHIVE_NUM_LEVELS] = {"1m", "10m"};
+#define ARCHIVE_HEADER_X(name, header, unit) header,
+#define ARCHIVE_UNIT_X(name, header, unit) unit,
+const char *const archive_headers[ARCHIVE_NUM_FIELDS] = {ARCHIVE_FIELDS(ARCHIVE_HEADER_X)};
+const char *const archive_units[ARCHIVE_NUM_FIELDS] = {ARCHIVE_FIELDS(ARCHIVE_UNIT_X)};
+
+/**
+ * Interval being accumulated and partition file of one level.
+ */
+typedef struct
+{
+    int fd;
+    time_t day;        // Start of the open partition
+    time_t last_start; // Last interval written to the partition
+    time_t start;      // Interval being accumulated
+    unsigned int samples;
+    double sum[ARCHIVE_NUM_FIELDS];
+    double min[ARCHIVE_NUM_FIELDS];
+    double max[ARCHIVE_NUM_FIELDS];
+    t_circular dir;
+} t_archive_level;
+
+/**
+ * Sample queued for the writer thread.
+ */
+typedef struct
+{
+    t_archive_sample sample;
+    time_t time;
+} t_archive_entry;
+
+// Levels and partitions are owned by the writer thread while archiving
+static char archive_dir[PATH_MAX] = "";
+static t_archive_level levels[ARCHIVE_NUM_LEVELS];
+static pthread_t archive_thread;
+static pthread_mutex_t archive_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t archive_cond = PTHREAD_COND_INITIALIZER;
+static t_archive_entry archive_queue[ARCHIVE_QUEUE_SIZE];
+static unsigned int queue_head = 0; // Samples queued
+static unsigned int queue_tail = 0; // Samples taken by the writer
+static bool archive_active = false;
+static bool archive_exit = false;
+static unsigned long archive_dropped = 0;
+
+/**
+ * Partition file name of a level and day.
+ */
+static int partition_path(char *buf, size_t size, const char *dir, int level, time_t day)
+{
+    struct tm tm;
+    char date[16];
+
+    gmtime_r(&day, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+    return snprintf(buf, size, "%s/%s/%s" ARCHIVE_SUFFIX, dir, archive_level_names[level], date) < (int)size
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+}
+
+static off_t slot_offset(const t_archive_level *l, int level, time_t start)
+{
+    return (off_t)sizeof(t_archive_header) +
+           (off_t)((start - l->day) / archive_intervals[level]) * (off_t)sizeof(t_archive_record);
+}
+
+/**
+ * Open or create the partition of a day, the last written slot is taken from its size.
+ */
+static int open_partition(int level, time_t day)
+{
+    t_archive_level *l = &levels[level];
+    t_archive_header hdr;
+    char path[PATH_MAX];
+    struct stat st;
+
+    if (l->fd >= 0)
+        close(l->fd);
+    l->fd = -1;
+    l->day = day;
+    l->last_start = day - 1;
+    if (partition_path(path, sizeof(path), archive_dir, level, day) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    l->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (l->fd < 0 || fstat(l->fd, &st) != 0)
+    {
+        fprintf(stderr, "Failed to open archive %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (st.st_size >= (off_t)sizeof(hdr))
+    {
+        if (pread(l->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+            memcmp(hdr.magic, ARCHIVE_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.record_size != sizeof(t_archive_record) || hdr.interval != archive_intervals[level] ||
+            hdr.day != (int64_t)day)
+        {
+            fprintf(stderr, "Archive %s has a different layout, not appended\n", path);
+            close(l->fd);
+            l->fd = -1;
+            return EXIT_FAILURE;
+        }
+        if (st.st_size > (off_t)sizeof(hdr))
+            l->last_start = day + (time_t)((st.st_size - (off_t)sizeof(hdr)) / (off_t)sizeof(t_archive_record) - 1) *
+                                      (time_t)archive_intervals[level];
+        return EXIT_SUCCESS;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ARCHIVE_MAGIC, sizeof(hdr.magic));
+    hdr.version = ARCHIVE_VERSION;
+    hdr.record_size = sizeof(t_archive_record);
+    hdr.interval = archive_intervals[level];
+    hdr.fields = ARCHIVE_NUM_FIELDS;
+    hdr.day = day;
+    if (pwrite(l->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr))
+    {
+        fprintf(stderr, "Failed to write archive %s: %s\n", path, strerror(errno));
+        close(l->fd);
+        l->fd = -1;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static void clear_interval(t_archive_level *l, time_t start)
+{
+    int i;
+
+    l->start = start;
+    l->samples = 0;
+    for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+    {
+        l->sum[i] = 0.0;
+        l->min[i] = DBL_MAX;
+        l->max[i] = -DBL_MAX;
+    }
+    circular_clear(&l->dir);
+}
+
+/**
+ * Write the accumulated interval into its slot.
+ */
+static void flush_interval(int level)
+{
+    t_archive_level *l = &levels[level];
+    time_t day = l->start - l->start % ARCHIVE_DAY;
+    t_archive_record rec;
+    t_circular_stats dir;
+    int i;
+
+    if (l->samples == 0)
+        return;
+    if ((l->fd < 0 || day != l->day) && open_partition(level, day) != EXIT_SUCCESS)
+        return;
+    // Never rewrite a slot, the clock went back
+    if (l->start <= l->last_start)
+        return;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.start = l->start;
+    rec.samples = l->samples > UINT16_MAX ? UINT16_MAX : (uint16_t)l->samples;
+    circular_stats(&l->dir, &dir);
+    rec.direction = (uint16_t)lround(dir.weighted_mean) % 360;
+    rec.direction_std = (float)dir.std;
+    for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+    {
+        rec.field[i].mean = (float)(l->sum[i] / l->samples);
+        rec.field[i].min = (float)l->min[i];
+        rec.field[i].max = (float)l->max[i];
+    }
+    if (pwrite(l->fd, &rec, sizeof(rec), slot_offset(l, level, l->start)) != (ssize_t)sizeof(rec))
+    {
+        fprintf(stderr, "Failed to write archive: %s\n", strerror(errno));
+        return;
+    }
+    l->last_start = l->start;
+}
+
+/**
+ * Add one sample at wall clock time now, completed intervals are written.
+ */
+static void accumulate(const t_archive_sample *s, time_t now)
+{
+#define ARCHIVE_VALUE_X(name, header, unit) s->name,
+    const double values[ARCHIVE_NUM_FIELDS] = {ARCHIVE_FIELDS(ARCHIVE_VALUE_X)};
+    t_circular_sample dir;
+    int level;
+    int i;
+
+    circular_sample(&dir, s->windspeed, s->direction);
+    for (level = 0; level < ARCHIVE_NUM_LEVELS; level++)
+    {
+        t_archive_level *l = &levels[level];
+        time_t start = now - now % archive_intervals[level];
+
+        // Samples behind the interval in progress, the clock went back
+        if (start < l->start)
+            continue;
+        if (start != l->start)
+        {
+            flush_interval(level);
+            clear_interval(l, start);
+        }
+        for (i = 0; i < ARCHIVE_NUM_FIELDS; i++)
+        {
+            l->sum[i] += values[i];
+            if (values[i] < l->min[i])
+                l->min[i] = values[i];
+            if (values[i] > l->max[i])
+                l->max[i] = values[i];
+        }
+        circular_add(&l->dir, &dir);
+        l->samples++;
+    }
+}
+
+/**
+ * Accumulate queued samples and write completed intervals until the archive is closed.
+ * Partition I/O runs without the queue lock held.
+ */
+static void *archive_write_thread(void *arg)
+{
+    t_archive_entry batch[ARCHIVE_QUEUE_SIZE];
+    unsigned int n;
+    unsigned int i;
+
+    (void)arg;
+    pthread_mutex_lock(&archive_lock);
+    for (;;)
+    {
+        while (queue_head == queue_tail && !archive_exit)
+            pthread_cond_wait(&archive_cond, &archive_lock);
+        n = queue_head - queue_tail;
+        if (n == 0)
+            break; // Closed and drained
+        for (i = 0; i < n; i++)
+            batch[i] = archive_queue[(queue_tail + i) % ARCHIVE_QUEUE_SIZE];
+        queue_tail += n;
+        pthread_mutex_unlock(&archive_lock);
+
+        for (i = 0; i < n; i++)
+            accumulate(&batch[i].sample, batch[i].time);
+
+        pthread_mutex_lock(&archive_lock);
+    }
+    pthread_mutex_unlock(&archive_lock);
+    return NULL;
+}
+
+/**
+ * Start archiving below dir, one subdirectory per level, and its writer thread.
+ */
+int archive_open(const char *dir)
+{
+    char path[PATH_MAX];
+    int level;
+
+    archive_close();
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Failed to create archive %s: %s\n", dir, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for (level = 0; level < ARCHIVE_NUM_LEVELS; level++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, archive_level_names[level]);
+        if (mkdir(path, 0755) != 0 && errno != EEXIST)
+        {
+            fprintf(stderr, "Failed to create archive %s: %s\n", path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    strncpy(archive_dir, dir, sizeof(archive_dir) - 1);
+    archive_dir[sizeof(archive_dir) - 1] = '\0';
+    for (level = 0; level < ARCHIVE_NUM_LEVELS; level++)
+    {
+        levels[level].fd = -1;
+        levels[level].day = 0;
+        clear_interval(&levels[level], 0);
+    }
+    queue_head = 0;
+    queue_tail = 0;
+    archive_dropped = 0;
+    archive_exit = false;
+    if (pthread_create(&archive_thread, NULL, archive_write_thread, NULL) != 0)
+    {
+        fprintf(stderr, "Failed to start archive writer\n");
+        archive_dir[0] = '\0';
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_lock(&archive_lock);
+    archive_active = true;
+    pthread_mutex_unlock(&archive_lock);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Queue one sample at wall clock time now, never blocks on I/O.
+ * The sample is dropped when the queue is full.
+ */
+void archive_sample(const t_archive_sample *s, time_t now)
+{
+    pthread_mutex_lock(&archive_lock);
+    if (archive_active)
+    {
+        if (queue_head - queue_tail < ARCHIVE_QUEUE_SIZE)
+        {
+            archive_queue[queue_head % ARCHIVE_QUEUE_SIZE] = (t_archive_entry){*s, now};
+            queue_head++;
+            pthread_cond_signal(&archive_cond);
+        }
+        else
+        {
+            archive_dropped++;
+        }
+    }
+    pthread_mutex_unlock(&archive_lock);
+}
+
+/**
+ * Write the intervals in progress and close the partitions.
+ */
+void archive_close(void)
+{
+    int level;
+
+    pthread_mutex_lock(&archive_lock);
+    if (!archive_active)
+    {
+        pthread_mutex_unlock(&archive_lock);
+        return;
+    }
+    archive_active = false;
+    archive_exit = true;
+    pthread_cond_signal(&archive_cond);
+    pthread_mutex_unlock(&archive_lock);
+
+    pthread_join(archive_thread, NULL);
+    if (archive_dropped > 0)
+        fprintf(stderr, "Archive writer fell behind, %lu samples lost\n", archive_dropped);
+    for (level = 0; level < ARCHIVE_NUM_LEVELS; level++)
+    {
+        flush_interval(level);
+        if (levels[level].fd >= 0)
+            close(levels[level].fd);
+        levels[level].fd = -1;
+    }
+    archive_dir[0] = '\0';
+}
+
+/**
+ * Level index by name, -1 when unknown.
+ */
+int archive_level(const char *name)
+{
+    int level;
+
+    for (level = 0; level < ARCHIVE_NUM_LEVELS; level++)
+    {
+        if (strcmp(name, archive_level_names[level]) == 0)
+            return level;
+    }
+    return -1;
+}
+
+/**
+ * Call cb for every stored interval starting in [from, to), in time order.
+ * Reads only the slots of the range. A non-zero return of cb stops reading.
+ */
+int archive_read(const char *dir, int level, time_t from, time_t to, t_archive_callback cb, void *user)
+{
+    static t_archive_record buf[ARCHIVE_READ_RECORDS];
+    time_t interval;
+    time_t day;
+
+    if (level < 0 || level >= ARCHIVE_NUM_LEVELS)
+        return EXIT_FAILURE;
+    interval = (time_t)archive_intervals[level];
+    for (day = from - from % ARCHIVE_DAY; day < to; day += ARCHIVE_DAY)
+    {
+        t_archive_level part = {.day = day};
+        t_archive_header hdr;
+        char path[PATH_MAX];
+        time_t first = from > day ? from : day;
+        time_t last = to < day + ARCHIVE_DAY ? to : day + ARCHIVE_DAY;
+        off_t offset;
+        off_t end;
+        int fd;
+
+        if (partition_path(path, sizeof(path), dir, level, day) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue; // No data that day
+        if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+            memcmp(hdr.magic, ARCHIVE_MAGIC, sizeof(hdr.magic)) != 0 ||
+            hdr.record_size != sizeof(t_archive_record) || hdr.interval != archive_intervals[level])
+        {
+            fprintf(stderr, "Skipping %s, not an archive of this layout\n", path);
+            close(fd);
+            continue;
+        }
+
+        // Slots starting in [first, last)
+        offset = slot_offset(&part, level, day + (first - day + interval - 1) / interval * interval);
+        end = slot_offset(&part, level, day + (last - day + interval - 1) / interval * interval);
+        while (offset < end)
+        {
+            size_t want = (size_t)(end - offset) < sizeof(buf) ? (size_t)(end - offset) : sizeof(buf);
+            ssize_t got = pread(fd, buf, want, offset);
+            size_t i;
+
+            if (got <= 0)
+                break;
+            for (i = 0; i < (size_t)got / sizeof(t_archive_record); i++)
+            {
+                if (buf[i].samples == 0)
+                    continue;
+                if (cb(&buf[i], user) != 0)
+                {
+                    close(fd);
+                    return EXIT_SUCCESS;
+                }
+            }
+            offset += got;
+        }
+        close(fd);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Long-term archive of station data in 1 min and 10 min rollups.
+//
+// Every MAWS sample is accumulated into the current interval of each level.
+// When an interval ends, its mean, minimum and maximum per field are written
+// as one fixed size t_archive_record. Each level has one partition file per
+// UTC day, DIR/LEVEL/YYYY-MM-DD.dat: a t_archive_header followed by one
+// record slot per interval of the day. The slot of an interval is its offset
+// from midnight divided by the interval, so locating a time range needs no
+// search. Slots of intervals without data stay holes and read as zero
+// samples. Files are only ever extended; an interval at or before the last
+// written one, after the clock went back, is dropped. Samples are queued and
+// written by a thread of the archive, a slow disk never holds up the caller.
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "circular.h"
+
+#define ARCHIVE_PATH "/var/lib/meteo/archive"
+#define ARCHIVE_MAGIC "MWAR"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_SUFFIX ".dat"
+#define ARCHIVE_NUM_LEVELS 2 // 1 min, 10 min
+#define ARCHIVE_DAY 86400    // Partition length [s]
+#define ARCHIVE_QUEUE_SIZE 1024 // Samples queued for the writer thread
+
+// Archived fields, X(name, header, unit)
+#define ARCHIVE_FIELDS(X)                      \
+    X(temperature, "TEMP", "degC")             \
+    X(humidity, "HUM", "%")                    \
+    X(pressure, "PRESSURE", "mbar")            \
+    X(qnh, "QNH", "mbar")                      \
+    X(windspeed, "WIND_TOTAL", "kt")           \
+    X(cross_wind, "WIND_LAT", "kt")            \
+    X(head_wind, "WIND_HEAD", "kt")
+
+#define ARCHIVE_COUNT_X(name, header, unit) +1
+#define ARCHIVE_NUM_FIELDS (0 ARCHIVE_FIELDS(ARCHIVE_COUNT_X))
+#define ARCHIVE_SAMPLE_X(name, header, unit) double name;
+
+/**
+ * One MAWS sample as seen by the archive.
+ */
+typedef struct
+{
+    ARCHIVE_FIELDS(ARCHIVE_SAMPLE_X)
+    unsigned short direction; // [deg]
+} t_archive_sample;
+
+typedef struct
+{
+    float mean;
+    float min;
+    float max;
+} t_archive_stat;
+
+/**
+ * One interval, written in host byte order.
+ */
+typedef struct
+{
+    int64_t start;              // Interval start, UNIX time [s]
+    uint16_t samples;           // 0 for an empty slot
+    uint16_t direction;         // Speed weighted mean wind direction [deg]
+    float direction_std;        // Yamartino standard deviation [deg]
+    t_archive_stat field[ARCHIVE_NUM_FIELDS]; // In ARCHIVE_FIELDS order
+} t_archive_record;
+
+typedef struct
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t interval; // [s]
+    uint16_t fields;
+    uint16_t reserved;
+    int64_t day;       // Partition start, UNIX time [s]
+} t_archive_header;
+
+_Static_assert(sizeof(t_archive_header) == 24, "archive header layout changed");
+
+typedef int (*t_archive_callback)(const t_archive_record *rec, void *user);
+
+extern const unsigned int archive_intervals[ARCHIVE_NUM_LEVELS];
+extern const char *const archive_level_names[ARCHIVE_NUM_LEVELS];
+extern const char *const archive_headers[ARCHIVE_NUM_FIELDS];
+extern const char *const archive_units[ARCHIVE_NUM_FIELDS];
+
+// Writer, used by meteoserver
+int archive_open(const char *dir);
+void archive_sample(const t_archive_sample *s, time_t now);
+void archive_close(void);
+
+// Reader
+int archive_level(const char *name);
+int archive_read(const char *dir, int level, time_t from, time_t to, t_archive_callback cb, void *user);
+
+#endif /* ARCHIVE_H */
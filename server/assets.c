@@ -0,0 +1,477 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "assets.h"
+
+#define NOTUSED(V) ((void)V)
+
+static t_asset assets[ASSETS_MAX_FILES];
+static size_t asset_count = 0;
+static size_t asset_root_len = 0;
+
+static const struct
+{
+    const char *suffix;
+    const char *mime;
+    bool compress;
+} mime_types[] = {
+    {".html", "text/html; charset=utf-8", true},
+    {".js", "application/javascript", true},
+    {".css", "text/css", true},
+    {".json", "application/json", true},
+    {".svg", "image/svg+xml", true},
+    {".ico", "image/x-icon", true},
+    {".png", "image/png", false},
+    {".txt", "text/plain; charset=utf-8", true},
+    {".csv", "text/csv; charset=utf-8", true},
+    {".idx", "text/plain; charset=utf-8", true},
+    {".gz", "application/gzip", false},
+    {NULL, "application/octet-stream", false}};
+
+/**
+ * Index into mime_types by file name suffix, last entry when unknown.
+ */
+static size_t mime_index(const char *path)
+{
+    size_t plen = strlen(path);
+    size_t i;
+
+    for (i = 0; mime_types[i].suffix != NULL; i++)
+    {
+        size_t slen = strlen(mime_types[i].suffix);
+        if (plen > slen && strcasecmp(path + plen - slen, mime_types[i].suffix) == 0)
+            break;
+    }
+    return i;
+}
+
+/**
+ * Content type by file name suffix.
+ */
+const char *assets_mime(const char *path)
+{
+    return mime_types[mime_index(path)].mime;
+}
+
+/**
+ * HTML pages, their references are versioned.
+ */
+static bool is_page(const t_asset *a)
+{
+    return a->mime == mime_types[0].mime;
+}
+
+/**
+ * FNV-1a, only used to tell contents apart.
+ */
+static uint64_t content_hash(const unsigned char *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (len--)
+    {
+        h ^= *data++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * Read a whole file into a new buffer.
+ */
+static unsigned char *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    struct stat st;
+    unsigned char *data;
+
+    if (f == NULL)
+        return NULL;
+    if (fstat(fileno(f), &st) != 0 || st.st_size > ASSETS_MAX_SIZE)
+    {
+        fclose(f);
+        return NULL;
+    }
+    // One spare byte, an empty file still gets a buffer
+    data = malloc((size_t)st.st_size + 1);
+    if (data != NULL && fread(data, 1, (size_t)st.st_size, f) != (size_t)st.st_size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *len = (size_t)st.st_size;
+    return data;
+}
+
+/**
+ * nftw callback, adds one regular file to the bundle.
+ */
+static int add_file(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    const char *path = fpath + asset_root_len;
+    t_asset *a;
+    size_t plen = strlen(path);
+
+    NOTUSED(sb);
+    // Hidden files and directories stay private
+    if (fpath[ftwbuf->base] == '.')
+        return typeflag == FTW_D ? FTW_SKIP_SUBTREE : FTW_CONTINUE;
+    if (typeflag != FTW_F)
+        return FTW_CONTINUE;
+    // Precompressed variants are attached to their original later
+    if (plen > 3 && strcmp(path + plen - 3, ".br") == 0)
+        return FTW_CONTINUE;
+    if (asset_count >= ASSETS_MAX_FILES)
+    {
+        fprintf(stderr, "Too many client files, %s not served\n", fpath);
+        return FTW_CONTINUE;
+    }
+
+    a = &assets[asset_count];
+    memset(a, 0, sizeof(*a));
+    while (*path == '/')
+        path++;
+    a->path = strdup(path);
+    a->mime = assets_mime(path);
+    a->variant[ASSET_IDENTITY].data = read_file(fpath, &a->variant[ASSET_IDENTITY].len);
+    if (a->path == NULL || a->variant[ASSET_IDENTITY].data == NULL)
+    {
+        fprintf(stderr, "Failed to read client file %s\n", fpath);
+        free(a->path);
+        free(a->variant[ASSET_IDENTITY].data);
+        return FTW_CONTINUE;
+    }
+    asset_count++;
+    return FTW_CONTINUE;
+}
+
+static int compare_path(const void *a, const void *b)
+{
+    return strcmp(((const t_asset *)a)->path, ((const t_asset *)b)->path);
+}
+
+static int compare_key(const void *key, const void *b)
+{
+    return strcmp((const char *)key, ((const t_asset *)b)->path);
+}
+
+/**
+ * Lookup of a bundled file by its path relative to the root.
+ */
+const t_asset *assets_find(const char *path)
+{
+    while (*path == '/')
+        path++;
+    return bsearch(path, assets, asset_count, sizeof(t_asset), compare_key);
+}
+
+/**
+ * Content version and ETags of all variants, the identity content must be final.
+ */
+static void stamp(t_asset *a)
+{
+    static const char *const etag_suffix[ASSET_ENCODINGS] = {"", "-gz", "-br"};
+    char hex[17];
+    int e;
+
+    snprintf(hex, sizeof(hex), "%016llx",
+             (unsigned long long)content_hash(a->variant[ASSET_IDENTITY].data, a->variant[ASSET_IDENTITY].len));
+    memcpy(a->version, hex, sizeof(a->version) - 1);
+    a->version[sizeof(a->version) - 1] = '\0';
+    for (e = 0; e < ASSET_ENCODINGS; e++)
+        snprintf(a->variant[e].etag, sizeof(a->variant[e].etag), "\"%s%s\"", hex, etag_suffix[e]);
+}
+
+/**
+ * Add "?v=version" to src and href attributes that name another bundled file.
+ * Returns a new buffer or NULL when nothing was changed.
+ */
+static unsigned char *version_references(const t_asset *page, size_t *out_len)
+{
+    const char *text = (const char *)page->variant[ASSET_IDENTITY].data;
+    size_t len = page->variant[ASSET_IDENTITY].len;
+    const char *dir_end = strrchr(page->path, '/');
+    size_t dir_len = dir_end != NULL ? (size_t)(dir_end - page->path) + 1 : 0;
+    char *out = NULL;
+    size_t out_size = 0;
+    FILE *f = NULL;
+    size_t copied = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        static const char *const attrs[] = {"src=\"", "href=\""};
+        const char *value = NULL;
+        const char *value_end;
+        char ref[256];
+        const t_asset *target;
+        size_t n;
+        size_t k;
+
+        for (k = 0; k < sizeof(attrs) / sizeof(attrs[0]); k++)
+        {
+            n = strlen(attrs[k]);
+            if (len - i > n && strncasecmp(text + i, attrs[k], n) == 0)
+            {
+                value = text + i + n;
+                break;
+            }
+        }
+        if (value == NULL)
+            continue;
+        value_end = memchr(value, '"', len - (size_t)(value - text));
+        if (value_end == NULL)
+            break;
+        n = (size_t)(value_end - value);
+        // Only plain relative references, no scheme, query or fragment
+        if (n == 0 || memchr(value, ':', n) != NULL || memchr(value, '?', n) != NULL ||
+            memchr(value, '#', n) != NULL || value[0] == '/')
+            continue;
+        if (strncmp(value, "./", 2) == 0)
+        {
+            value += 2;
+            n -= 2;
+        }
+        if (dir_len + n >= sizeof(ref))
+            continue;
+        memcpy(ref, page->path, dir_len);
+        memcpy(ref + dir_len, value, n);
+        ref[dir_len + n] = '\0';
+        target = assets_find(ref);
+        if (target == NULL || is_page(target))
+            continue;
+
+        if (f == NULL && (f = open_memstream(&out, &out_size)) == NULL)
+            return NULL;
+        fwrite(text + copied, 1, (size_t)(value_end - text) - copied, f);
+        fprintf(f, "?" ASSETS_VERSION_ARG "=%s", target->version);
+        copied = (size_t)(value_end - text);
+        i = copied;
+    }
+    if (f == NULL)
+        return NULL;
+    fwrite(text + copied, 1, len - copied, f);
+    if (fclose(f) != 0)
+    {
+        free(out);
+        return NULL;
+    }
+    *out_len = out_size;
+    return (unsigned char *)out;
+}
+
+/**
+ * gzip variant, kept only when it saves at least an eighth.
+ */
+static void compress_gzip(t_asset *a)
+{
+    const t_asset_variant *in = &a->variant[ASSET_IDENTITY];
+    t_asset_variant *out = &a->variant[ASSET_GZIP];
+    z_stream zs;
+    uLong bound;
+
+    if (!mime_types[mime_index(a->path)].compress || in->len == 0)
+        return;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, ASSETS_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+    bound = deflateBound(&zs, (uLong)in->len);
+    out->data = malloc(bound);
+    if (out->data != NULL)
+    {
+        zs.next_in = in->data;
+        zs.avail_in = (uInt)in->len;
+        zs.next_out = out->data;
+        zs.avail_out = (uInt)bound;
+        if (deflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out < in->len - in->len / 8)
+        {
+            out->len = zs.total_out;
+        }
+        else
+        {
+            free(out->data);
+            out->data = NULL;
+        }
+    }
+    deflateEnd(&zs);
+}
+
+/**
+ * Brotli variant from "name.br" next to the original, made offline with brotli(1).
+ */
+static void load_brotli(t_asset *a, const char *root)
+{
+    char path[PATH_MAX];
+    struct stat st_orig;
+    struct stat st_br;
+    t_asset_variant *out = &a->variant[ASSET_BROTLI];
+
+    if (snprintf(path, sizeof(path), "%s/%s", root, a->path) >= (int)sizeof(path) - 3 ||
+        stat(path, &st_orig) != 0)
+        return;
+    strcat(path, ".br");
+    if (stat(path, &st_br) != 0)
+        return;
+    // A stale variant would serve old content under the new ETag
+    if (st_br.st_mtime < st_orig.st_mtime)
+    {
+        fprintf(stderr, "Ignoring %s, older than the original\n", path);
+        return;
+    }
+    out->data = read_file(path, &out->len);
+}
+
+/**
+ * Read the client tree below root into memory.
+ */
+int assets_load(const char *root)
+{
+    size_t bytes[ASSET_ENCODINGS] = {0, 0, 0};
+    size_t i;
+    int e;
+
+    assets_free();
+    asset_root_len = strlen(root);
+    if (nftw(root, add_file, 16, FTW_PHYS | FTW_ACTIONRETVAL) != 0)
+    {
+        fprintf(stderr, "Failed to read client files from %s: %s\n", root, strerror(errno));
+        assets_free();
+        return EXIT_FAILURE;
+    }
+    qsort(assets, asset_count, sizeof(t_asset), compare_path);
+
+    // Versions of all files first, pages then reference them
+    for (i = 0; i < asset_count; i++)
+        stamp(&assets[i]);
+    for (i = 0; i < asset_count; i++)
+    {
+        t_asset *a = &assets[i];
+        unsigned char *data;
+        size_t len;
+
+        if (is_page(a) && (data = version_references(a, &len)) != NULL)
+        {
+            free(a->variant[ASSET_IDENTITY].data);
+            a->variant[ASSET_IDENTITY].data = data;
+            a->variant[ASSET_IDENTITY].len = len;
+            stamp(a);
+        }
+    }
+    for (i = 0; i < asset_count; i++)
+    {
+        t_asset *a = &assets[i];
+
+        compress_gzip(a);
+        // Pages are rewritten in memory, a file made from the original would not match
+        if (!is_page(a))
+            load_brotli(a, root);
+        for (e = 0; e < ASSET_ENCODINGS; e++)
+            bytes[e] += a->variant[e].len;
+    }
+
+    fprintf(stderr, "Serving %zu client files from %s, %zu bytes, %zu gzip, %zu brotli\n",
+            asset_count, root, bytes[ASSET_IDENTITY], bytes[ASSET_GZIP], bytes[ASSET_BROTLI]);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * True when coding is listed in an Accept-Encoding header with non-zero quality.
+ */
+static bool accepts(const char *header, const char *coding)
+{
+    size_t clen = strlen(coding);
+    const char *p = header;
+
+    while (*p != '\0')
+    {
+        const char *token;
+        size_t tlen;
+
+        while (*p == ' ' || *p == '\t' || *p == ',')
+            p++;
+        token = p;
+        tlen = strcspn(p, " \t,;");
+        p += tlen;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (tlen == clen && strncasecmp(token, coding, clen) == 0)
+        {
+            const char *q = strstr(p, "q=");
+            if (*p != ';' || q == NULL || (size_t)(q - p) > strcspn(p, ","))
+                return true;
+            return atof(q + 2) > 0.0;
+        }
+        p += strcspn(p, ",");
+    }
+    return false;
+}
+
+/**
+ * Smallest variant the client accepts.
+ */
+t_asset_encoding assets_select(const t_asset *asset, const char *accept_encoding)
+{
+    if (accept_encoding == NULL)
+        return ASSET_IDENTITY;
+    if (asset->variant[ASSET_BROTLI].data != NULL && accepts(accept_encoding, "br"))
+        return ASSET_BROTLI;
+    if (asset->variant[ASSET_GZIP].data != NULL && accepts(accept_encoding, "gzip"))
+        return ASSET_GZIP;
+    return ASSET_IDENTITY;
+}
+
+/**
+ * Content-Encoding header value, NULL for identity.
+ */
+const char *assets_encoding_name(t_asset_encoding encoding)
+{
+    switch (encoding)
+    {
+    case ASSET_GZIP:
+        return "gzip";
+    case ASSET_BROTLI:
+        return "br";
+    default:
+        return NULL;
+    }
+}
+
+void assets_free(void)
+{
+    size_t i;
+    int e;
+
+    for (i = 0; i < asset_count; i++)
+    {
+        free(assets[i].path);
+        for (e = 0; e < ASSET_ENCODINGS; e++)
+            free(assets[i].variant[e].data);
+    }
+    asset_count = 0;
+}
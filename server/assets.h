@@ -0,0 +1,70 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// In-memory bundle of the web client, served by meteoserver.
+//
+// All files below the client root are read once at startup. Compressible
+// files get a gzip variant, a brotli variant is taken from a "name.br" file
+// next to the original when one exists and is not older. Every variant has
+// its own strong ETag derived from the content. HTML pages reference the
+// other assets with a "?v=" content version, so those URLs never change
+// content and can be cached as immutable.
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+
+#define ASSETS_ROOT "/usr/share/webmeteo"
+#define ASSETS_INDEX "index.html"
+#define ASSETS_MAX_FILES 256
+#define ASSETS_MAX_SIZE (4 * 1024 * 1024) // Per file [Byte]
+#define ASSETS_GZIP_LEVEL 9
+#define ASSETS_VERSION_ARG "v"
+#define ASSETS_CACHE_IMMUTABLE "public, max-age=31536000, immutable" // Versioned URLs
+
+typedef enum
+{
+    ASSET_IDENTITY = 0,
+    ASSET_GZIP,
+    ASSET_BROTLI,
+    ASSET_ENCODINGS
+} t_asset_encoding;
+
+typedef struct
+{
+    unsigned char *data; // NULL when this encoding is not available
+    size_t len;
+    char etag[24];       // Quoted strong ETag
+} t_asset_variant;
+
+typedef struct
+{
+    char *path;       // Relative to the root, no leading slash
+    const char *mime;
+    char version[9];  // Content version for "?v=" URLs
+    t_asset_variant variant[ASSET_ENCODINGS];
+} t_asset;
+
+int assets_load(const char *root);
+const t_asset *assets_find(const char *path);
+t_asset_encoding assets_select(const t_asset *asset, const char *accept_encoding);
+const char *assets_encoding_name(t_asset_encoding encoding);
+const char *assets_mime(const char *path);
+void assets_free(void);
+
+#endif /* ASSETS_H */
@@ -0,0 +1,118 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include "average.h"
+
+/**
+ * Slide the direction window by one sample in constant time.
+ */
+static void direction_update(t_moving_avg *avg, const t_maws_sample *sample)
+{
+    t_circular_sample *slot = &avg->direction_arr[avg->direction_next];
+
+    if (avg->direction.count == MOVING_AVG_LENGTH)
+        circular_remove(&avg->direction, slot);
+    circular_sample(slot, sample->windspeed, sample->wind_direction);
+    circular_add(&avg->direction, slot);
+    avg->direction_next = (avg->direction_next + 1) % MOVING_AVG_LENGTH;
+
+    // Removing a sample leaves rounding residue in the sine and cosine sums,
+    // rebuild them from the 30 samples each time the ring wraps
+    if (avg->direction_next == 0)
+    {
+        circular_clear(&avg->direction);
+        for (int i = 0; i < MOVING_AVG_LENGTH; i++)
+            circular_add(&avg->direction, &avg->direction_arr[i]);
+    }
+}
+
+/**
+ * Means of a filled window, returns false while the arrays are still filling up.
+ */
+bool moving_avg_mean(const t_moving_avg *avg, t_mean_values *mean)
+{
+    double temperature_mean = 0.0;
+    double humidity_mean = 0.0;
+    double windspeed_mean = 0.0;
+    double cross_wind_mean = 0.0;
+    double head_wind_mean = 0.0;
+    t_circular_stats direction;
+
+    if (avg->index < MOVING_AVG_LENGTH)
+        return false;
+
+    for (int i = 0; i < MOVING_AVG_LENGTH; i++)
+    {
+        temperature_mean += avg->temperature_arr[i];
+        humidity_mean += avg->humidity_arr[i];
+        windspeed_mean += avg->windspeed_arr[i];
+        cross_wind_mean += avg->cross_wind_arr[i];
+        head_wind_mean += avg->head_wind_arr[i];
+    }
+
+    mean->temperature = temperature_mean / (double)MOVING_AVG_LENGTH;
+    mean->humidity = humidity_mean / (double)MOVING_AVG_LENGTH;
+    mean->windspeed = windspeed_mean / (double)MOVING_AVG_LENGTH;
+    mean->cross_wind = cross_wind_mean / (double)MOVING_AVG_LENGTH;
+    mean->head_wind = head_wind_mean / (double)MOVING_AVG_LENGTH;
+
+    circular_stats(&avg->direction, &direction);
+    mean->wind_direction = direction.weighted_mean;
+    mean->wind_direction_unit = direction.unit_mean;
+    mean->wind_direction_std = direction.std;
+
+    return true;
+}
+
+/**
+ * Add a new sample to the moving average window.
+ * Returns true and updates mean once the window is filled, mean is left
+ * untouched while the arrays are still filling up.
+ */
+bool moving_avg_update(t_moving_avg *avg, const t_maws_sample *sample,
+                       const t_wind_components *w, t_mean_values *mean)
+{
+    direction_update(avg, sample);
+
+    // Fill arrays before we calculate average
+    if (avg->index < MOVING_AVG_LENGTH)
+    {
+        avg->temperature_arr[avg->index] = sample->temperature;
+        avg->humidity_arr[avg->index] = sample->humidity;
+        avg->windspeed_arr[avg->index] = sample->windspeed;
+        avg->cross_wind_arr[avg->index] = w->cross_wind;
+        avg->head_wind_arr[avg->index] = w->head_wind;
+        avg->index += 1;
+        return false;
+    }
+
+    // Left shift all arrays
+    memmove(&avg->temperature_arr[0], &avg->temperature_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
+    memmove(&avg->humidity_arr[0], &avg->humidity_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(unsigned char));
+    memmove(&avg->windspeed_arr[0], &avg->windspeed_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
+    memmove(&avg->cross_wind_arr[0], &avg->cross_wind_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
+    memmove(&avg->head_wind_arr[0], &avg->head_wind_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
+    // Add new value at the end
+    avg->temperature_arr[MOVING_AVG_LENGTH - 1] = sample->temperature;
+    avg->humidity_arr[MOVING_AVG_LENGTH - 1] = sample->humidity;
+    avg->windspeed_arr[MOVING_AVG_LENGTH - 1] = sample->windspeed;
+    avg->cross_wind_arr[MOVING_AVG_LENGTH - 1] = w->cross_wind;
+    avg->head_wind_arr[MOVING_AVG_LENGTH - 1] = w->head_wind;
+
+    return moving_avg_mean(avg, mean);
+}
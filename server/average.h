@@ -0,0 +1,58 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AVERAGE_H
+#define AVERAGE_H
+
+#include <stdbool.h>
+#include "maws.h"
+#include "derived.h"
+#include "circular.h"
+
+#define MOVING_AVG_LENGTH 30 // Moving average length in seconds
+
+// Storage for moving average over 30s
+typedef struct
+{
+    double temperature_arr[MOVING_AVG_LENGTH];
+    unsigned char humidity_arr[MOVING_AVG_LENGTH];
+    double windspeed_arr[MOVING_AVG_LENGTH];
+    double cross_wind_arr[MOVING_AVG_LENGTH];
+    double head_wind_arr[MOVING_AVG_LENGTH];
+    t_circular_sample direction_arr[MOVING_AVG_LENGTH]; // Ring, oldest at direction_next
+    t_circular direction;
+    unsigned char direction_next;
+    unsigned char index;
+} t_moving_avg;
+
+typedef struct
+{
+    double temperature;
+    double humidity;
+    double windspeed;
+    double cross_wind;
+    double head_wind;
+    double wind_direction;      // Speed weighted vector mean [deg]
+    double wind_direction_unit; // Unit vector mean [deg]
+    double wind_direction_std;  // Yamartino standard deviation [deg]
+} t_mean_values;
+
+bool moving_avg_mean(const t_moving_avg *avg, t_mean_values *mean);
+bool moving_avg_update(t_moving_avg *avg, const t_maws_sample *sample,
+                       const t_wind_components *w, t_mean_values *mean);
+
+#endif /* AVERAGE_H */
@@ -0,0 +1,582 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Microbenchmarks for the ingest, statistics, encoding and recording hot paths.
+// Every result is printed as one JSON object per line:
+// {"name":"maws_parse_line","ops":N,"ns_per_op":x,"allocs_per_op":y,"bytes_per_op":z}
+// Allocations are counted by wrapping malloc and friends at link time,
+// see the bench target in the Makefile.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <getopt.h>
+#include <math.h>
+#include <ftw.h>
+#include "maws.h"
+#include "derived.h"
+#include "average.h"
+#include "packet.h"
+#include "record.h"
+#include "rollup.h"
+#include "compliance.h"
+#include "qc.h"
+#include "absorption.h"
+#include "ingest.h"
+#include "state.h"
+#include "archive.h"
+#include "bus.h"
+#include "fusion.h"
+#include "summary.h"
+
+#define NOTUSED(V) ((void)V)
+#define BENCH_RUNS 5         // Runs per benchmark, median is reported
+#define BENCH_MIN_TIME_MS 200 // Minimum duration of a single run
+#define BATCH_MAX_ERROR 1e-9  // Allowed difference of batch kernel to scalar results
+#define REPLAY_INTERVAL 1.0   // Line interval of the replayed MAWS log [s]
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+
+static unsigned long long alloc_count = 0;
+static unsigned long long alloc_bytes = 0;
+static unsigned int min_time_ms = BENCH_MIN_TIME_MS;
+static volatile double sink;
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+// Fixed input set, taken from vaisalla_log.txt
+static const char *sample_lines[] = {
+    "  22.1\t  39\t  978.0\t   0.0\t  114\t09\t34\t02\r\n",
+    "  22.1\t  39\t  978.0\t   0.2\t  116\t09\t34\t05\r\n",
+    "  22.3\t  40\t  978.1\t   1.4\t  241\t09\t35\t11\r\n",
+    "  -3.7\t  87\t 1013.2\t  12.6\t  359\t23\t59\t59\r\n",
+    "  35.0\t 100\t  945.9\t   5.1\t    0\t00\t00\t00\r\n",
+    "  22.1\t  39\t  978.0\t garbage\r\n",
+    "  18.4\t  55\t  981.7\t   3.3\t  180\t12\t00\t30\r\n",
+    "  22.1\t  39\t  978.0\t   0.0\t  125\t09\t34\t03\r\n"};
+#define NUM_SAMPLE_LINES (sizeof(sample_lines) / sizeof(sample_lines[0]))
+
+static t_maws_sample samples[NUM_SAMPLE_LINES];
+static t_packet_data packet;
+static t_moving_avg avg;
+
+typedef void (*bench_fn)(unsigned long long iterations);
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Run a benchmark until it takes at least min_time_ms, then repeat
+ * BENCH_RUNS times with the found iteration count and report the median.
+ * ops is the number of operations done by one iteration.
+ */
+static void run_bench(const char *name, bench_fn fn, unsigned long long ops)
+{
+    unsigned long long iterations = 1;
+    unsigned long long start, elapsed, allocs, bytes;
+    double ns_per_op[BENCH_RUNS];
+
+    // Warm up and calibrate
+    for (;;)
+    {
+        start = now_ns();
+        fn(iterations);
+        elapsed = now_ns() - start;
+        if (elapsed >= min_time_ms * 1000000ULL)
+            break;
+        iterations *= 2;
+    }
+
+    allocs = alloc_count;
+    bytes = alloc_bytes;
+    for (int i = 0; i < BENCH_RUNS; i++)
+    {
+        start = now_ns();
+        fn(iterations);
+        elapsed = now_ns() - start;
+        ns_per_op[i] = (double)elapsed / (double)(iterations * ops);
+    }
+    allocs = alloc_count - allocs;
+    bytes = alloc_bytes - bytes;
+    qsort(ns_per_op, BENCH_RUNS, sizeof(double), compare_double);
+
+    printf("{\"name\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.2f,\"ns_per_op_min\":%.2f,\"ns_per_op_max\":%.2f,"
+           "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+           name,
+           iterations * ops,
+           ns_per_op[BENCH_RUNS / 2],
+           ns_per_op[0],
+           ns_per_op[BENCH_RUNS - 1],
+           (double)allocs / (double)(iterations * ops * BENCH_RUNS),
+           (double)bytes / (double)(iterations * ops * BENCH_RUNS));
+    fflush(stdout);
+}
+
+static void bench_parse(unsigned long long iterations)
+{
+    t_maws_sample s;
+    int ok = 0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+        ok += maws_parse_line(sample_lines[i % NUM_SAMPLE_LINES], &s);
+    sink = ok + s.temperature;
+}
+
+static void bench_moving_avg(unsigned long long iterations)
+{
+    t_wind_components w;
+    t_mean_values mean = {0};
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        const t_maws_sample *s = &samples[i % NUM_SAMPLE_LINES];
+        w.cross_wind = s->windspeed;
+        w.head_wind = s->windspeed;
+        w.wind_comp1 = s->windspeed;
+        w.wind_comp2 = s->windspeed;
+        moving_avg_update(&avg, s, &w, &mean);
+    }
+    sink = mean.windspeed;
+}
+
+static void bench_wind_components(unsigned long long iterations)
+{
+    t_wind_components w;
+    double sum = 0.0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        const t_maws_sample *s = &samples[i % NUM_SAMPLE_LINES];
+        wind_components(s->windspeed, s->wind_direction, 248, &w);
+        sum += w.cross_wind;
+    }
+    sink = sum;
+}
+
+static void bench_qfe_qnh(unsigned long long iterations)
+{
+    double sum = 0.0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        const t_maws_sample *s = &samples[i % NUM_SAMPLE_LINES];
+        sum += baro_qnh(baro_qfe(s->pressure, s->temperature, 1), 1204);
+    }
+    sink = sum;
+}
+
+#define BATCH_SIZE 1024
+
+static double batch_windspeed[BATCH_SIZE];
+static unsigned short batch_direction[BATCH_SIZE];
+static double batch_pressure[BATCH_SIZE];
+static double batch_temperature[BATCH_SIZE];
+static double batch_out[6][BATCH_SIZE];
+static const t_derived_block batch_block = {batch_windspeed, batch_direction, batch_pressure, batch_temperature,
+                                            batch_out[0], batch_out[1], batch_out[2], batch_out[3],
+                                            batch_out[4], batch_out[5]};
+
+static void init_batch(void)
+{
+    for (int i = 0; i < BATCH_SIZE; i++)
+    {
+        const t_maws_sample *s = &samples[i % NUM_SAMPLE_LINES];
+        batch_windspeed[i] = s->windspeed + (i % 17) * 0.3;
+        batch_direction[i] = (unsigned short)((i * 7) % 360);
+        batch_pressure[i] = s->pressure;
+        batch_temperature[i] = s->temperature;
+    }
+}
+
+static void bench_derived_batch(unsigned long long iterations)
+{
+    t_derived_const c;
+
+    derived_const_init(&c, 248, 1204, 1);
+    for (unsigned long long i = 0; i < iterations; i++)
+        derived_batch(&c, &batch_block, BATCH_SIZE);
+    sink = batch_out[5][BATCH_SIZE - 1];
+}
+
+/**
+ * Compare batch kernel against the scalar functions.
+ * Returns the maximum absolute difference over all outputs.
+ */
+static double validate_derived_batch(void)
+{
+    static const unsigned short headings[] = {0, 45, 90, 180, 248, 270, 359};
+    static const unsigned short elevations[] = {0, 1204, 5000};
+    double max_err = 0.0;
+    t_derived_const c;
+    t_wind_components w;
+
+    for (size_t h = 0; h < sizeof(headings) / sizeof(headings[0]); h++)
+    {
+        for (size_t e = 0; e < sizeof(elevations) / sizeof(elevations[0]); e++)
+        {
+            derived_const_init(&c, headings[h], elevations[e], 1);
+            derived_batch(&c, &batch_block, BATCH_SIZE);
+            for (int i = 0; i < BATCH_SIZE; i++)
+            {
+                double qfe = baro_qfe(batch_pressure[i], batch_temperature[i], 1);
+                double ref[6];
+                wind_components(batch_windspeed[i], batch_direction[i], headings[h], &w);
+                ref[0] = w.cross_wind;
+                ref[1] = w.head_wind;
+                ref[2] = w.wind_comp1;
+                ref[3] = w.wind_comp2;
+                ref[4] = qfe;
+                ref[5] = baro_qnh(qfe, elevations[e]);
+                for (int k = 0; k < 6; k++)
+                {
+                    double err = fabs(batch_out[k][i] - ref[k]);
+                    if (err > max_err)
+                        max_err = err;
+                }
+            }
+        }
+    }
+    return max_err;
+}
+
+static t_rollup rollup;
+
+static void bench_rollup(unsigned long long iterations)
+{
+    t_rollup_stats stats[ROLLUP_NUM_WINDOWS];
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        rollup_update(&rollup, (double)rollup.seq, samples[i % NUM_SAMPLE_LINES].windspeed,
+                      samples[i % NUM_SAMPLE_LINES].wind_direction);
+        rollup_stats(&rollup, stats);
+    }
+    sink = stats[ROLLUP_NUM_WINDOWS - 1].gust;
+}
+
+static void bench_compliance(unsigned long long iterations)
+{
+    t_compliance_limits l = {COMPLIANCE_10DB, COMPLIANCE_WIND_LIMIT, COMPLIANCE_CROSS_WIND_LIMIT};
+    unsigned int sum = 0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        // Sweep the humidity chart so all windows and cells are hit
+        double t = COMPLIANCE_T_MIN + (double)(i % 503) * 0.1;
+        double h = (double)((i * 7) % 101);
+        sum += compliance_evaluate(&l, t, h, samples[i % NUM_SAMPLE_LINES].windspeed, 3.0);
+    }
+    sink = sum;
+}
+
+static void bench_qc(unsigned long long iterations)
+{
+    t_qc qc;
+    unsigned int flags = 0;
+
+    qc_init(&qc);
+    for (unsigned long long i = 0; i < iterations; i++)
+        flags |= qc_sample(&qc, &samples[i % NUM_SAMPLE_LINES], (double)i);
+    sink = flags;
+}
+
+static void bench_absorption(unsigned long long iterations)
+{
+    t_absorption_band bands[ABSORPTION_NUM_BANDS];
+    double sum = 0.0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        const t_maws_sample *s = &samples[i % NUM_SAMPLE_LINES];
+        absorption_compute(s->temperature, s->humidity, s->pressure, bands);
+        sum += bands[ABSORPTION_NUM_BANDS - 1].alpha;
+    }
+    sink = sum;
+}
+
+static void bench_packet_encode(unsigned long long iterations)
+{
+    unsigned char buf[PACKET_SIZE];
+    size_t len = 0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        packet.maws_sec = (unsigned char)i;
+        len += packet_encode(buf, sizeof(buf), &packet);
+    }
+    sink = (double)len + buf[0];
+}
+
+static void bench_csv_row(unsigned long long iterations)
+{
+    char row[RECORD_ROW_SIZE];
+    struct tm t = {0};
+    int len = 0;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        t.tm_sec = (int)(i % 60);
+        packet.windspeed = samples[i % NUM_SAMPLE_LINES].windspeed;
+        len += record_format_row(row, sizeof(row), &packet, &t);
+    }
+    sink = len;
+}
+
+// Replay buffer and sinks for the end to end benchmark
+static char *replay_buf = NULL;
+static size_t replay_len = 0;
+static size_t replay_lines = 0;
+static FILE *replay_out = NULL;
+static char replay_state[] = "/tmp/meteobench-state-XXXXXX";
+static char replay_archive[] = "/tmp/meteobench-archive-XXXXXX";
+static t_ingest replay_ingest;
+static t_fusion replay_fusion;
+static t_bus_cursor replay_cursor;
+static t_summary replay_summary;
+static time_t replay_start;
+static unsigned long long replay_seq = 0; // Lines replayed, the replay clock never goes back
+
+/**
+ * End to end replay of a MAWS log, one line every REPLAY_INTERVAL of replay
+ * clock. Every line runs handle_serial_line of meteoserver, state checkpoint
+ * and archive included, the packet encoding of the websocket sink and the
+ * record timer: bus, fusion without GPS, run summary and CSV row.
+ */
+static void bench_replay(unsigned long long iterations)
+{
+    t_maws_sample s;
+    t_packet_data p = {0};
+    t_bus_sample in;
+    t_fusion_sample joined;
+    unsigned char buf[PACKET_SIZE];
+    char row[RECORD_ROW_SIZE];
+    struct tm t;
+    unsigned char changed;
+
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+        char *line = replay_buf;
+        char *end = replay_buf + replay_len;
+
+        while (line < end)
+        {
+            char *eol = memchr(line, '\n', (size_t)(end - line));
+            if (eol == NULL)
+                eol = end;
+
+            if (maws_parse_line(line, &s) == EXIT_SUCCESS)
+            {
+                double ts = (double)replay_seq * REPLAY_INTERVAL;
+                struct timespec wall = {replay_start + (time_t)ts, 0};
+
+                replay_seq++;
+                ingest_runway(&replay_ingest, 248, 1204, 1);
+                ingest_sample(&replay_ingest, &s, ts, &wall, &changed);
+                ingest_packet(&replay_ingest, &p);
+                bus_publish(BUS_SOURCE_MAWS, &p, ts, &wall);
+                packet_encode(buf, sizeof(buf), &p);
+
+                while (bus_read(&replay_cursor, &in) == BUS_OK)
+                    fusion_add_maws(&replay_fusion, &in.packet, in.t, &in.wall);
+                while (fusion_next(&replay_fusion, ts, &joined))
+                {
+                    localtime_r(&joined.wall.tv_sec, &t);
+                    record_format_row(row, sizeof(row), &joined.packet, &t);
+                    summary_update(&replay_summary, &joined.packet);
+                    fputs(row, replay_out);
+                }
+            }
+            line = eol + 1;
+        }
+    }
+    sink = p.baro_qnh;
+}
+
+static int load_replay(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    long size;
+    int fd;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return EXIT_FAILURE;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    replay_buf = malloc((size_t)size + 1);
+    if (replay_buf == NULL || fread(replay_buf, 1, (size_t)size, fp) != (size_t)size)
+    {
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    fclose(fp);
+    replay_buf[size] = '\0';
+    replay_len = (size_t)size;
+    for (size_t i = 0; i < replay_len; i++)
+    {
+        if (replay_buf[i] == '\n')
+            replay_lines++;
+    }
+
+    // State and archive are written to temporary files like in meteoserver
+    fd = mkstemp(replay_state);
+    if (fd < 0 || mkdtemp(replay_archive) == NULL)
+    {
+        fprintf(stderr, "Failed to create replay state and archive in /tmp\n");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    if (state_open(replay_state) != EXIT_SUCCESS || archive_open(replay_archive) != EXIT_SUCCESS ||
+        ingest_init(&replay_ingest, NULL) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    fusion_init(&replay_fusion, 0.0);
+    bus_subscribe(&replay_cursor, BUS_OLDEST);
+    replay_start = time(NULL);
+    summary_start(&replay_summary, 1, 1, replay_start);
+
+    replay_out = fopen("/dev/null", "w");
+    return (replay_out != NULL) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    NOTUSED(st);
+    NOTUSED(flag);
+    NOTUSED(ftw);
+    return remove(path);
+}
+
+static void close_replay(void)
+{
+    archive_close();
+    state_close();
+    ingest_free(&replay_ingest);
+    unlink(replay_state);
+    nftw(replay_archive, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    fclose(replay_out);
+    free(replay_buf);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-c core] [-t min_time_ms] [maws log file]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+        {
+            // Pin to one core for reproducible results
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(atoi(optarg), &cpuset);
+            if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) != 0)
+                fprintf(stderr, "Failed to pin benchmark to core %s\n", optarg);
+            break;
+        }
+        case 't':
+            min_time_ms = (unsigned int)atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i < NUM_SAMPLE_LINES; i++)
+        maws_parse_line(sample_lines[i], &samples[i]);
+
+    run_bench("maws_parse_line", bench_parse, 1);
+    run_bench("moving_avg_update", bench_moving_avg, 1);
+    if (rollup_init(&rollup) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    run_bench("rollup_update", bench_rollup, 1);
+    run_bench("wind_components", bench_wind_components, 1);
+    run_bench("baro_qfe_qnh", bench_qfe_qnh, 1);
+    run_bench("compliance_evaluate", bench_compliance, 1);
+    run_bench("qc_sample", bench_qc, 1);
+    run_bench("absorption_compute", bench_absorption, 1);
+
+    init_batch();
+    double err = validate_derived_batch();
+    printf("{\"name\":\"derived_batch_validation\",\"max_abs_error\":%g,\"pass\":%s}\n",
+           err, err <= BATCH_MAX_ERROR ? "true" : "false");
+    if (err > BATCH_MAX_ERROR)
+        return EXIT_FAILURE;
+    run_bench("derived_batch", bench_derived_batch, BATCH_SIZE);
+    run_bench("packet_encode", bench_packet_encode, 1);
+    run_bench("record_format_row", bench_csv_row, 1);
+
+    if (optind < argc)
+    {
+        if (load_replay(argv[optind]) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        // Reported per log line
+        fprintf(stderr, "Replaying %zu lines from %s\n", replay_lines, argv[optind]);
+        run_bench("replay", bench_replay, replay_lines);
+        close_replay();
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,78 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <pthread.h>
+#include "bus.h"
+
+static t_bus_sample slots[BUS_SLOTS];
+static uint64_t head = 0; // Samples published
+static pthread_mutex_t bus_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Publish a copy of packet data p, ingested at monotonic time t and wall clock time wall.
+ */
+void bus_publish(unsigned char source, const t_packet_data *p, double t, const struct timespec *wall)
+{
+    t_bus_sample *s;
+
+    pthread_mutex_lock(&bus_lock);
+    s = &slots[head % BUS_SLOTS];
+    s->seq = head;
+    s->t = t;
+    s->wall = *wall;
+    s->source = source;
+    s->packet = *p;
+    head++;
+    pthread_mutex_unlock(&bus_lock);
+}
+
+/**
+ * Attach a cursor, it sees samples published from now on.
+ */
+void bus_subscribe(t_bus_cursor *c, int policy)
+{
+    pthread_mutex_lock(&bus_lock);
+    c->next = head;
+    pthread_mutex_unlock(&bus_lock);
+    c->policy = policy;
+    c->dropped = 0;
+}
+
+/**
+ * Copy the next sample of cursor c into out.
+ */
+int bus_read(t_bus_cursor *c, t_bus_sample *out)
+{
+    pthread_mutex_lock(&bus_lock);
+    if (c->next == head)
+    {
+        pthread_mutex_unlock(&bus_lock);
+        return BUS_EMPTY;
+    }
+    if (c->policy == BUS_LATEST)
+    {
+        c->next = head - 1;
+    }
+    else if (head - c->next > BUS_SLOTS)
+    {
+        c->dropped += head - BUS_SLOTS - c->next;
+        c->next = head - BUS_SLOTS;
+    }
+    *out = slots[c->next % BUS_SLOTS];
+    c->next++;
+    pthread_mutex_unlock(&bus_lock);
+    return BUS_OK;
+}
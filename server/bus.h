@@ -0,0 +1,72 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Internal publish/subscribe bus of packet snapshots.
+//
+// Producers (serial, GPS and control requests) publish an immutable copy of
+// the packet data into a bounded ring. Every sink reads through its own
+// cursor at its own pace and never holds the bus lock beyond copying one
+// sample, so a stalled disk or client cannot hold up ingestion. The ring
+// never waits for readers: a sink falling more than BUS_SLOTS samples behind
+// loses samples according to its overflow policy:
+//
+//     BUS_OLDEST  resume at the oldest retained sample, lost ones are counted
+//     BUS_LATEST  skip to the newest sample, for sinks that only need state
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+#include <time.h>
+#include "meteoserver.h"
+
+#define BUS_SLOTS 256 // Power of two, several seconds at the highest MAWS and GPS rates
+
+// Sample sources
+#define BUS_SOURCE_MAWS 1  // New MAWS line
+#define BUS_SOURCE_GPS 2   // New GPS fix
+#define BUS_SOURCE_STATE 3 // Settings, status or GPS report without a new fix
+
+// Overflow policies
+#define BUS_OLDEST 0
+#define BUS_LATEST 1
+
+// bus_read() results
+#define BUS_OK 0
+#define BUS_EMPTY 1
+
+typedef struct
+{
+    uint64_t seq;
+    double t;             // Monotonic ingestion time [s]
+    struct timespec wall; // Wall clock ingestion time
+    unsigned char source;
+    t_packet_data packet;
+} t_bus_sample;
+
+typedef struct
+{
+    uint64_t next; // Sequence number of the next sample to read
+    int policy;
+    unsigned long dropped; // Samples lost to overflow with BUS_OLDEST
+} t_bus_cursor;
+
+void bus_publish(unsigned char source, const t_packet_data *p, double t, const struct timespec *wall);
+void bus_subscribe(t_bus_cursor *c, int policy);
+int bus_read(t_bus_cursor *c, t_bus_sample *out);
+
+#endif /* BUS_H */
@@ -0,0 +1,88 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Circular statistics for wind direction.
+// Yamartino, R.J., 1984: A Comparison of Several "Single-Pass" Estimators of
+// the Standard Deviation of Wind Direction. J. Climate Appl. Meteor., 23.
+
+#include <math.h>
+#include "circular.h"
+#include "derived.h"
+
+#ifndef RAD_2_DEG
+#define RAD_2_DEG 57.2957795130823208768
+#endif
+
+static double direction(double s, double c)
+{
+    double d = atan2(s, c) * RAD_2_DEG;
+    return (d < 0.0) ? d + 360.0 : d;
+}
+
+void circular_sample(t_circular_sample *s, double speed, unsigned short direction)
+{
+    deg_sincos(direction, &s->sin_dir, &s->cos_dir);
+    s->speed = speed;
+}
+
+void circular_clear(t_circular *c)
+{
+    c->sum_sin = 0.0;
+    c->sum_cos = 0.0;
+    c->sum_wsin = 0.0;
+    c->sum_wcos = 0.0;
+    c->count = 0;
+}
+
+void circular_add(t_circular *c, const t_circular_sample *s)
+{
+    c->sum_sin += s->sin_dir;
+    c->sum_cos += s->cos_dir;
+    c->sum_wsin += s->speed * s->sin_dir;
+    c->sum_wcos += s->speed * s->cos_dir;
+    c->count++;
+}
+
+void circular_remove(t_circular *c, const t_circular_sample *s)
+{
+    c->sum_sin -= s->sin_dir;
+    c->sum_cos -= s->cos_dir;
+    c->sum_wsin -= s->speed * s->sin_dir;
+    c->sum_wcos -= s->speed * s->cos_dir;
+    c->count--;
+}
+
+void circular_stats(const t_circular *c, t_circular_stats *st)
+{
+    double sa, ca, r2, eps;
+
+    if (c->count == 0)
+    {
+        st->unit_mean = st->weighted_mean = st->std = st->steadiness = 0.0;
+        return;
+    }
+
+    sa = c->sum_sin / c->count;
+    ca = c->sum_cos / c->count;
+    r2 = sa * sa + ca * ca;
+    st->unit_mean = direction(sa, ca);
+    st->weighted_mean = direction(c->sum_wsin, c->sum_wcos);
+    st->steadiness = sqrt(r2);
+    // Yamartino estimator
+    eps = (r2 < 1.0) ? sqrt(1.0 - r2) : 0.0;
+    st->std = asin(eps) * (1.0 + (2.0 / sqrt(3.0) - 1.0) * eps * eps * eps) * RAD_2_DEG;
+}
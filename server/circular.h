@@ -0,0 +1,59 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CIRCULAR_H
+#define CIRCULAR_H
+
+/**
+ * Wind direction sample as unit vector plus speed.
+ */
+typedef struct
+{
+    double sin_dir;
+    double cos_dir;
+    double speed;
+} t_circular_sample;
+
+/**
+ * Running sums over the samples of one window.
+ * The window itself is kept by the caller, samples leaving it are removed
+ * with the same values they were added with.
+ */
+typedef struct
+{
+    double sum_sin;
+    double sum_cos;
+    double sum_wsin; // Speed weighted
+    double sum_wcos;
+    unsigned int count;
+} t_circular;
+
+typedef struct
+{
+    double unit_mean;     // Mean direction of unit vectors [deg]
+    double weighted_mean; // Mean direction of speed weighted vectors [deg]
+    double std;           // Yamartino standard deviation [deg]
+    double steadiness;    // Mean resultant length of unit vectors [0..1]
+} t_circular_stats;
+
+void circular_sample(t_circular_sample *s, double speed, unsigned short direction);
+void circular_clear(t_circular *c);
+void circular_add(t_circular *c, const t_circular_sample *s);
+void circular_remove(t_circular *c, const t_circular_sample *s);
+void circular_stats(const t_circular *c, t_circular_stats *st);
+
+#endif /* CIRCULAR_H */
@@ -0,0 +1,204 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "compliance.h"
+
+typedef struct
+{
+    double t; // [degC]
+    double h; // [%]
+} t_vertex;
+
+// ICAO windows, same as window0dB, window10dB and window12dB in client/scripts/charts.js
+static const t_vertex window_0db[] = {
+    {2, 95}, {30, 95}, {30, 35}, {15, 50}, {2, 90}, {2, 95}};
+
+static const t_vertex window_10db[] = {
+    {2, 77.04384}, {3, 73.36282}, {4, 69.88155}, {5, 66.59008}, {6, 63.47846}, {7, 60.54016},
+    {8, 57.77197}, {9, 55.16882}, {10, 52.72404}, {11, 50.42991}, {12, 48.27807}, {13, 46.25986},
+    {14, 44.36656}, {15, 42.58696}, {16, 40.90427}, {17, 39.30388}, {18, 37.77425}, {19, 36.30629},
+    {20, 34.89287}, {21, 33.52839}, {22, 32.21073}, {23, 30.9483}, {24, 29.74937}, {25, 28.61871},
+    {26, 27.55843}, {27, 26.56598}, {28, 25.63014}, {29, 24.74022}, {30, 23.88776}, {31, 23.0661},
+    {32, 22.27008}, {33, 21.49617}, {34, 20.743}, {35, 20.00973}, {35, 20}, {35, 95},
+    {2, 95}, {2, 77.04384}};
+
+static const t_vertex window_12db[] = {
+    {-4, 82.617969}, {-3, 78.47249}, {-2, 74.48067}, {-1, 70.68754}, {0, 67.11999}, {1, 63.79138},
+    {2, 60.7052}, {3, 57.857849}, {4, 55.24078}, {5, 52.83713}, {6, 50.61007}, {7, 48.52552},
+    {8, 46.55715}, {9, 44.68477}, {10, 42.89301}, {11, 41.17283}, {12, 39.52266}, {13, 37.94129},
+    {14, 36.42703}, {15, 34.97783}, {16, 33.59148}, {17, 32.26748}, {18, 31.00678}, {19, 29.80912},
+    {20, 28.6733}, {21, 27.59735}, {22, 26.5788}, {23, 25.61485}, {24, 24.70247}, {25, 23.83691},
+    {26, 23.01024}, {27, 22.21563}, {28, 21.44779}, {29, 20.70262}, {30, 20}, {30, 20},
+    {35, 20}, {35, 95}, {-4, 95}, {-4, 82.61796}};
+
+static const struct
+{
+    const t_vertex *v;
+    size_t n;
+    unsigned char flag;
+} windows[COMPLIANCE_NUM_WINDOWS] = {
+    {window_0db, sizeof(window_0db) / sizeof(window_0db[0]), COMPLIANCE_WINDOW_0DB},
+    {window_10db, sizeof(window_10db) / sizeof(window_10db[0]), COMPLIANCE_WINDOW_10DB},
+    {window_12db, sizeof(window_12db) / sizeof(window_12db[0]), COMPLIANCE_WINDOW_12DB}};
+
+/**
+ * Humidity interval of each window per grid temperature.
+ * All window vertices lie on grid temperatures, linear interpolation
+ * between two grid points is exact. Empty intervals mark temperatures
+ * outside the window.
+ */
+static double lower[COMPLIANCE_NUM_WINDOWS][COMPLIANCE_GRID_SIZE];
+static double upper[COMPLIANCE_NUM_WINDOWS][COMPLIANCE_GRID_SIZE];
+static pthread_once_t grid_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Intersect a vertical line with the window outline.
+ * Windows are bounded by one lower and one upper humidity curve.
+ */
+static void init_grid(void)
+{
+    for (int w = 0; w < COMPLIANCE_NUM_WINDOWS; w++)
+    {
+        for (int i = 0; i < COMPLIANCE_GRID_SIZE; i++)
+        {
+            double t = COMPLIANCE_T_MIN + i * COMPLIANCE_T_STEP;
+            double lo = INFINITY;
+            double hi = -INFINITY;
+
+            for (size_t k = 0; k + 1 < windows[w].n; k++)
+            {
+                const t_vertex *a = &windows[w].v[k];
+                const t_vertex *b = &windows[w].v[k + 1];
+
+                double h;
+
+                // Vertical edges only close the outline at the end points
+                if (a->t == b->t || t < fmin(a->t, b->t) || t > fmax(a->t, b->t))
+                    continue;
+                h = a->h + (t - a->t) * (b->h - a->h) / (b->t - a->t);
+                lo = fmin(lo, h);
+                hi = fmax(hi, h);
+            }
+            lower[w][i] = lo;
+            upper[w][i] = hi;
+        }
+    }
+}
+
+/**
+ * Check temperature and humidity against one window.
+ */
+static bool inside_window(int w, double temperature, double humidity)
+{
+    double x = (temperature - COMPLIANCE_T_MIN) / COMPLIANCE_T_STEP;
+    int i;
+    double f;
+
+    if (!(x >= 0.0 && x <= COMPLIANCE_GRID_SIZE - 1))
+        return false;
+    i = (int)x;
+    f = x - i;
+    if (i == COMPLIANCE_GRID_SIZE - 1 || f == 0.0)
+        return humidity >= lower[w][i] && humidity <= upper[w][i];
+    // Both neighbours have to be inside, the window border is on a grid point
+    if (lower[w][i] > upper[w][i] || lower[w][i + 1] > upper[w][i + 1])
+        return false;
+    return humidity >= lower[w][i] + f * (lower[w][i + 1] - lower[w][i]) &&
+           humidity <= upper[w][i] + f * (upper[w][i + 1] - upper[w][i]);
+}
+
+/**
+ * Initialize evaluation state with default or given limits.
+ */
+void compliance_init(t_compliance *c, const t_compliance_limits *limits)
+{
+    pthread_once(&grid_once, init_grid);
+    if (limits != NULL)
+    {
+        c->limits = *limits;
+    }
+    else
+    {
+        c->limits.window = COMPLIANCE_10DB;
+        c->limits.wind_limit = COMPLIANCE_WIND_LIMIT;
+        c->limits.cross_wind_limit = COMPLIANCE_CROSS_WIND_LIMIT;
+    }
+    c->flags = 0;
+}
+
+/**
+ * Select the required window by its attenuation [dB/100m].
+ */
+int compliance_set_window(t_compliance_limits *limits, int attenuation)
+{
+    switch (attenuation)
+    {
+    case 0:
+        limits->window = COMPLIANCE_0DB;
+        break;
+    case 10:
+        limits->window = COMPLIANCE_10DB;
+        break;
+    case 12:
+        limits->window = COMPLIANCE_12DB;
+        break;
+    default:
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Evaluate all windows and wind limits, returns compliance flags.
+ * Expects averaged values, wind in [kt].
+ */
+unsigned char compliance_evaluate(const t_compliance_limits *limits, double temperature, double humidity,
+                                  double windspeed, double cross_wind)
+{
+    unsigned char flags = 0;
+
+    pthread_once(&grid_once, init_grid);
+    for (int w = 0; w < COMPLIANCE_NUM_WINDOWS; w++)
+    {
+        if (inside_window(w, temperature, humidity))
+            flags |= windows[w].flag;
+    }
+    if (fabs(windspeed) <= limits->wind_limit)
+        flags |= COMPLIANCE_WIND;
+    if (fabs(cross_wind) <= limits->cross_wind_limit)
+        flags |= COMPLIANCE_CROSS_WIND;
+    if ((flags & windows[limits->window].flag) && (flags & COMPLIANCE_WIND) && (flags & COMPLIANCE_CROSS_WIND))
+        flags |= COMPLIANCE_VALID;
+    return flags;
+}
+
+/**
+ * Evaluate a new aggregate and track state transitions.
+ * Returns true when any flag changed, changed holds the toggled flags.
+ */
+bool compliance_update(t_compliance *c, double temperature, double humidity,
+                       double windspeed, double cross_wind, unsigned char *changed)
+{
+    unsigned char flags = compliance_evaluate(&c->limits, temperature, humidity, windspeed, cross_wind);
+
+    *changed = flags ^ c->flags;
+    c->flags = flags;
+    return *changed != 0;
+}
@@ -0,0 +1,68 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COMPLIANCE_H
+#define COMPLIANCE_H
+
+#include <stdbool.h>
+
+// Compliance flags, as sent in packet data and written to recordings
+#define COMPLIANCE_WINDOW_0DB 0x01   // Inside 0 dB temperature/humidity window
+#define COMPLIANCE_WINDOW_10DB 0x02  // Inside 10 dB temperature/humidity window
+#define COMPLIANCE_WINDOW_12DB 0x04  // Inside 12 dB temperature/humidity window
+#define COMPLIANCE_WIND 0x08         // Mean wind speed within limit
+#define COMPLIANCE_CROSS_WIND 0x10   // Mean cross wind within limit
+#define COMPLIANCE_VALID 0x80        // All configured limits met
+
+#define COMPLIANCE_WIND_LIMIT 10.0      // Default mean wind speed limit [kt]
+#define COMPLIANCE_CROSS_WIND_LIMIT 5.0 // Default mean cross wind limit [kt]
+
+// Lookup grid over the humidity chart temperature axis
+#define COMPLIANCE_T_MIN -10.0 // [degC]
+#define COMPLIANCE_T_MAX 40.0  // [degC]
+#define COMPLIANCE_T_STEP 0.5  // [degC]
+#define COMPLIANCE_GRID_SIZE 101
+
+typedef enum
+{
+    COMPLIANCE_0DB = 0,
+    COMPLIANCE_10DB,
+    COMPLIANCE_12DB,
+    COMPLIANCE_NUM_WINDOWS
+} t_compliance_window;
+
+typedef struct
+{
+    t_compliance_window window; // Temperature/humidity window required for validity
+    double wind_limit;          // [kt]
+    double cross_wind_limit;    // [kt]
+} t_compliance_limits;
+
+typedef struct
+{
+    t_compliance_limits limits;
+    unsigned char flags; // Flags of last evaluation
+} t_compliance;
+
+void compliance_init(t_compliance *c, const t_compliance_limits *limits);
+int compliance_set_window(t_compliance_limits *limits, int attenuation);
+unsigned char compliance_evaluate(const t_compliance_limits *limits, double temperature, double humidity,
+                                  double windspeed, double cross_wind);
+bool compliance_update(t_compliance *c, double temperature, double humidity,
+                       double windspeed, double cross_wind, unsigned char *changed);
+
+#endif /* COMPLIANCE_H */
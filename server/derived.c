@@ -0,0 +1,160 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <math.h>
+#include <pthread.h>
+#include "derived.h"
+
+// See ICAO doc 7488
+#define EARTH_G 9.80665
+#define R 287.05287
+#define TREF 288.15
+#define ALPHA -0.0065
+
+#ifndef DEG_2_RAD
+#define DEG_2_RAD 0.017453292519943295769
+#endif
+
+/**
+ * Split wind into runway relative and vector components.
+ */
+void wind_components(double windspeed, unsigned short wind_direction,
+                     unsigned short runway_heading, t_wind_components *w)
+{
+    signed short difference = wind_direction - runway_heading;
+
+    w->cross_wind = windspeed * sin(difference * DEG_2_RAD);
+    w->head_wind = windspeed * cos(difference * DEG_2_RAD);
+    w->wind_comp1 = windspeed * sin(wind_direction * DEG_2_RAD);
+    w->wind_comp2 = windspeed * cos(wind_direction * DEG_2_RAD);
+}
+
+/**
+ * Barometric pressure reduced to reference level.
+ * height_qfe is the height difference between barometer and reference level[m]
+ */
+double baro_qfe(double pressure, double temperature, unsigned char height_qfe)
+{
+    return pressure * (1.0 + ((height_qfe * EARTH_G) / (R * (temperature + 273.15))));
+}
+
+/**
+ * Barometric pressure reduced to mean sea level.
+ * runway_elevation in [ft]
+ */
+double baro_qnh(double qfe, unsigned short runway_elevation)
+{
+    double elev = runway_elevation * 0.3048;
+    return qfe * exp((elev * EARTH_G) / (R * (TREF + (ALPHA * elev) / 2.0)));
+}
+
+// Sine and cosine of whole degrees, MAWS reports direction in 1 deg steps
+static double sin_table[360];
+static double cos_table[360];
+static pthread_once_t table_once = PTHREAD_ONCE_INIT;
+
+static void init_tables(void)
+{
+    for (int i = 0; i < 360; i++)
+    {
+        sin_table[i] = sin(i * DEG_2_RAD);
+        cos_table[i] = cos(i * DEG_2_RAD);
+    }
+}
+
+/**
+ * Sine and cosine of whole degree direction from the table.
+ */
+void deg_sincos(unsigned short deg, double *s, double *c)
+{
+    pthread_once(&table_once, init_tables);
+    *s = sin_table[deg % 360];
+    *c = cos_table[deg % 360];
+}
+
+/**
+ * Precompute constants for the batch kernel.
+ * Only needs to be called again when runway heading or elevation change.
+ */
+void derived_const_init(t_derived_const *c, unsigned short runway_heading,
+                        unsigned short runway_elevation, unsigned char height_qfe)
+{
+    double elev = runway_elevation * 0.3048;
+
+    pthread_once(&table_once, init_tables);
+    c->sin_heading = sin(runway_heading * DEG_2_RAD);
+    c->cos_heading = cos(runway_heading * DEG_2_RAD);
+    c->qfe_k = (height_qfe * EARTH_G) / R;
+    c->qnh_factor = exp((elev * EARTH_G) / (R * (TREF + (ALPHA * elev) / 2.0)));
+    c->runway_heading = runway_heading;
+    c->runway_elevation = runway_elevation;
+    c->height_qfe = height_qfe;
+}
+
+/**
+ * Compute derived quantities over a block of samples.
+ * Direction sine and cosine come from the degree table, runway relative
+ * components use the angle difference identities with the precomputed
+ * heading. No libm call is left in the loops, the arithmetic loop has no
+ * dependencies between samples so the compiler vectorizes it for NEON,
+ * SSE or AVX depending on the target flags.
+ */
+void derived_batch(const t_derived_const *c, const t_derived_block *b, size_t n)
+{
+    double sin_dir[DERIVED_BLOCK_SIZE];
+    double cos_dir[DERIVED_BLOCK_SIZE];
+    const double sh = c->sin_heading;
+    const double ch = c->cos_heading;
+    const double qfe_k = c->qfe_k;
+    const double qnh_factor = c->qnh_factor;
+
+    for (size_t start = 0; start < n; start += DERIVED_BLOCK_SIZE)
+    {
+        size_t len = (n - start < DERIVED_BLOCK_SIZE) ? n - start : DERIVED_BLOCK_SIZE;
+        const double *restrict windspeed = &b->windspeed[start];
+        const double *restrict pressure = &b->pressure[start];
+        const double *restrict temperature = &b->temperature[start];
+        double *restrict cross_wind = &b->cross_wind[start];
+        double *restrict head_wind = &b->head_wind[start];
+        double *restrict wind_comp1 = &b->wind_comp1[start];
+        double *restrict wind_comp2 = &b->wind_comp2[start];
+        double *restrict qfe = &b->qfe[start];
+        double *restrict qnh = &b->qnh[start];
+
+        // Table gather, kept apart so the loop below stays vectorizable
+        for (size_t i = 0; i < len; i++)
+        {
+            unsigned int dir = b->wind_direction[start + i] % 360;
+            sin_dir[i] = sin_table[dir];
+            cos_dir[i] = cos_table[dir];
+        }
+
+        for (size_t i = 0; i < len; i++)
+        {
+            double ws = windspeed[i];
+            double s = sin_dir[i];
+            double co = cos_dir[i];
+            // sin(d - h) = sin d cos h - cos d sin h, cos(d - h) = cos d cos h + sin d sin h
+            cross_wind[i] = ws * (s * ch - co * sh);
+            head_wind[i] = ws * (co * ch + s * sh);
+            wind_comp1[i] = ws * s;
+            wind_comp2[i] = ws * co;
+            qfe[i] = pressure[i] * (1.0 + qfe_k / (temperature[i] + 273.15));
+            qnh[i] = qfe[i] * qnh_factor;
+        }
+    }
+}
@@ -0,0 +1,74 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include <stddef.h>
+
+#define DERIVED_BLOCK_SIZE 256 // Samples processed per inner block
+
+typedef struct
+{
+    double cross_wind;
+    double head_wind;
+    double wind_comp1; // East component
+    double wind_comp2; // North component
+} t_wind_components;
+
+void wind_components(double windspeed, unsigned short wind_direction,
+                     unsigned short runway_heading, t_wind_components *w);
+double baro_qfe(double pressure, double temperature, unsigned char height_qfe);
+double baro_qnh(double qfe, unsigned short runway_elevation);
+
+/**
+ * Constants precomputed for the current runway heading and elevation.
+ */
+typedef struct
+{
+    double sin_heading;
+    double cos_heading;
+    double qfe_k;      // height_qfe * g / R
+    double qnh_factor; // QNH = QFE * qnh_factor
+    unsigned short runway_heading;
+    unsigned short runway_elevation;
+    unsigned char height_qfe;
+} t_derived_const;
+
+/**
+ * Struct of arrays sample block, input and output for the batch kernel.
+ */
+typedef struct
+{
+    const double *windspeed;
+    const unsigned short *wind_direction;
+    const double *pressure;
+    const double *temperature;
+    double *cross_wind;
+    double *head_wind;
+    double *wind_comp1;
+    double *wind_comp2;
+    double *qfe;
+    double *qnh;
+} t_derived_block;
+
+void deg_sincos(unsigned short deg, double *s, double *c);
+void derived_const_init(t_derived_const *c, unsigned short runway_heading,
+                        unsigned short runway_elevation, unsigned char height_qfe);
+void derived_batch(const t_derived_const *c, const t_derived_block *b, size_t n);
+
+#endif /* DERIVED_H */
@@ -0,0 +1,141 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <string.h>
+#include <math.h>
+#include "fusion.h"
+
+_Static_assert((FUSION_MAWS_SLOTS & (FUSION_MAWS_SLOTS - 1)) == 0, "FUSION_MAWS_SLOTS must be a power of two");
+// Samples wait at most FUSION_LATENCY, plus the second being emitted
+_Static_assert(FUSION_MAWS_SLOTS >= FUSION_LATENCY_MS * FUSION_MAX_RATE / 1000 + FUSION_MAX_RATE,
+               "FUSION_MAWS_SLOTS too small for FUSION_LATENCY at FUSION_MAX_RATE");
+
+void fusion_init(t_fusion *f, double latency)
+{
+    memset(f, 0, sizeof(*f));
+    f->latency = latency;
+    f->last_second = (time_t)-1;
+}
+
+/**
+ * Join the GPS fields of a sample at time t from the fixes before and after
+ * it, either may be NULL.
+ */
+static void join(t_packet_data *p, double t, const t_fusion_fix *before, const t_fusion_fix *after)
+{
+    const t_fusion_fix *nearest;
+    double w = 0.0;
+    bool interpolate;
+
+    if (before != NULL && fabs(t - before->t) > FUSION_GPS_TOLERANCE)
+        before = NULL;
+    if (after != NULL && fabs(after->t - t) > FUSION_GPS_TOLERANCE)
+        after = NULL;
+    if (before == NULL && after == NULL)
+    {
+#define FUSION_CLEAR_G(type, name, interpolated) p->name = 0;
+        FUSION_GPS_FIELDS(FUSION_CLEAR_G)
+        return;
+    }
+    if (before == NULL || (after != NULL && fabs(after->t - t) < fabs(t - before->t)))
+        nearest = after;
+    else
+        nearest = before;
+
+    // Only between two fixes of the same mode, and not across the antimeridian
+    interpolate = before != NULL && after != NULL && before->t <= t && after->t > before->t &&
+                  before->gps_mode >= FUSION_MIN_MODE &&
+                  before->gps_mode == after->gps_mode && fabs(after->gps_lon - before->gps_lon) < 180.0;
+    if (interpolate)
+        w = (t - before->t) / (after->t - before->t);
+#define FUSION_JOIN_G(type, name, interpolated)                                         \
+    if ((interpolated) && interpolate)                                                  \
+        p->name = (type)(before->name + w * ((double)after->name - (double)before->name)); \
+    else                                                                                \
+        p->name = nearest->name;
+    FUSION_GPS_FIELDS(FUSION_JOIN_G)
+}
+
+/**
+ * Add a MAWS sample. Its MAWS fields are taken from the packet p.
+ */
+void fusion_add_maws(t_fusion *f, const t_packet_data *p, double t, const struct timespec *wall)
+{
+    t_fusion_sample *s;
+
+    if (f->maws_head - f->maws_tail == FUSION_MAWS_SLOTS)
+    {
+        f->maws_tail++;
+        f->dropped++;
+    }
+    s = &f->maws[f->maws_head % FUSION_MAWS_SLOTS];
+    s->t = t;
+    s->wall = *wall;
+    s->packet = *p;
+    s->joined = false;
+    f->maws_head++;
+}
+
+/**
+ * Add a new GPS fix, its fields are taken from the packet p.
+ * Joins all waiting samples taken before it.
+ */
+void fusion_add_gps(t_fusion *f, const t_packet_data *p, double t)
+{
+    t_fusion_fix fix;
+
+    fix.t = t;
+#define FUSION_COPY_G(type, name, interpolated) fix.name = p->name;
+    FUSION_GPS_FIELDS(FUSION_COPY_G)
+    for (unsigned int i = f->maws_tail; i != f->maws_head; i++)
+    {
+        t_fusion_sample *s = &f->maws[i % FUSION_MAWS_SLOTS];
+        if (!s->joined && s->t <= t)
+        {
+            join(&s->packet, s->t, f->gps_valid ? &f->gps : NULL, &fix);
+            s->joined = true;
+        }
+    }
+    f->gps = fix;
+    f->gps_valid = true;
+}
+
+/**
+ * Take the next joined sample.
+ * Returns false when no sample is ready at monotonic time now [s].
+ */
+bool fusion_next(t_fusion *f, double now, t_fusion_sample *out)
+{
+    while (f->maws_tail != f->maws_head)
+    {
+        t_fusion_sample *s = &f->maws[f->maws_tail % FUSION_MAWS_SLOTS];
+
+        if (!s->joined)
+        {
+            if (now - s->t < f->latency)
+                return false; // Wait for the next fix
+            join(&s->packet, s->t, f->gps_valid ? &f->gps : NULL, NULL);
+            s->joined = true;
+        }
+        f->maws_tail++;
+        if (s->wall.tv_sec == f->last_second)
+            continue;
+        f->last_second = s->wall.tv_sec;
+        *out = *s;
+        return true;
+    }
+    return false;
+}
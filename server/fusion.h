@@ -0,0 +1,94 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Fusion of the MAWS and GPS streams into one sample per second for the
+// recordings.
+//
+// MAWS samples are buffered with their monotonic ingestion time until the
+// first GPS fix after them arrives. The sample is then joined with the GPS
+// state at its own ingestion time: position, altitude and GPS time are
+// interpolated between the fix before and the fix after it, the other GPS
+// fields are taken from the nearer fix. Fixes further than
+// FUSION_GPS_TOLERANCE from the sample are not used, the sample then has no
+// GPS fix (mode 0). Without a fix after it, a sample is joined with the fix
+// before it once the latency given to fusion_init() has passed, so rows are
+// written with a bounded delay. The first sample of every wall clock second
+// is emitted. The buffer is a fixed size ring that holds the samples of the
+// latency and one more second at FUSION_MAX_RATE, a full ring drops the oldest
+// sample and counts it.
+
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "meteoserver.h"
+
+#define FUSION_MAX_RATE 400      // Highest MAWS rate the ring is sized for, mawsemu included [Hz]
+#define FUSION_MAWS_SLOTS 1024   // Power of two, MAWS samples waiting for a fix, see fusion.c
+#define FUSION_MIN_MODE 2        // gpsd MODE_2D, fixes below are not interpolated
+#define FUSION_LATENCY_MS 1500   // Longest wait for the next fix [ms]
+#define FUSION_LATENCY (FUSION_LATENCY_MS / 1000.0)
+#define FUSION_GPS_TOLERANCE 1.5 // Farthest fix joined with a sample [s]
+
+// GPS fields of t_packet_data taken from the fixes, G(type, name, interpolated)
+#define FUSION_GPS_FIELDS(G)                  \
+    G(double, gps_lat, true)                  \
+    G(double, gps_lon, true)                  \
+    G(double, gps_alt_msl, true)              \
+    G(double, gps_time, true)                 \
+    G(double, gps_hdop, false)                \
+    G(double, gps_pdop, false)                \
+    G(unsigned char, gps_status, false)       \
+    G(unsigned char, gps_mode, false)         \
+    G(unsigned char, gps_satellites_visible, false) \
+    G(unsigned char, gps_satellites_used, false)
+
+#define FUSION_FIX_G(type, name, interpolated) type name;
+
+typedef struct
+{
+    double t; // Monotonic ingestion time [s]
+    FUSION_GPS_FIELDS(FUSION_FIX_G)
+} t_fusion_fix;
+
+typedef struct
+{
+    double t;             // Monotonic ingestion time [s]
+    struct timespec wall; // Wall clock ingestion time, the row time
+    t_packet_data packet; // MAWS fields of the sample, GPS fields joined
+    bool joined;
+} t_fusion_sample;
+
+typedef struct
+{
+    t_fusion_sample maws[FUSION_MAWS_SLOTS];
+    t_fusion_fix gps;       // Latest fix
+    bool gps_valid;
+    unsigned int maws_head; // Samples added
+    unsigned int maws_tail; // Samples taken
+    double latency;         // [s]
+    time_t last_second;     // Wall clock second of the last emitted sample
+    unsigned long dropped;  // Samples lost to a full ring
+} t_fusion;
+
+void fusion_init(t_fusion *f, double latency);
+void fusion_add_maws(t_fusion *f, const t_packet_data *p, double t, const struct timespec *wall);
+void fusion_add_gps(t_fusion *f, const t_packet_data *p, double t);
+bool fusion_next(t_fusion *f, double now, t_fusion_sample *out);
+
+#endif /* FUSION_H */
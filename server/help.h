@@ -28,7 +28,25 @@ enum
         OPTBAUDRATE,
         OPTGROUP,
         OPTUSER,
-        OPTNOGPS
+        OPTNOGPS,
+        OPTMAXCLIENTS,
+        OPTSTATE,
+        OPTWINDOW,
+        OPTWINDLIMIT,
+        OPTCROSSWINDLIMIT,
+        OPTMININTERVAL,
+        OPTKEEPALIVE,
+        OPTSHM,
+        OPTMCAST,
+        OPTMCASTIF,
+        OPTRECORDCOMPRESS,
+        OPTRECORDMAXSIZE,
+        OPTRECORDMAXDURATION,
+        OPTREACTOR,
+        OPTHTTPROOT,
+        OPTNOHTTP,
+        OPTARCHIVE,
+        OPTNOARCHIVE
 };
 
 static struct argp_option options[] =
@@ -45,6 +63,24 @@ static struct argp_option options[] =
 #endif
         {"debug", 'd', "debug level", OPTION_ARG_OPTIONAL, "Set debug level [default: 0]", 1},
         {"no-gps", OPTNOGPS, 0, OPTION_ARG_OPTIONAL, "Disable GPS support", 1},
+        {"max-clients", OPTMAXCLIENTS, "clients", 0, "Maximum websocket clients [default: 50]", 1},
+        {"state", OPTSTATE, "state file", 0, "State file for restart [default: /var/lib/meteo/state]", 1},
+        {"window", OPTWINDOW, "dB", 0, "Temperature/humidity window 0, 10 or 12 [default: 10]", 1},
+        {"wind-limit", OPTWINDLIMIT, "kt", 0, "Mean wind speed limit [default: 10]", 1},
+        {"cross-wind-limit", OPTCROSSWINDLIMIT, "kt", 0, "Mean cross wind limit [default: 5]", 1},
+        {"min-interval", OPTMININTERVAL, "ms", 0, "Minimum time between published packets [default: 50]", 1},
+        {"keepalive", OPTKEEPALIVE, "ms", 0, "Republish interval without new data [default: 1000]", 1},
+        {"shm", OPTSHM, "name", OPTION_ARG_OPTIONAL, "Publish packets to shared memory ring [default name: /meteo]", 1},
+        {"mcast", OPTMCAST, "group:port", OPTION_ARG_OPTIONAL, "Send packets to multicast group [default: 239.255.77.77:10025]", 1},
+        {"mcast-if", OPTMCASTIF, "address", OPTION_ARG_OPTIONAL, "Address of multicast interface [default: default route]", 1},
+        {"record-compress", OPTRECORDCOMPRESS, "level", OPTION_ARG_OPTIONAL, "Write recordings as indexed gzip frames [default level: 6]", 1},
+        {"record-max-size", OPTRECORDMAXSIZE, "MB", OPTION_ARG_OPTIONAL, "Rotate recording file after this size [default: 0, never]", 1},
+        {"record-max-duration", OPTRECORDMAXDURATION, "min", OPTION_ARG_OPTIONAL, "Rotate recording file after this time [default: 0, never]", 1},
+        {"reactor", OPTREACTOR, 0, OPTION_ARG_OPTIONAL, "Serve serial, GPS and timers from the websocket event loop, no threads", 1},
+        {"http-root", OPTHTTPROOT, "directory", OPTION_ARG_OPTIONAL, "Web client served over HTTP [default: /usr/share/webmeteo]", 1},
+        {"no-http", OPTNOHTTP, 0, OPTION_ARG_OPTIONAL, "Serve websocket only, no web client and recordings", 1},
+        {"archive", OPTARCHIVE, "directory", OPTION_ARG_OPTIONAL, "Long-term archive of 1 min and 10 min rollups [default: /var/lib/meteo/archive]", 1},
+        {"no-archive", OPTNOARCHIVE, 0, OPTION_ARG_OPTIONAL, "Disable the long-term archive", 1},
         {0}};
 
 #endif /* HELP_H */
\ No newline at end of file
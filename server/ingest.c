@@ -0,0 +1,123 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ingest.h"
+#include "state.h"
+#include "archive.h"
+
+int ingest_init(t_ingest *in, const t_compliance_limits *limits)
+{
+    memset(in, 0, sizeof(*in));
+    qc_init(&in->qc);
+    compliance_init(&in->compliance, limits);
+    return rollup_init(&in->rollup);
+}
+
+void ingest_free(t_ingest *in)
+{
+    rollup_free(&in->rollup);
+}
+
+/**
+ * Runway settings are changed by client requests, constants are only
+ * recomputed when they differ.
+ */
+void ingest_runway(t_ingest *in, unsigned short runway_heading, unsigned short runway_elevation,
+                   unsigned char height_qfe)
+{
+    if (!in->dconst_valid || in->dconst.runway_heading != runway_heading ||
+        in->dconst.runway_elevation != runway_elevation || in->dconst.height_qfe != height_qfe)
+    {
+        derived_const_init(&in->dconst, runway_heading, runway_elevation, height_qfe);
+        in->dconst_valid = true;
+    }
+}
+
+/**
+ * Process sample s read at monotonic time t [s] and wall clock time wall.
+ * Returns true when the compliance flags changed, the changed bits are in changed.
+ */
+bool ingest_sample(t_ingest *in, const t_maws_sample *s, double t, const struct timespec *wall,
+                   unsigned char *changed)
+{
+    t_maws_sample *sample = &in->sample;
+    t_wind_components *wind = &in->wind;
+    t_derived_block block = {&sample->windspeed, &sample->wind_direction, &sample->pressure, &sample->temperature,
+                             &wind->cross_wind, &wind->head_wind, &wind->wind_comp1, &wind->wind_comp2,
+                             &in->qfe, &in->qnh};
+    bool event = false;
+
+    *sample = *s;
+    in->qc_flags = qc_sample(&in->qc, sample, t);
+    derived_batch(&in->dconst, &block, 1);
+    // Limits are evaluated on the 30 s means once the window is filled
+    if (moving_avg_update(&in->avg, sample, wind, &in->mean))
+        event = compliance_update(&in->compliance, in->mean.temperature, in->mean.humidity, in->mean.windspeed,
+                                  in->mean.cross_wind, changed);
+    state_save_average(&in->avg);
+    // Values out of range or spikes stay out of the long-term archive
+    if (!(in->qc_flags & (QC_RANGE | QC_SPIKE)))
+        archive_sample(&(t_archive_sample){.temperature = sample->temperature,
+                                           .humidity = sample->humidity,
+                                           .pressure = sample->pressure,
+                                           .qnh = in->qnh,
+                                           .windspeed = sample->windspeed,
+                                           .cross_wind = fabs(wind->cross_wind),
+                                           .head_wind = wind->head_wind,
+                                           .direction = sample->wind_direction},
+                       wall->tv_sec);
+    rollup_update(&in->rollup, t, sample->windspeed, sample->wind_direction);
+    state_save_wind((double)wall->tv_sec + (double)wall->tv_nsec / 1e9, sample->windspeed, sample->wind_direction);
+    rollup_stats(&in->rollup, in->stats);
+    absorption_compute(in->mean.temperature, in->mean.humidity, sample->pressure, in->absorption);
+    return event;
+}
+
+/**
+ * Copy the results of the last sample into packet p.
+ */
+void ingest_packet(const t_ingest *in, t_packet_data *p)
+{
+    p->baro_qfe = in->qfe;
+    p->baro_qnh = in->qnh;
+    p->temperature = in->mean.temperature;
+    p->humidity = in->mean.humidity;
+    p->wind_direction = in->sample.wind_direction;
+    p->wind_direction_mean = (unsigned short)lround(in->mean.wind_direction) % 360;
+    p->wind_direction_std = in->mean.wind_direction_std;
+    p->windspeed = in->sample.windspeed;
+    p->windspeed_mean = in->mean.windspeed;
+    p->cross_windspeed = in->wind.cross_wind;
+    p->cross_windspeed_mean = in->mean.cross_wind;
+    p->head_windspeed = in->mean.head_wind;
+    p->baro_pressure = in->sample.pressure;
+    p->maws_hour = in->sample.hour;
+    p->maws_min = in->sample.min;
+    p->maws_sec = in->sample.sec;
+    memcpy(p->wind_rollup, in->stats, sizeof(in->stats));
+    p->speed_of_sound = speed_of_sound(in->mean.temperature);
+    memcpy(p->absorption, in->absorption, sizeof(in->absorption));
+    p->compliance = in->compliance.flags;
+    p->qc_temperature = in->qc.temperature.flags;
+    p->qc_humidity = in->qc.humidity.flags;
+    p->qc_pressure = in->qc.pressure.flags;
+    p->qc_windspeed = in->qc.windspeed.flags;
+    p->qc_wind_direction = in->qc.wind_direction.flags;
+}
@@ -0,0 +1,66 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Processing of one parsed MAWS sample, shared by the serial read thread and
+// the replay benchmark so both run the same stages in the same order:
+// quality control, derived quantities, moving average and compliance, state
+// checkpoint, long-term archive, wind rollup and absorption. The results stay
+// in t_ingest until ingest_packet() copies them into the packet, which the
+// caller does under its packet lock.
+
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "maws.h"
+#include "derived.h"
+#include "average.h"
+#include "rollup.h"
+#include "compliance.h"
+#include "qc.h"
+#include "absorption.h"
+#include "meteoserver.h"
+
+typedef struct
+{
+    t_derived_const dconst;
+    bool dconst_valid;
+    t_qc qc;
+    t_moving_avg avg;
+    t_compliance compliance;
+    t_rollup rollup;
+    // Results of the last sample
+    t_maws_sample sample;
+    t_wind_components wind;
+    t_mean_values mean;
+    t_rollup_stats stats[ROLLUP_NUM_WINDOWS];
+    t_absorption_band absorption[ABSORPTION_NUM_BANDS];
+    double qfe;
+    double qnh;
+    unsigned char qc_flags;
+} t_ingest;
+
+int ingest_init(t_ingest *in, const t_compliance_limits *limits);
+void ingest_free(t_ingest *in);
+void ingest_runway(t_ingest *in, unsigned short runway_heading, unsigned short runway_elevation,
+                   unsigned char height_qfe);
+bool ingest_sample(t_ingest *in, const t_maws_sample *s, double t, const struct timespec *wall,
+                   unsigned char *changed);
+void ingest_packet(const t_ingest *in, t_packet_data *p);
+
+#endif /* INGEST_H */
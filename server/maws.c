@@ -0,0 +1,39 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "maws.h"
+
+/**
+ * Parse one MAWS data line.
+ * Returns EXIT_FAILURE when the line is incomplete or garbage.
+ */
+int maws_parse_line(const char *buf, t_maws_sample *sample)
+{
+    int items = sscanf(buf, "%lf\t%hhu\t%lf\t%lf\t%hu\t%hhu\t%hhu\t%hhu",
+                       &sample->temperature,
+                       &sample->humidity,
+                       &sample->pressure,
+                       &sample->windspeed,
+                       &sample->wind_direction,
+                       &sample->hour,
+                       &sample->min,
+                       &sample->sec);
+
+    return (items == 8) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
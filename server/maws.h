@@ -0,0 +1,39 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MAWS_H
+#define MAWS_H
+
+/**
+ * One line of the MAWS tab separated output format:
+ * temperature humidity pressure windspeed direction hour min sec
+ */
+typedef struct
+{
+    double temperature;
+    double pressure;
+    double windspeed;
+    unsigned short wind_direction;
+    unsigned char humidity;
+    unsigned char hour;
+    unsigned char min;
+    unsigned char sec;
+} t_maws_sample;
+
+int maws_parse_line(const char *buf, t_maws_sample *sample);
+
+#endif /* MAWS_H */
@@ -0,0 +1,446 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Vaisalla MAWS station emulator.
+// Opens a pseudo-terminal and streams lines in the MAWS tab separated output
+// format, either synthetic or replayed from a recorded log. Implements the
+// open/time/timezone/close service dialogue used by sync_maws_time.
+// Point meteoserver at the printed slave device with --serial.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
+#include <termios.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "timespec.h"
+
+#define LINE_SIZE 128 /* Byte */
+#define CMD_SIZE 256  /* Byte */
+
+static double rate = 1.0;             // Lines per second
+static unsigned long max_lines = 0;   // 0 = endless
+static double noise_prob = 0.0;       // Probability of value noise per line
+static double truncate_prob = 0.0;    // Probability of truncated line
+static double garbage_prob = 0.0;     // Probability of garbage line
+static const char *replay_path = NULL;
+static const char *link_path = NULL;
+static unsigned int seed = 1;
+static bool verbose = false;
+
+static volatile sig_atomic_t exit_emulator = 0;
+static bool service_mode = false;
+static time_t maws_time_offset = 0; // Set by service "time" command
+
+static struct
+{
+    unsigned long lines;
+    unsigned long noisy;
+    unsigned long truncated;
+    unsigned long garbage;
+    unsigned long commands;
+    unsigned long late;
+    unsigned long long bytes;
+} stats;
+
+// Synthetic weather state, random walk
+static struct
+{
+    double temperature;
+    double humidity;
+    double pressure;
+    double windspeed;
+    double direction;
+} weather = {15.0, 60.0, 1013.2, 5.0, 240.0};
+
+static FILE *replay_fp = NULL;
+
+static void sighandler(int sig)
+{
+    (void)sig;
+    exit_emulator = 1;
+}
+
+static double uniform(void)
+{
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+static double clamp(double v, double lo, double hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void step_weather(void)
+{
+    weather.temperature = clamp(weather.temperature + (uniform() - 0.5) * 0.1, -40.0, 50.0);
+    weather.humidity = clamp(weather.humidity + (uniform() - 0.5) * 0.5, 0.0, 100.0);
+    weather.pressure = clamp(weather.pressure + (uniform() - 0.5) * 0.05, 900.0, 1100.0);
+    weather.windspeed = clamp(weather.windspeed + (uniform() - 0.5) * 1.0, 0.0, 40.0);
+    weather.direction = fmod(weather.direction + (uniform() - 0.5) * 10.0 + 360.0, 360.0);
+}
+
+/**
+ * Build next data line, synthetic or from replay file.
+ */
+static int next_line(char *line, size_t size)
+{
+    time_t now = time(NULL) + maws_time_offset;
+    struct tm *t = gmtime(&now);
+
+    if (replay_fp != NULL)
+    {
+        if (fgets(line, (int)size, replay_fp) == NULL)
+        {
+            rewind(replay_fp);
+            if (fgets(line, (int)size, replay_fp) == NULL)
+                return -1;
+        }
+        // Normalize line ending to CR LF as sent by MAWS
+        line[strcspn(line, "\r\n")] = '\0';
+        strncat(line, "\r\n", size - strlen(line) - 1);
+        return (int)strlen(line);
+    }
+
+    step_weather();
+    double windspeed = weather.windspeed;
+    double temperature = weather.temperature;
+    if (uniform() < noise_prob)
+    {
+        windspeed = clamp(windspeed + (uniform() - 0.5) * 20.0, 0.0, 99.9);
+        temperature += (uniform() - 0.5) * 10.0;
+        stats.noisy++;
+    }
+
+    return snprintf(line, size, "%6.1f\t%4u\t%7.1f\t%6.1f\t%5u\t%02u\t%02u\t%02u\r\n",
+                    temperature,
+                    (unsigned int)weather.humidity,
+                    weather.pressure,
+                    windspeed,
+                    (unsigned int)weather.direction,
+                    t->tm_hour,
+                    t->tm_min,
+                    t->tm_sec);
+}
+
+/**
+ * Apply truncation and garbage injection to a data line.
+ */
+static int corrupt_line(char *line, int len)
+{
+    double r = uniform();
+
+    if (r < garbage_prob)
+    {
+        len = 1 + rand() % (LINE_SIZE - 3);
+        for (int i = 0; i < len; i++)
+        {
+            // Any byte except line endings
+            do
+            {
+                line[i] = (char)(rand() & 0xff);
+            } while (line[i] == '\n' || line[i] == '\r' || line[i] == '\0');
+        }
+        line[len++] = '\r';
+        line[len++] = '\n';
+        stats.garbage++;
+    }
+    else if (r < garbage_prob + truncate_prob && len > 3)
+    {
+        len = 1 + rand() % (len - 3);
+        line[len++] = '\r';
+        line[len++] = '\n';
+        stats.truncated++;
+    }
+    return len;
+}
+
+static void reply(int fd, const char *msg)
+{
+    ssize_t n = write(fd, msg, strlen(msg));
+    if (n > 0)
+        stats.bytes += (unsigned long long)n;
+}
+
+/**
+ * Handle one service command line received from meteoserver.
+ */
+static void handle_command(int fd, char *cmd, const struct timespec *rx)
+{
+    unsigned int h, m, s, y, mo, d;
+    int tz;
+    struct timespec done;
+
+    cmd[strcspn(cmd, "\r\n")] = '\0';
+    if (*cmd == '\0')
+        return;
+    stats.commands++;
+
+    if (strcmp(cmd, "open") == 0)
+    {
+        service_mode = true;
+        reply(fd, "\r\nService connection opened\r\n");
+    }
+    else if (strcmp(cmd, "close") == 0)
+    {
+        service_mode = false;
+        reply(fd, "\r\nService connection closed\r\n");
+    }
+    else if (!service_mode)
+    {
+        // MAWS ignores commands without service connection
+    }
+    else if (sscanf(cmd, "time %u %u %u %u %u %u", &h, &m, &s, &y, &mo, &d) == 6)
+    {
+        struct tm t = {0};
+        t.tm_hour = (int)h;
+        t.tm_min = (int)m;
+        t.tm_sec = (int)s;
+        t.tm_year = (int)y + 100;
+        t.tm_mon = (int)mo - 1;
+        t.tm_mday = (int)d;
+        maws_time_offset = timegm(&t) - time(NULL);
+        reply(fd, "\r\nTime set\r\n");
+    }
+    else if (sscanf(cmd, "timezone %d", &tz) == 1)
+    {
+        reply(fd, "\r\nTimezone set\r\n");
+    }
+    else
+    {
+        reply(fd, "\r\nUnknown command\r\n");
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &done);
+    fprintf(stderr, "cmd=\"%s\" service=%d time_offset=%ld handle_us=%.1f\n",
+            cmd, service_mode, (long)maws_time_offset,
+            (double)timespec_diff_ns(done, *rx) / 1000.0);
+}
+
+static int open_pty(char *slave_name, size_t size, int *slave_fd)
+{
+    struct termios tios;
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || ptsname_r(fd, slave_name, size) != 0)
+    {
+        fprintf(stderr, "Failed to create pseudo-terminal: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Keep slave open so the master does not see EIO while meteoserver
+    // reopens the device, and disable echo until it configures the line.
+    *slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+    if (*slave_fd < 0 || tcgetattr(*slave_fd, &tios) != 0)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", slave_name, strerror(errno));
+        return -1;
+    }
+    tios.c_lflag &= ~(ECHO | ECHONL);
+    tcsetattr(*slave_fd, TCSANOW, &tios);
+
+    return fd;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -r rate      Lines per second [default: 1]\n"
+            "  -c count     Stop after count lines [default: endless]\n"
+            "  -f file      Replay recorded MAWS log instead of synthetic data\n"
+            "  -l path      Create symlink to the pseudo-terminal\n"
+            "  -n prob      Probability of value noise per line [0..1]\n"
+            "  -t prob      Probability of truncated line [0..1]\n"
+            "  -g prob      Probability of garbage line [0..1]\n"
+            "  -s seed      Random seed [default: 1]\n"
+            "  -v           Print every line sent\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    char slave_name[64];
+    char line[LINE_SIZE];
+    char cmd[CMD_SIZE];
+    size_t cmd_len = 0;
+    int slave_fd = -1;
+    int opt, len;
+    struct timespec next, now, start, period;
+
+    while ((opt = getopt(argc, argv, "r:c:f:l:n:t:g:s:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            rate = atof(optarg);
+            break;
+        case 'c':
+            max_lines = strtoul(optarg, NULL, 0);
+            break;
+        case 'f':
+            replay_path = optarg;
+            break;
+        case 'l':
+            link_path = optarg;
+            break;
+        case 'n':
+            noise_prob = atof(optarg);
+            break;
+        case 't':
+            truncate_prob = atof(optarg);
+            break;
+        case 'g':
+            garbage_prob = atof(optarg);
+            break;
+        case 's':
+            seed = (unsigned int)strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rate <= 0.0)
+    {
+        fprintf(stderr, "Rate must be positive.\n");
+        return EXIT_FAILURE;
+    }
+    srand(seed);
+
+    if (replay_path != NULL)
+    {
+        replay_fp = fopen(replay_path, "r");
+        if (replay_fp == NULL)
+        {
+            fprintf(stderr, "Failed to open %s: %s\n", replay_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    int fd = open_pty(slave_name, sizeof(slave_name), &slave_fd);
+    if (fd < 0)
+        return EXIT_FAILURE;
+
+    if (link_path != NULL)
+    {
+        unlink(link_path);
+        if (symlink(slave_name, link_path) != 0)
+            fprintf(stderr, "Failed to link %s: %s\n", link_path, strerror(errno));
+    }
+    printf("%s\n", slave_name);
+    fflush(stdout);
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+
+    period.tv_sec = (time_t)(1.0 / rate);
+    period.tv_nsec = (long)((1.0 / rate - (double)period.tv_sec) * NS_IN_SEC);
+    int64_t period_ns = (int64_t)period.tv_sec * NS_IN_SEC + period.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    next = start;
+
+    while (!exit_emulator && (max_lines == 0 || stats.lines < max_lines))
+    {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int timeout;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        timeout = (int)(timespec_diff_ns(next, now) / 1000000LL);
+        if (timeout < 0)
+            timeout = 0;
+
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN))
+        {
+            // Collect service commands line by line
+            ssize_t n = read(fd, &cmd[cmd_len], sizeof(cmd) - cmd_len - 1);
+            if (n > 0)
+            {
+                struct timespec rx;
+                char *eol;
+                clock_gettime(CLOCK_MONOTONIC, &rx);
+                cmd_len += (size_t)n;
+                cmd[cmd_len] = '\0';
+                while ((eol = strpbrk(cmd, "\r\n")) != NULL)
+                {
+                    *eol = '\0';
+                    handle_command(fd, cmd, &rx);
+                    cmd_len -= (size_t)(eol + 1 - cmd);
+                    memmove(cmd, eol + 1, cmd_len + 1);
+                }
+                if (cmd_len >= sizeof(cmd) - 1)
+                    cmd_len = 0;
+            }
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (timespec_diff_ns(next, now) > 0)
+            continue;
+
+        // Count lines sent later than one period
+        if (timespec_diff_ns(now, next) > period_ns)
+            stats.late++;
+        next.tv_sec += period.tv_sec;
+        next.tv_nsec += period.tv_nsec;
+        TS_NORM(&next);
+
+        // MAWS stops data output while the service connection is open
+        if (service_mode)
+            continue;
+
+        len = next_line(line, sizeof(line));
+        if (len <= 0)
+            break;
+        len = corrupt_line(line, len);
+        if (write(fd, line, (size_t)len) == len)
+        {
+            stats.bytes += (unsigned long long)len;
+            stats.lines++;
+            if (verbose)
+                fwrite(line, 1, (size_t)len, stderr);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (double)timespec_diff_ns(now, start) / (double)NS_IN_SEC;
+    fprintf(stderr, "lines=%lu bytes=%llu noisy=%lu truncated=%lu garbage=%lu commands=%lu late=%lu "
+                    "elapsed_s=%.3f rate_hz=%.1f\n",
+            stats.lines, stats.bytes, stats.noisy, stats.truncated, stats.garbage,
+            stats.commands, stats.late, elapsed, elapsed > 0.0 ? (double)stats.lines / elapsed : 0.0);
+
+    if (link_path != NULL)
+        unlink(link_path);
+    if (replay_fp != NULL)
+        fclose(replay_fp);
+    close(slave_fd);
+    close(fd);
+
+    return EXIT_SUCCESS;
+}
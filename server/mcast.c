@@ -0,0 +1,124 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "mcast.h"
+
+static int mcast_fd = -1;
+static struct sockaddr_in mcast_addr;
+static uint32_t mcast_session = 0;
+static uint32_t mcast_seq = 0;
+
+/**
+ * Open sender socket for a multicast group.
+ * iface is the IPv4 address of the outgoing interface, NULL for the default route.
+ */
+int mcast_open(const char *group, unsigned short port, const char *iface)
+{
+    unsigned char ttl = MCAST_TTL;
+    unsigned char loop = 1;
+    struct in_addr if_addr;
+    struct timespec ts;
+
+    memset(&mcast_addr, 0, sizeof(mcast_addr));
+    mcast_addr.sin_family = AF_INET;
+    mcast_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, group, &mcast_addr.sin_addr) != 1 || !IN_MULTICAST(ntohl(mcast_addr.sin_addr.s_addr)))
+    {
+        fprintf(stderr, "Invalid multicast group %s\n", group);
+        return EXIT_FAILURE;
+    }
+
+    mcast_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (mcast_fd < 0)
+    {
+        fprintf(stderr, "Failed to create multicast socket: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    setsockopt(mcast_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    // Local receivers get the datagrams too
+    setsockopt(mcast_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    if (iface != NULL)
+    {
+        if (inet_pton(AF_INET, iface, &if_addr) != 1 ||
+            setsockopt(mcast_fd, IPPROTO_IP, IP_MULTICAST_IF, &if_addr, sizeof(if_addr)) != 0)
+        {
+            fprintf(stderr, "Invalid multicast interface %s\n", iface);
+            close(mcast_fd);
+            mcast_fd = -1;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Session id only needs to differ between server starts
+    clock_gettime(CLOCK_REALTIME, &ts);
+    mcast_session = (uint32_t)ts.tv_sec ^ (uint32_t)ts.tv_nsec ^ ((uint32_t)getpid() << 16);
+    mcast_seq = 0;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Send one payload to the group. Single sender thread only.
+ * Datagrams that do not fit the socket buffer are dropped, receivers count them as lost.
+ */
+void mcast_send(uint8_t type, const void *data, size_t len)
+{
+    t_mcast_header hdr;
+    struct iovec iov[2];
+    struct msghdr msg;
+
+    if (mcast_fd < 0 || len > MCAST_MAX_PAYLOAD)
+        return;
+
+    hdr.magic = htole16(MCAST_MAGIC);
+    hdr.version = MCAST_VERSION;
+    hdr.type = type;
+    hdr.session = htole32(mcast_session);
+    hdr.seq = htole32(mcast_seq++);
+    hdr.length = htole16((uint16_t)len);
+    hdr.reserved = 0;
+
+    iov[0].iov_base = &hdr;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &mcast_addr;
+    msg.msg_namelen = sizeof(mcast_addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    sendmsg(mcast_fd, &msg, MSG_DONTWAIT);
+}
+
+void mcast_close(void)
+{
+    if (mcast_fd >= 0)
+    {
+        close(mcast_fd);
+        mcast_fd = -1;
+    }
+}
@@ -0,0 +1,81 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// UDP multicast distribution of packets.
+//
+// Every datagram is a t_mcast_header followed by the payload, a t_packet_data
+// or a t_compliance_event. Header fields are little endian like the payload.
+// The sequence number counts datagrams of one sender session, the session id
+// changes on every server start. Receivers use both to detect lost, late and
+// duplicate datagrams, see mcast_receive().
+
+#ifndef MCAST_H
+#define MCAST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MCAST_GROUP "239.255.77.77" // Organization local scope
+#define MCAST_PORT 10025
+#define MCAST_TTL 1 // Stay on the local network
+#define MCAST_MAGIC 0x4d57U // "WM"
+#define MCAST_VERSION 2
+#define MCAST_MAX_PAYLOAD 1024 // [Byte]
+
+// Payload types
+#define MCAST_TYPE_PACKET 1 // t_packet_data
+#define MCAST_TYPE_EVENT 2  // t_compliance_event
+
+typedef struct __attribute__((__packed__))
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type;
+    uint32_t session; // Random per server start
+    uint32_t seq;     // Datagram sequence number within session
+    uint16_t length;  // Payload length [Byte]
+    uint16_t reserved;
+} t_mcast_header;
+
+/**
+ * Receiver state and gap statistics.
+ */
+typedef struct
+{
+    int fd;
+    bool synced;       // Session and sequence known
+    uint32_t session;
+    uint32_t next_seq; // Expected sequence number
+    unsigned long received;
+    unsigned long lost;      // Sequence numbers skipped
+    unsigned long late;      // Older than expected, duplicate or reordered
+    unsigned long restarts;  // Session changes
+    unsigned long malformed; // Wrong magic, version or length
+} t_mcast_receiver;
+
+// Sender, used by meteoserver
+int mcast_open(const char *group, unsigned short port, const char *iface);
+void mcast_send(uint8_t type, const void *data, size_t len);
+void mcast_close(void);
+
+// Receiver library
+int mcast_receiver_open(t_mcast_receiver *r, const char *group, unsigned short port, const char *iface);
+int mcast_receive(t_mcast_receiver *r, t_mcast_header *hdr, void *buf, size_t size);
+void mcast_receiver_close(t_mcast_receiver *r);
+
+#endif /* MCAST_H */
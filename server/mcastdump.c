@@ -0,0 +1,130 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Example receiver of the multicast feed.
+// Prints every datagram as one JSON object per line, with the delay since the
+// server published the packet, and a gap summary on exit.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include "meteoserver.h"
+#include "mcast.h"
+
+#define NOTUSED(V) ((void)V)
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void sighandler(int sig)
+{
+    NOTUSED(sig);
+    interrupted = 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -g group     Multicast group [default: " MCAST_GROUP "]\n"
+            "  -p port      Port [default: %u]\n"
+            "  -i address   Address of receiving interface [default: any]\n"
+            "  -c count     Exit after count datagrams [default: unlimited]\n",
+            name, MCAST_PORT);
+}
+
+int main(int argc, char **argv)
+{
+    const char *group = MCAST_GROUP;
+    const char *iface = NULL;
+    unsigned short port = MCAST_PORT;
+    unsigned long count = 0;
+    t_mcast_receiver r;
+    t_mcast_header hdr;
+    unsigned char buf[MCAST_MAX_PAYLOAD];
+    t_packet_data p;
+    t_compliance_event e;
+    struct timespec ts;
+    struct sigaction sa;
+    int opt, n;
+
+    while ((opt = getopt(argc, argv, "g:p:i:c:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g':
+            group = optarg;
+            break;
+        case 'p':
+            port = (unsigned short)atoi(optarg);
+            break;
+        case 'i':
+            iface = optarg;
+            break;
+        case 'c':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (mcast_receiver_open(&r, group, port, iface) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    // No SA_RESTART, a signal interrupts the blocking receive
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sighandler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    while (!interrupted && (count == 0 || r.received < count))
+    {
+        n = mcast_receive(&r, &hdr, buf, sizeof(buf));
+        if (n < 0)
+        {
+            if (errno != EINTR)
+                fprintf(stderr, "Receive failed: %s\n", strerror(errno));
+            break;
+        }
+        clock_gettime(CLOCK_REALTIME, &ts);
+        if (hdr.type == MCAST_TYPE_PACKET && n >= (int)sizeof(p))
+        {
+            memcpy(&p, buf, sizeof(p));
+            printf("{\"seq\":%u,\"type\":\"packet\",\"delay_ms\":%.3f,\"temperature\":%.1f,\"humidity\":%u,"
+                   "\"windspeed\":%.1f,\"wind_direction\":%u,\"compliance\":%u}\n",
+                   hdr.seq, ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9 - p.local_time) * 1000.0,
+                   p.temperature, p.humidity, p.windspeed, p.wind_direction, p.compliance);
+        }
+        else if (hdr.type == MCAST_TYPE_EVENT && n >= (int)sizeof(e))
+        {
+            memcpy(&e, buf, sizeof(e));
+            printf("{\"seq\":%u,\"type\":\"compliance\",\"compliance\":%u,\"changed\":%u}\n",
+                   hdr.seq, e.compliance, e.changed);
+        }
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "received=%lu lost=%lu late=%lu restarts=%lu malformed=%lu\n",
+            r.received, r.lost, r.late, r.restarts, r.malformed);
+    mcast_receiver_close(&r);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Receiver side of the multicast distribution, for consumers of the feed.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "mcast.h"
+
+/**
+ * Join a multicast group.
+ * iface is the IPv4 address of the receiving interface, NULL for any.
+ */
+int mcast_receiver_open(t_mcast_receiver *r, const char *group, unsigned short port, const char *iface)
+{
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+    int reuse = 1;
+
+    memset(r, 0, sizeof(*r));
+    memset(&mreq, 0, sizeof(mreq));
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 || !IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr)))
+    {
+        fprintf(stderr, "Invalid multicast group %s\n", group);
+        return EXIT_FAILURE;
+    }
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (iface != NULL && inet_pton(AF_INET, iface, &mreq.imr_interface) != 1)
+    {
+        fprintf(stderr, "Invalid multicast interface %s\n", iface);
+        return EXIT_FAILURE;
+    }
+
+    r->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (r->fd < 0)
+    {
+        fprintf(stderr, "Failed to create multicast socket: %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    // Several receivers on one machine
+    setsockopt(r->fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Bind to the group address, only datagrams of this group are received
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr = mreq.imr_multiaddr;
+    if (bind(r->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(r->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) != 0)
+    {
+        fprintf(stderr, "Failed to join multicast group %s:%u: %s\n", group, port, strerror(errno));
+        close(r->fd);
+        r->fd = -1;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Receive the next datagram and update the gap statistics.
+ * Returns the payload length, 0 for datagrams to be skipped (malformed,
+ * late or duplicate) and -1 on socket errors with errno set.
+ * Payloads larger than size are truncated.
+ */
+int mcast_receive(t_mcast_receiver *r, t_mcast_header *hdr, void *buf, size_t size)
+{
+    struct iovec iov[2];
+    struct msghdr msg;
+    ssize_t n;
+    int32_t gap;
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof(*hdr);
+    iov[1].iov_base = buf;
+    iov[1].iov_len = size;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    n = recvmsg(r->fd, &msg, 0);
+    if (n < 0)
+        return -1;
+
+    if (n < (ssize_t)sizeof(*hdr))
+    {
+        r->malformed++;
+        return 0;
+    }
+    hdr->magic = le16toh(hdr->magic);
+    hdr->session = le32toh(hdr->session);
+    hdr->seq = le32toh(hdr->seq);
+    hdr->length = le16toh(hdr->length);
+    if (hdr->magic != MCAST_MAGIC || hdr->version != MCAST_VERSION ||
+        (!(msg.msg_flags & MSG_TRUNC) && (size_t)n - sizeof(*hdr) != hdr->length))
+    {
+        r->malformed++;
+        return 0;
+    }
+
+    if (!r->synced || hdr->session != r->session)
+    {
+        if (r->synced)
+            r->restarts++;
+        r->synced = true;
+        r->session = hdr->session;
+    }
+    else
+    {
+        // Wrap safe distance to the expected sequence number
+        gap = (int32_t)(hdr->seq - r->next_seq);
+        if (gap < 0)
+        {
+            r->late++;
+            return 0;
+        }
+        r->lost += (unsigned long)gap;
+    }
+    r->next_seq = hdr->seq + 1;
+    r->received++;
+    return (int)((size_t)n - sizeof(*hdr));
+}
+
+void mcast_receiver_close(t_mcast_receiver *r)
+{
+    if (r->fd >= 0)
+    {
+        close(r->fd);
+        r->fd = -1;
+    }
+}
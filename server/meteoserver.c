@@ -31,29 +31,82 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <dirent.h>
 #include "timespec.h"
 #include "help.h"
 #include "serial.h"
 #include "timer.h"
 #include "meteoserver.h"
+#include "maws.h"
+#include "derived.h"
+#include "average.h"
+#include "packet.h"
+#include "record.h"
+#include "state.h"
+#include "compliance.h"
+#include "shmring.h"
+#include "mcast.h"
+#include "trace.h"
+#include "assets.h"
+#include "archive.h"
+#include "summary.h"
+#include "qc.h"
+#include "track.h"
+#include "absorption.h"
+#include "fusion.h"
+#include "bus.h"
+#include "ingest.h"
 
 #define NOTUSED(V) ((void)V)
-#define WSBUFFERSIZE 512 /* Byte */
-// See ICAO doc 7488
-#define EARTH_G 9.80665
-#define R 287.05287
-#define TREF 288.15
-#define ALPHA -0.0065
-#define MOVING_AVG_LENGTH 30 // Moving average length in seconds
+#define WSBUFFERSIZE (LWS_SEND_BUFFER_PRE_PADDING + PACKET_SIZE) /* Largest frame is the packet [Byte] */
+#define REACTOR_SERVICE_TIMEOUT 60000 /* ms, lws 4 ignores it and sleeps until its own next timer */
+#define SD_LISTEN_FDS_START 3 // First file descriptor passed by systemd socket activation
+#define EVENT_QUEUE_LENGTH 16 // Compliance events kept for clients not yet writeable
+#define HTTP_CHUNK_SIZE 16384 // Body bytes per writeable callback
+#define SYNC_SERVICE_LINES 10 // Lines read waiting for the MAWS service connection
+#define SYNC_SERVICE_TIMEOUT 5000 // Reactor wait for the MAWS service connection [ms]
+
+/**
+ * Steps of a MAWS time sync run by the reactor.
+ */
+typedef enum
+{
+    SYNC_IDLE = 0, // Lines are meteo data
+    SYNC_SERVICE,  // Service connection requested
+    SYNC_TIME,     // Time command sent
+    SYNC_TIMEZONE  // Timezone command sent
+} t_sync_state;
 
 static int debug_level = 0;
 static int uid = -1, gid = -1, num_clients = 0;
+static int max_clients = 50;
+static int listen_fd = -1;
+static const char *state_path = STATE_PATH;
+static const char *shm_name = NULL;
+static char mcast_group[32] = ""; // group[:port] while parsing
+static unsigned short mcast_port = MCAST_PORT;
+static const char *mcast_iface = NULL;
+static const char *http_root = ASSETS_ROOT; // NULL disables serving the client
+static const char *archive_path = ARCHIVE_PATH; // NULL disables the long-term archive
 static char interface_name[255] = "";
 static const char *iface = NULL;
 static int syslog_options = LOG_PID | LOG_PERROR;
-static size_t packet_timer = 0;
+static size_t publish_timer = 0;
+static size_t flush_timer = 0; // Single shot, flushes a publish deferred by the minimum interval
+static bool reactor = false;   // Serial, GPS and timers are served by the lws loop, no threads
+static unsigned int min_interval = 50; // Minimum time between published packets [ms]
+static unsigned int keepalive = 1000;  // Republish interval without new data [ms]
+static atomic_bool publish_pending = false;
+static atomic_ullong last_publish = 0; // Monotonic time of last publish [ms]
 static size_t record_timer = 0;
+static size_t sync_timer = 0; // Single shot, paces the MAWS time sync in the reactor
+static t_sync_state sync_state = SYNC_IDLE;
+static int sync_lines = 0; // Lines read waiting for the service connection
 static t_packet_data packet_data;
 #if GPSD_API_MAJOR_VERSION < 9
 static struct timespec ts_now, ts_diff, ts_gps;
@@ -69,12 +122,25 @@ static struct lws_context_creation_info info;
 static unsigned char wsbuffer[WSBUFFERSIZE];
 static unsigned char *pwsbuffer = wsbuffer;
 static int wsbuffer_len = 0;
+static unsigned char http_buffer[LWS_SEND_BUFFER_PRE_PADDING + HTTP_CHUNK_SIZE];
 pthread_mutex_t lock_established_conns;
 pthread_t gps_thread;
 pthread_t serial_thread;
 pthread_mutex_t lock_packetdata_update;
 static bool gps_thread_exit = false;
 static bool serial_thread_exit = false;
+static t_compliance_event event_queue[EVENT_QUEUE_LENGTH];
+static unsigned int event_seq = 0;
+static unsigned int mcast_event_seq = 0; // Next compliance event to multicast
+static pthread_mutex_t lock_events = PTHREAD_MUTEX_INITIALIZER;
+// Recorder sink: its cursor, the fusion stage, the run summary and the open files
+static pthread_mutex_t lock_record = PTHREAD_MUTEX_INITIALIZER;
+static t_summary run_summary; // Statistics of the recording in progress, under lock_record
+static unsigned char summary_event[SUMMARY_EVENT_SIZE]; // Last run summary, encoded
+static unsigned int summary_seq = 0;
+_Static_assert(SUMMARY_EVENT_SIZE + LWS_SEND_BUFFER_PRE_PADDING <= WSBUFFERSIZE, "Summary event exceeds websocket buffer");
+_Static_assert(sizeof(t_compliance_event) + LWS_SEND_BUFFER_PRE_PADDING <= WSBUFFERSIZE,
+               "Compliance event exceeds websocket buffer");
 
 /**
  * One of these is created for each client connecting.
@@ -83,7 +149,20 @@ struct per_session_data
 {
     struct per_session_data *pss_list;
     struct lws *wsi;
-    char publishing; // nonzero: peer is publishing to us
+    char publishing;        // nonzero: peer is publishing to us
+    unsigned int event_seq; // Next compliance event to send
+    unsigned int summary_seq; // Run summaries sent
+};
+
+/**
+ * Body of the HTTP response in progress.
+ */
+struct per_http_session
+{
+    const unsigned char *body;
+    size_t len;
+    size_t sent;
+    char *owned; // Generated body, freed when sent
 };
 
 /**
@@ -98,6 +177,9 @@ struct per_vhost_data
 };
 
 static void *serial_read_thread(void *arg);
+static void handle_serial_line(char *buf, ssize_t len);
+static int handle_gps_data(void);
+static void record_drain(double now);
 static error_t parse_opt(int key, char *arg, struct argp_state *state);
 const char *argp_program_version = "meteoserver v1.0";
 const char args_doc[] = "";
@@ -116,18 +198,17 @@ static struct
 static struct gps_data_t gpsdata;
 static bool gps_available = true;
 
-static FILE *record_fp;
-
-// Storage for moving average over 30s
-static double temperature_arr[MOVING_AVG_LENGTH];
-static unsigned char humidity_arr[MOVING_AVG_LENGTH];
-static double windspeed_arr[MOVING_AVG_LENGTH];
-static double cross_wind_arr[MOVING_AVG_LENGTH];
-static double head_wind_arr[MOVING_AVG_LENGTH];
-static double wind_comp1_arr[MOVING_AVG_LENGTH];
-static double wind_comp2_arr[MOVING_AVG_LENGTH];
-static unsigned short wind_direction_arr[MOVING_AVG_LENGTH];
-static unsigned char moving_avg_index = 0;
+// Annex 16 temperature/humidity window and wind limits
+static t_compliance_limits compliance_limits = {COMPLIANCE_10DB, COMPLIANCE_WIND_LIMIT, COMPLIANCE_CROSS_WIND_LIMIT};
+// Quality control, 30 s moving average, compliance and wind rollups of the MAWS samples
+static t_ingest ingest;
+static t_fusion fusion; // Joined MAWS and GPS samples for the recordings, under lock_record
+static t_bus_cursor ws_cursor;     // Websocket, shared memory and multicast sink
+static t_bus_cursor record_cursor; // Recorder sink, under lock_record
+static t_packet_data ws_packet;    // Snapshot sent by the websocket sink, lws thread only
+static unsigned int publish_seq = 0; // Publishes of the websocket sink, lws thread only
+// Recording compression and rotation
+static t_record_options record_options = {0, 0, 0};
 
 static unsigned short runway_elevation = 1204; // Elevation[ft](Manching)
 static unsigned char height_qfe = 1;           // Height difference between barometer and reference level[m]
@@ -169,6 +250,72 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
     case 'd':
         debug_level = atoi(arg);
         break;
+    case OPTSTATE:
+        state_path = arg;
+        break;
+    case OPTMAXCLIENTS:
+        max_clients = atoi(arg);
+        break;
+    case OPTWINDOW:
+        if (compliance_set_window(&compliance_limits, atoi(arg)) != EXIT_SUCCESS)
+            argp_error(state, "Unknown window %s, use 0, 10 or 12", arg);
+        break;
+    case OPTWINDLIMIT:
+        compliance_limits.wind_limit = atof(arg);
+        break;
+    case OPTCROSSWINDLIMIT:
+        compliance_limits.cross_wind_limit = atof(arg);
+        break;
+    case OPTSHM:
+        shm_name = arg != NULL ? arg : SHMRING_NAME;
+        break;
+    case OPTMCAST:
+    {
+        // group[:port]
+        char *colon;
+        strncpy(mcast_group, arg != NULL ? arg : MCAST_GROUP, sizeof mcast_group);
+        mcast_group[(sizeof mcast_group) - 1] = '\0';
+        colon = strchr(mcast_group, ':');
+        if (colon != NULL)
+        {
+            *colon = '\0';
+            mcast_port = (unsigned short)atoi(colon + 1);
+        }
+        break;
+    }
+    case OPTMCASTIF:
+        mcast_iface = arg;
+        break;
+    case OPTRECORDCOMPRESS:
+        record_options.compress_level = arg != NULL ? atoi(arg) : RECORD_COMPRESS_LEVEL;
+        break;
+    case OPTRECORDMAXSIZE:
+        record_options.max_size = arg != NULL ? strtoul(arg, NULL, 10) * 1024 * 1024 : 0;
+        break;
+    case OPTRECORDMAXDURATION:
+        record_options.max_duration = arg != NULL ? (unsigned int)atoi(arg) * 60 : 0;
+        break;
+    case OPTMININTERVAL:
+        min_interval = (unsigned int)atoi(arg);
+        break;
+    case OPTKEEPALIVE:
+        keepalive = (unsigned int)atoi(arg);
+        break;
+    case OPTREACTOR:
+        reactor = true;
+        break;
+    case OPTHTTPROOT:
+        http_root = arg != NULL ? arg : ASSETS_ROOT;
+        break;
+    case OPTNOHTTP:
+        http_root = NULL;
+        break;
+    case OPTARCHIVE:
+        archive_path = arg != NULL ? arg : ARCHIVE_PATH;
+        break;
+    case OPTNOARCHIVE:
+        archive_path = NULL;
+        break;
     case OPTNOGPS:
         gps_available = false;
         lwsl_notice("GPS disabled.\n");
@@ -185,15 +332,160 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state)
 }
 
 /**
- * Start recording.
+ * Checkpoint runway and recording settings.
  */
-static void start_recording(t_start_cmd *start_cmd)
+static void save_settings(void)
+{
+    t_state_settings settings;
+
+    settings.flight_number = packet_data.flight_number;
+    settings.top_number = packet_data.top_number;
+    settings.from_to_status = packet_data.from_to_status;
+    settings.runway_heading = runway_heading;
+    settings.runway_elevation = runway_elevation;
+    state_save_settings(&settings);
+}
+
+/**
+ * Monotonic clock in milliseconds.
+ */
+static unsigned long long monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000ULL + (unsigned long long)ts.tv_nsec / 1000000ULL;
+}
+
+/**
+ * Publish a snapshot of packet data on the bus, caller holds the packet data lock.
+ */
+static void publish_packet(unsigned char source)
+{
+    struct timespec ts_mono;
+    struct timespec ts_wall;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_mono);
+    clock_gettime(CLOCK_REALTIME, &ts_wall);
+    bus_publish(source, &packet_data, (double)ts_mono.tv_sec + (double)ts_mono.tv_nsec / 1e9, &ts_wall);
+}
+
+/**
+ * Producers call this after committing a new snapshot into packet data.
+ * Wakes the lws service loop, the writes are scheduled from there.
+ */
+static void publish_snapshot(void)
+{
+    atomic_store(&publish_pending, true);
+    lws_cancel_service(context);
+}
+
+/**
+ * Stamp packet data for a publish once the minimum interval has elapsed.
+ * Returns false while nothing is pending or the publish is deferred,
+ * the flush timer retries deferred publishes.
+ */
+static bool publish_due(void)
+{
+    unsigned long long now = monotonic_ms();
+    unsigned char wire[PACKET_SIZE];
+    struct timespec ts;
+    t_bus_sample sample;
+
+    if (!atomic_load(&publish_pending))
+        return false;
+    if (now - atomic_load(&last_publish) < min_interval)
+    {
+        restart_timer(flush_timer, (unsigned int)(min_interval - (now - atomic_load(&last_publish))));
+        return false;
+    }
+    atomic_store(&publish_pending, false);
+    atomic_store(&last_publish, now);
+
+    // Only the newest sample matters, a keepalive resends the last one
+    if (bus_read(&ws_cursor, &sample) == BUS_OK)
+        ws_packet = sample.packet;
+    ws_packet.runway_elevation = runway_elevation;
+    ws_packet.runway_heading = runway_heading;
+    // Send time, lets clients measure fan-out latency
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ws_packet.local_time = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    // Clients count the publishes they missed from gaps
+    ws_packet.publish_seq = ++publish_seq;
+    // Only the lws thread publishes, the single writer of the ring and multicast sender
+    shmring_publish(&ws_packet, sizeof(ws_packet));
+    pthread_mutex_lock(&lock_events);
+    if (event_seq - mcast_event_seq > EVENT_QUEUE_LENGTH)
+        mcast_event_seq = event_seq - EVENT_QUEUE_LENGTH;
+    for (; mcast_event_seq != event_seq; mcast_event_seq++)
+        mcast_send(MCAST_TYPE_EVENT, &event_queue[mcast_event_seq % EVENT_QUEUE_LENGTH], sizeof(t_compliance_event));
+    pthread_mutex_unlock(&lock_events);
+    // Multicast carries the same little endian wire format as the websocket
+    mcast_send(MCAST_TYPE_PACKET, wire, packet_encode(wire, sizeof(wire), &ws_packet));
+    TRACE(publish, PACKET_SIZE, trace_now_ns());
+    return true;
+}
+
+/**
+ * Queue a compliance state transition for all clients.
+ */
+static void push_compliance_event(unsigned char flags, unsigned char changed)
+{
+    struct timespec ts;
+    t_compliance_event *evt;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    pthread_mutex_lock(&lock_events);
+    evt = &event_queue[event_seq % EVENT_QUEUE_LENGTH];
+    evt->id = SERVER_EVT_COMPLIANCE;
+    evt->compliance = flags;
+    evt->changed = changed;
+    evt->local_time = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    event_seq++;
+    pthread_mutex_unlock(&lock_events);
+
+    if (changed & COMPLIANCE_VALID)
+    {
+        lwsl_notice("Conditions %s limits\n", (flags & COMPLIANCE_VALID) ? "within" : "out of");
+    }
+}
+
+/**
+ * Open the GPS track of the run started last.
+ */
+static void start_track(void)
 {
     char path[FILENAME_MAX];
-    struct stat st = {0};
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
 
+    if (record_file_path(path, sizeof(path), run_summary.flight_number, run_summary.top_number, TRACK_KIND,
+                         run_summary.start, TRACK_SUFFIX) != EXIT_SUCCESS ||
+        track_open(path) != EXIT_SUCCESS)
+    {
+        lwsl_err("Error creating GPS track: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * Close the GPS track of the run.
+ */
+static void stop_track(void)
+{
+    t_track_stats stats;
+
+    if (!track_is_open())
+    {
+        return;
+    }
+    track_close(&stats);
+    lwsl_notice("GPS track: %lu fixes, %lu bytes, %lu dropped\n", stats.fixes, stats.bytes, stats.dropped);
+}
+
+/**
+ * Start recording.
+ */
+static void start_recording(t_start_cmd *start_cmd)
+{
+    pthread_mutex_lock(&lock_record);
     pthread_mutex_trylock(&lock_packetdata_update);
     if (start_cmd->flight_number > 0)
     {
@@ -204,35 +496,44 @@ static void start_recording(t_start_cmd *start_cmd)
     {
         packet_data.top_number = start_cmd->top_number;
     }
-    // Create subfolder by date if not exists
-    snprintf(path, FILENAME_MAX, "/var/meteodata/%02u%02u%04u", t->tm_mday, t->tm_mon + 1, 1900 + t->tm_year);
-    if (stat(path, &st) == -1)
-    {
-        mkdir(path, 0755);
-    }
-    // Create file by flight and top number
-    snprintf(path, FILENAME_MAX, "/var/meteodata/%02u%02u%04u/F%04u_REC%03u_MeteoData_%02u%02u%02u.csv",
-             t->tm_mday,
-             t->tm_mon + 1,
-             1900 + t->tm_year,
-             packet_data.flight_number,
-             packet_data.top_number,
-             t->tm_hour,
-             t->tm_min,
-             t->tm_sec);
-    record_fp = fopen(path, "a");
-    if (record_fp != NULL)
-    {
-        // Add file header
-        fputs("LOG_TIME;TEMP;HUM;PRESSURE;DIRECTION;WIND_TOTAL;WIND_LAT;MEAN_WIND_TOTAL;MEAN_WIND_LAT;GPS_EPOCH_RECORDED;TIME_MAWS_RECORDED;TOP_NUMBER\n", record_fp);
-        fputs("HH:MM:SS;degC;%;mbar;deg;kt;kt;kt;kt;seconds;HH:MM:SS;#\n", record_fp);
+
+    if (record_open(packet_data.flight_number, packet_data.top_number) == EXIT_SUCCESS)
+    {
         packet_data.record_status = 1;
+        summary_start(&run_summary, packet_data.flight_number, packet_data.top_number, time(NULL));
+        if (gps_available)
+        {
+            start_track();
+        }
     }
     else
     {
         lwsl_err("Error creating log file: %s\n", strerror(errno));
     }
     pthread_mutex_unlock(&lock_packetdata_update);
+    pthread_mutex_unlock(&lock_record);
+}
+
+/**
+ * Write the summary of the stopped run and queue it for all clients.
+ */
+static void finish_run_summary(void)
+{
+    char path[FILENAME_MAX];
+
+    run_summary.stop = time(NULL);
+    if (record_file_path(path, sizeof(path), run_summary.flight_number, run_summary.top_number,
+                         SUMMARY_KIND, run_summary.start, ".csv") != EXIT_SUCCESS ||
+        summary_write(&run_summary, path) != EXIT_SUCCESS)
+    {
+        lwsl_err("Error writing run summary: %s\n", strerror(errno));
+    }
+    pthread_mutex_lock(&lock_events);
+    summary_encode(summary_event, sizeof(summary_event), &run_summary);
+    summary_seq++;
+    pthread_mutex_unlock(&lock_events);
+    lwsl_notice("Run F%u TOP%u: %u s, %u s within limits\n", run_summary.flight_number, run_summary.top_number,
+                run_summary.seconds, run_summary.seconds_valid);
 }
 
 /**
@@ -240,24 +541,132 @@ static void start_recording(t_start_cmd *start_cmd)
  */
 static void stop_recording(void)
 {
+    // The record timer must not write rows while the files are closed
+    pthread_mutex_lock(&lock_record);
+    // Rows still waiting for a fix belong to this recording
+    if (record_is_open())
+        record_drain(INFINITY);
     pthread_mutex_trylock(&lock_packetdata_update);
-    if (record_fp != NULL)
+    if (record_is_open())
     {
-        fclose(record_fp);
+        record_close();
+        stop_track();
+        finish_run_summary();
         packet_data.top_number += 1;
     }
     packet_data.record_status = 0;
     pthread_mutex_unlock(&lock_packetdata_update);
+    pthread_mutex_unlock(&lock_record);
+    save_settings();
+}
+
+/**
+ * MAWS service command setting the clock to the GPS time.
+ */
+static size_t maws_time_command(char *buf, size_t size)
+{
+    pthread_mutex_trylock(&lock_packetdata_update);
+    time_t now = (time_t)packet_data.gps_time;
+    struct tm *t = gmtime(&now);
+    pthread_mutex_unlock(&lock_packetdata_update);
+    return strftime(buf, size, "time %H %M %S %y %m %d\r\n", t);
+}
+
+/**
+ * Close the MAWS service connection and resume reading meteo data in the reactor.
+ */
+static void sync_finish(void)
+{
+    // Try to close service connection in any case
+    write_serial("close\r\n", 7);
+    sync_state = SYNC_IDLE;
+}
+
+/**
+ * Service connection lines read while a reactor time sync runs.
+ * The MAWS answers to the time and timezone commands are dropped.
+ */
+static void sync_serial_line(char *buf, ssize_t len)
+{
+    char cmd[32];
+    size_t n;
+
+    if (sync_state != SYNC_SERVICE || buf == NULL || len <= 0)
+        return;
+    if (strstr(buf, "Service") == NULL)
+    {
+        if (++sync_lines >= SYNC_SERVICE_LINES)
+        {
+            lwsl_err("Opening MAWS service connection failed\n");
+            sync_finish();
+        }
+        return;
+    }
+    // Sync GPS time with MAWS
+    n = maws_time_command(cmd, sizeof(cmd));
+    write_serial(cmd, n);
+    sync_state = SYNC_TIME;
+    restart_timer(sync_timer, 1000);
+}
+
+/**
+ * Callback function for the reactor time sync timer.
+ * Paces the service commands, the MAWS needs a second for each.
+ */
+static void sync_timer_handler(size_t timer_id, void *user_data)
+{
+    NOTUSED(timer_id);
+    NOTUSED(user_data);
+
+    switch (sync_state)
+    {
+    case SYNC_SERVICE:
+        lwsl_err("Opening MAWS service connection failed\n");
+        sync_finish();
+        break;
+    case SYNC_TIME:
+        // Set UTC time zone in MAWS
+        write_serial("timezone 0\r\n", 12);
+        sync_state = SYNC_TIMEZONE;
+        restart_timer(sync_timer, 1000);
+        break;
+    case SYNC_TIMEZONE:
+        lwsl_err("GPS time synced to MAWS\n");
+        sync_finish();
+        break;
+    default:
+        break;
+    }
 }
 
 /**
  * Sync MAWS time with GPS time.
+ * The reactor must not block, there the sync continues in sync_serial_line and sync_timer_handler.
  */
 static void sync_maws_time(void)
 {
     char *buf;
     char *res = NULL;
     ssize_t len = 0;
+
+    if (reactor)
+    {
+        if (sync_state != SYNC_IDLE)
+        {
+            lwsl_warn("MAWS time sync already running\n");
+            return;
+        }
+        // Open service connection to MAWS, the reply is read by the loop
+        if (write_serial("open\r\n", 6) == -1)
+        {
+            sync_finish();
+            return;
+        }
+        sync_state = SYNC_SERVICE;
+        sync_lines = 0;
+        restart_timer(sync_timer, SYNC_SERVICE_TIMEOUT);
+        return;
+    }
     // Stop meteo data reception
     serial_thread_exit = true;
     pthread_join(serial_thread, NULL); /* Wait on serial read thread exit */
@@ -269,7 +678,7 @@ static void sync_maws_time(void)
         {
             sleep(1);
             // Read lines until we find service notification
-            for (int i = 0; i < 10; i++)
+            for (int i = 0; i < SYNC_SERVICE_LINES; i++)
             {
                 buf = read_serial(&len);
                 // Check for service connection
@@ -285,13 +694,8 @@ static void sync_maws_time(void)
 
             if (res != NULL)
             {
-                pthread_mutex_trylock(&lock_packetdata_update);
-                time_t now = (time_t)packet_data.gps_time;
-                struct tm *t = gmtime(&now);
-                pthread_mutex_unlock(&lock_packetdata_update);
                 // Sync GPS time with MAWS
-                strftime(buf, 1024, "time %H %M %S %y %m %d\r\n", t);
-                write_serial(buf, 24);
+                write_serial(buf, maws_time_command(buf, 1024));
                 sleep(1);
                 // Set UTC time zone in MAWS
                 write_serial("timezone 0\r\n", 12);
@@ -375,6 +779,7 @@ static void handle_client_request(void *in, size_t len)
     default:
         break;
     }
+    save_settings();
 }
 
 static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
@@ -392,9 +797,9 @@ static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
     switch (reason)
     {
     case LWS_CALLBACK_FILTER_NETWORK_CONNECTION:
-        if (num_clients > 50)
+        if (num_clients > max_clients)
         {
-            lwsl_notice("50 clients already connected. New connection rejected...\n");
+            lwsl_notice("%d clients already connected. New connection rejected...\n", max_clients);
             return -1;
         }
         break;
@@ -411,10 +816,21 @@ static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
 
         break;
 
+    case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+        // Woken by publish_snapshot(), a new snapshot is committed
+        if (vhd != NULL && publish_due())
+            lws_callback_on_writable_all_protocol(vhd->context, vhd->protocol);
+        break;
+
     case LWS_CALLBACK_ESTABLISHED:
         ++num_clients;
         lwsl_notice("Client connected.\n");
         pss->wsi = wsi;
+        // Current flags are in the packet, only later transitions are pushed
+        pthread_mutex_lock(&lock_events);
+        pss->event_seq = event_seq;
+        pss->summary_seq = summary_seq;
+        pthread_mutex_unlock(&lock_events);
         if (lws_hdr_copy(wsi, buf, sizeof(buf), WSI_TOKEN_GET_URI) > 0)
             pss->publishing = !strcmp(buf, "/publisher");
         if (!pss->publishing)
@@ -436,12 +852,50 @@ static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
         if (pss->publishing)
             break;
 
-        memcpy(&pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], (unsigned char *)&packet_data, sizeof(packet_data));
-        wsbuffer_len = sizeof(packet_data);
+        // Pending compliance events and run summaries go first, the packet follows on next writeable
+        pthread_mutex_lock(&lock_events);
+        if (event_seq - pss->event_seq > EVENT_QUEUE_LENGTH)
+            pss->event_seq = event_seq - EVENT_QUEUE_LENGTH;
+        if (pss->event_seq != event_seq)
+        {
+            memcpy(&pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], &event_queue[pss->event_seq % EVENT_QUEUE_LENGTH],
+                   sizeof(t_compliance_event));
+            pss->event_seq++;
+            pthread_mutex_unlock(&lock_events);
+            m = lws_write(wsi, &pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], sizeof(t_compliance_event), LWS_WRITE_BINARY);
+            TRACE(client_write, lws_get_socket_fd(wsi), sizeof(t_compliance_event), m, trace_now_ns());
+            if (m < (int)sizeof(t_compliance_event))
+            {
+                lwsl_err("ERROR %d writing to ws socket\n", m);
+                return -1;
+            }
+            lws_callback_on_writable(wsi);
+            break;
+        }
+        if (pss->summary_seq != summary_seq)
+        {
+            memcpy(&pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], summary_event, sizeof(summary_event));
+            pss->summary_seq = summary_seq;
+            pthread_mutex_unlock(&lock_events);
+            m = lws_write(wsi, &pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], sizeof(summary_event), LWS_WRITE_BINARY);
+            TRACE(client_write, lws_get_socket_fd(wsi), sizeof(summary_event), m, trace_now_ns());
+            if (m < (int)sizeof(summary_event))
+            {
+                lwsl_err("ERROR %d writing to ws socket\n", m);
+                return -1;
+            }
+            lws_callback_on_writable(wsi);
+            break;
+        }
+        pthread_mutex_unlock(&lock_events);
+
+        wsbuffer_len = packet_encode(&pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING],
+                                     WSBUFFERSIZE - LWS_SEND_BUFFER_PRE_PADDING, &ws_packet);
 
         /* notice we allowed for LWS_PRE in the payload already */
         m = lws_write(wsi, &pwsbuffer[LWS_SEND_BUFFER_PRE_PADDING], wsbuffer_len, LWS_WRITE_BINARY);
-        if (m < (int)sizeof(packet_data))
+        TRACE(client_write, lws_get_socket_fd(wsi), wsbuffer_len, m, trace_now_ns());
+        if (m < (int)PACKET_SIZE)
         {
             lwsl_err("ERROR %d writing to ws socket\n", m);
             return -1;
@@ -464,17 +918,12 @@ static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
         wsbuffer_len = 1;
         handle_client_request(in, len);
         pthread_mutex_unlock(&lock_established_conns);
+        pthread_mutex_trylock(&lock_packetdata_update);
+        publish_packet(BUS_SOURCE_STATE);
+        pthread_mutex_unlock(&lock_packetdata_update);
 
-        /*
-		 * let every subscriber know we want to write something
-		 * on them as soon as they are ready
-		 */
-        lws_start_foreach_llp(struct per_session_data **, ppss, vhd->pss_list)
-        {
-            if (!(*ppss)->publishing)
-                lws_callback_on_writable((*ppss)->wsi);
-        }
-        lws_end_foreach_llp(ppss, pss_list);
+        // Let every subscriber see the changed settings
+        publish_snapshot();
         break;
 
     default:
@@ -485,92 +934,669 @@ static int callback_broadcast(struct lws *wsi, enum lws_callback_reasons reason,
 }
 
 /**
- * Websocket protocol definition.
- */
-static struct lws_protocols protocols[] = {
-    {"http",
-     lws_callback_http_dummy,
-     0,
-     0,
-     0,
-     NULL,
-     0},
-    {"broadcast",
-     callback_broadcast,
-     sizeof(struct per_session_data),
-     WSBUFFERSIZE,
-     0, NULL, 0},
-    {NULL, NULL, 0, 0, 0, NULL, 0} /* terminator */
-};
-
-/**
- * Set affinity of calling thread to specific core on a multi-core CPU
+ * Accept connections on a listening socket inherited from systemd.
+ * The listening socket is adopted as raw file descriptor, accepted sockets
+ * are handed to lws like connections on its own listener.
  */
-static int thread_to_core(int core_id)
+static int callback_listen(struct lws *wsi, enum lws_callback_reasons reason,
+                           void *user, void *in, size_t len)
 {
-    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    if (core_id < 0 || core_id >= num_cores)
-        return EINVAL;
+    NOTUSED(user);
+    NOTUSED(in);
+    NOTUSED(len);
+    int fd;
 
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core_id, &cpuset);
+    switch (reason)
+    {
+    case LWS_CALLBACK_RAW_RX_FILE:
+        while ((fd = accept4(lws_get_socket_fd(wsi), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+        {
+            if (lws_adopt_socket_vhost(lws_get_vhost(wsi), fd) == NULL)
+            {
+                lwsl_err("Failed to adopt accepted socket\n");
+            }
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            lwsl_err("Accept on inherited socket failed: %s\n", strerror(errno));
+        }
+        break;
+    default:
+        break;
+    }
 
-    pthread_t current_thread = pthread_self();
-    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+    return 0;
 }
 
 /**
- * Incoming signal handler. Close server nice and clean.
+ * Serial, gpsd and timer descriptors adopted into the lws loop with --reactor.
+ * Everything runs on the lws thread, the packet data needs no locking.
  */
-static void sighandler(int sig)
+static int callback_reactor(struct lws *wsi, enum lws_callback_reasons reason,
+                            void *user, void *in, size_t len)
 {
-    NOTUSED(sig);
-    stop_recording();
-    stop_timer(packet_timer);
-    stop_timer(record_timer);
-
-    finalize_timer();
-
-    pthread_mutex_unlock(&lock_packetdata_update);
-    gps_thread_exit = true;
-    pthread_join(gps_thread, NULL); /* Wait on GPS read thread exit */
+    NOTUSED(user);
+    NOTUSED(in);
+    NOTUSED(len);
+    int fd;
 
-    serial_thread_exit = true;
-    pthread_join(serial_thread, NULL); /* Wait on serial read thread exit */
-    pthread_mutex_destroy(&lock_packetdata_update);
+    switch (reason)
+    {
+    case LWS_CALLBACK_RAW_RX_FILE:
+        fd = lws_get_socket_fd(wsi);
+        if (fd == get_serial_fd())
+        {
+            ssize_t n = 0;
+            char *buf = read_serial(&n);
+            // A time sync owns the line until its service connection is closed
+            if (sync_state != SYNC_IDLE)
+                sync_serial_line(buf, n);
+            else
+                handle_serial_line(buf, n);
+        }
+        else if (gps_available && fd == gpsdata.gps_fd)
+        {
+            // Reports already buffered by libgps do not wake the loop again
+            do
+            {
+                if (handle_gps_data() != EXIT_SUCCESS)
+                {
+                    // gpsd went away, lws closes the descriptor
+                    gps_available = false;
+                    return -1;
+                }
+            } while (gps_waiting(&gpsdata, 0));
+        }
+        else
+        {
+            timer_dispatch(fd);
+        }
+        break;
+    default:
+        break;
+    }
 
-    pthread_mutex_unlock(&lock_established_conns);
-    pthread_mutex_destroy(&lock_established_conns);
-    lws_cancel_service(context);
-    lws_context_destroy(context);
+    return 0;
+}
 
-    exit(EXIT_SUCCESS);
+/**
+ * Status line and headers of a response, optional ones are NULL.
+ */
+static int http_headers(struct lws *wsi, unsigned int status, const char *mime, size_t len,
+                        const char *etag, const char *cache_control, const char *encoding)
+{
+    unsigned char headers[LWS_SEND_BUFFER_PRE_PADDING + 512];
+    unsigned char *start = &headers[LWS_SEND_BUFFER_PRE_PADDING];
+    unsigned char *p = start;
+    unsigned char *end = &headers[sizeof(headers) - 1];
+
+    if (lws_add_http_header_status(wsi, status, &p, end))
+        return -1;
+    if (mime != NULL &&
+        lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CONTENT_TYPE, (const unsigned char *)mime, (int)strlen(mime), &p, end))
+        return -1;
+    if (etag != NULL &&
+        lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_ETAG, (const unsigned char *)etag, (int)strlen(etag), &p, end))
+        return -1;
+    if (cache_control != NULL &&
+        lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CACHE_CONTROL, (const unsigned char *)cache_control, (int)strlen(cache_control), &p, end))
+        return -1;
+    if (encoding != NULL &&
+        lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CONTENT_ENCODING, (const unsigned char *)encoding, (int)strlen(encoding), &p, end))
+        return -1;
+    // Caches must keep the encoded variants apart
+    if (etag != NULL &&
+        lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_VARY, (const unsigned char *)"Accept-Encoding", 15, &p, end))
+        return -1;
+    // A 304 has no body, its length would describe the cached one
+    if (status != HTTP_STATUS_NOT_MODIFIED && lws_add_http_header_content_length(wsi, len, &p, end))
+        return -1;
+    if (lws_finalize_http_header(wsi, &p, end))
+        return -1;
+    return lws_write(wsi, start, (size_t)(p - start), LWS_WRITE_HTTP_HEADERS) < 0 ? -1 : 0;
 }
 
 /**
- * GPS read thread.
- * This need its own thread to avoid delays in time update.
+ * Queue a response body, sent in chunks from the writeable callback.
  */
-static void *gps_read_thread(void *arg)
+static int http_body(struct lws *wsi, struct per_http_session *pss, const void *body, size_t len)
 {
-    NOTUSED(arg);
-    thread_to_core(2);
-    gpssource.server = (char *)"localhost";
-    gpssource.port = (char *)DEFAULT_GPSD_PORT;
-    gpssource.device = NULL;
+    pss->body = body;
+    pss->len = len;
+    pss->sent = 0;
+    if (len == 0)
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    lws_callback_on_writable(wsi);
+    return 0;
+}
 
-    if (gps_open(gpssource.server, gpssource.port, &gpsdata) != 0)
+/**
+ * Send the next chunk of the queued body.
+ */
+static int http_write_body(struct lws *wsi, struct per_http_session *pss)
+{
+    size_t n = pss->len - pss->sent;
+    bool last = n <= HTTP_CHUNK_SIZE;
+
+    if (!last)
+        n = HTTP_CHUNK_SIZE;
+    // lws_write needs the pre padding in front of the data
+    memcpy(&http_buffer[LWS_SEND_BUFFER_PRE_PADDING], pss->body + pss->sent, n);
+    if (lws_write(wsi, &http_buffer[LWS_SEND_BUFFER_PRE_PADDING], n, last ? LWS_WRITE_HTTP_FINAL : LWS_WRITE_HTTP) < 0)
+        return -1;
+    pss->sent += n;
+    if (!last)
+    {
+        lws_callback_on_writable(wsi);
+        return 0;
+    }
+    free(pss->owned);
+    pss->owned = NULL;
+    pss->body = NULL;
+    return lws_http_transaction_completed(wsi) ? -1 : 0;
+}
+
+/**
+ * Serve one file of the client bundle.
+ */
+static int http_asset(struct lws *wsi, struct per_http_session *pss, const char *path)
+{
+    char accept_encoding[256];
+    char if_none_match[256];
+    char version[32];
+    const t_asset *asset = assets_find(path);
+    const t_asset_variant *variant;
+    const char *cache_control = "no-cache";
+    t_asset_encoding encoding;
+
+    if (asset == NULL)
+    {
+        lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    }
+
+    if (lws_hdr_copy(wsi, accept_encoding, sizeof(accept_encoding), WSI_TOKEN_HTTP_ACCEPT_ENCODING) < 0)
+        accept_encoding[0] = '\0';
+    encoding = assets_select(asset, accept_encoding);
+    variant = &asset->variant[encoding];
+
+    // Versioned URLs never change content, everything else is revalidated by ETag
+    if (lws_get_urlarg_by_name(wsi, ASSETS_VERSION_ARG "=", version, sizeof(version)) != NULL &&
+        strcmp(version, asset->version) == 0)
+        cache_control = ASSETS_CACHE_IMMUTABLE;
+
+    if (lws_hdr_copy(wsi, if_none_match, sizeof(if_none_match), WSI_TOKEN_HTTP_IF_NONE_MATCH) > 0 &&
+        (strstr(if_none_match, variant->etag) != NULL || strcmp(if_none_match, "*") == 0))
+    {
+        if (http_headers(wsi, HTTP_STATUS_NOT_MODIFIED, NULL, 0, variant->etag, cache_control, NULL))
+            return -1;
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    }
+
+    if (http_headers(wsi, HTTP_STATUS_OK, asset->mime, variant->len, variant->etag, cache_control,
+                     assets_encoding_name(encoding)))
+        return -1;
+    return http_body(wsi, pss, variant->data, variant->len);
+}
+
+static int compare_name(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Redirect a mount point or day folder without trailing slash.
+ */
+static int http_redirect(struct lws *wsi, const char *uri)
+{
+    unsigned char headers[LWS_SEND_BUFFER_PRE_PADDING + 512];
+    unsigned char *p = &headers[LWS_SEND_BUFFER_PRE_PADDING];
+    unsigned char *end = &headers[sizeof(headers) - 1];
+    char location[PATH_MAX];
+    int n;
+
+    snprintf(location, sizeof(location), "%s/", uri);
+    n = (int)strlen(location);
+
+    if (lws_http_redirect(wsi, HTTP_STATUS_MOVED_PERMANENTLY, (unsigned char *)location, n, &p, end) < 0)
+        return -1;
+    return lws_http_transaction_completed(wsi) ? -1 : 0;
+}
+
+/**
+ * Directory listing of the recordings, dir is "" for the day folders or "DDMMYYYY/".
+ */
+static int http_download_list(struct lws *wsi, struct per_http_session *pss, const char *dir)
+{
+    char base[PATH_MAX];
+    DIR *d;
+    struct dirent *de;
+    char **names = NULL;
+    size_t count = 0;
+    size_t size = 0;
+    size_t i;
+    FILE *f;
+
+    snprintf(base, sizeof(base), RECORD_PATH "/%s", dir);
+    d = opendir(base);
+    if (d == NULL)
+    {
+        lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    }
+    while ((de = readdir(d)) != NULL)
+    {
+        char **grown;
+        // Hidden files and names that would need escaping are not listed
+        if (de->d_name[0] == '.' || strpbrk(de->d_name, "<>&\"'") != NULL)
+            continue;
+        grown = realloc(names, (count + 1) * sizeof(char *));
+        if (grown == NULL)
+            break;
+        names = grown;
+        if ((names[count] = strdup(de->d_name)) != NULL)
+            count++;
+    }
+    closedir(d);
+    qsort(names, count, sizeof(char *), compare_name);
+
+    f = open_memstream(&pss->owned, &size);
+    if (f != NULL)
+    {
+        fprintf(f, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Recordings %s</title></head>"
+                   "<body><h1>Recordings %s</h1><ul>\n",
+                dir, dir);
+        if (dir[0] != '\0')
+            fputs("<li><a href=\"../\">../</a></li>\n", f);
+        for (i = 0; i < count; i++)
+        {
+            char path[PATH_MAX];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s%s", base, names[i]);
+            if (stat(path, &st) != 0)
+                continue;
+            // Day folders at the top, their recordings one level down
+            if (S_ISDIR(st.st_mode) && dir[0] == '\0')
+                fprintf(f, "<li><a href=\"%s/\">%s/</a></li>\n", names[i], names[i]);
+            else if (S_ISREG(st.st_mode))
+                fprintf(f, "<li><a href=\"%s\">%s</a> %lld kB</li>\n", names[i], names[i],
+                        (long long)(st.st_size + 1023) / 1024);
+        }
+        fputs("</ul></body></html>\n", f);
+        fclose(f);
+    }
+    for (i = 0; i < count; i++)
+        free(names[i]);
+    free(names);
+    if (pss->owned == NULL)
+        return -1;
+
+    if (http_headers(wsi, HTTP_STATUS_OK, assets_mime(".html"), size, NULL, "no-cache", NULL))
+        return -1;
+    return http_body(wsi, pss, pss->owned, size);
+}
+
+/**
+ * Serve a recording or a listing, name is relative to the record directory.
+ * Only the record directory and one level of day folders are served, lws
+ * streams files itself.
+ */
+static int http_download(struct lws *wsi, struct per_http_session *pss, const char *name)
+{
+    static const char headers[] = "cache-control: no-cache\r\n";
+    const char *slash = strchr(name, '/');
+    char path[PATH_MAX];
+    struct stat st;
+    int n;
+
+    if (name[0] == '\0')
+        return http_download_list(wsi, pss, "");
+    // No hidden names or .. in either segment, no deeper levels, nothing the listing would escape
+    if (name[0] == '.' || (slash != NULL && (slash[1] == '.' || strchr(slash + 1, '/') != NULL)) ||
+        strpbrk(name, "<>&\"'") != NULL ||
+        snprintf(path, sizeof(path), RECORD_PATH "/%s", name) >= (int)sizeof(path) || stat(path, &st) != 0)
+    {
+        lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        char uri[PATH_MAX];
+        if (slash == NULL)
+        {
+            snprintf(uri, sizeof(uri), "/download/%s", name);
+            return http_redirect(wsi, uri);
+        }
+        if (slash[1] == '\0')
+            return http_download_list(wsi, pss, name);
+        lws_return_http_status(wsi, HTTP_STATUS_NOT_FOUND, NULL);
+        return lws_http_transaction_completed(wsi) ? -1 : 0;
+    }
+    n = lws_serve_http_file(wsi, path, assets_mime(name), headers, sizeof(headers) - 1);
+    if (n < 0 || (n > 0 && lws_http_transaction_completed(wsi)))
+        return -1;
+    return 0;
+}
+
+/**
+ * Web client and recordings, replaces the separate web server.
+ * The client is served below /, /meteo/ and /weather/, recordings below /download/.
+ */
+static int callback_http(struct lws *wsi, enum lws_callback_reasons reason,
+                         void *user, void *in, size_t len)
+{
+    static const char *const mounts[] = {"/meteo", "/weather", "/download"};
+    struct per_http_session *pss = (struct per_http_session *)user;
+    const char *uri = (const char *)in;
+    size_t i;
+
+    switch (reason)
+    {
+    case LWS_CALLBACK_HTTP:
+        memset(pss, 0, sizeof(*pss));
+        if (http_root == NULL)
+            break;
+        for (i = 0; i < sizeof(mounts) / sizeof(mounts[0]); i++)
+        {
+            size_t n = strlen(mounts[i]);
+            if (strncmp(uri, mounts[i], n) != 0)
+                continue;
+            if (uri[n] == '\0')
+                return http_redirect(wsi, mounts[i]);
+            if (uri[n] == '/')
+            {
+                if (i == 2)
+                    return http_download(wsi, pss, uri + n + 1);
+                uri += n;
+                break;
+            }
+        }
+        if (uri[0] == '\0' || uri[strlen(uri) - 1] == '/')
+        {
+            char index[PATH_MAX];
+            snprintf(index, sizeof(index), "%s" ASSETS_INDEX, uri);
+            return http_asset(wsi, pss, index);
+        }
+        return http_asset(wsi, pss, uri);
+    case LWS_CALLBACK_HTTP_WRITEABLE:
+        if (pss != NULL && pss->body != NULL)
+            return http_write_body(wsi, pss);
+        break;
+    case LWS_CALLBACK_CLOSED_HTTP:
+        if (pss != NULL)
+        {
+            free(pss->owned);
+            pss->owned = NULL;
+            pss->body = NULL;
+        }
+        break;
+    default:
+        break;
+    }
+
+    return lws_callback_http_dummy(wsi, reason, user, in, len);
+}
+
+/**
+ * Websocket protocol definition.
+ */
+static struct lws_protocols protocols[] = {
+    {"http",
+     callback_http,
+     sizeof(struct per_http_session),
+     0,
+     0,
+     NULL,
+     0},
+    {"broadcast",
+     callback_broadcast,
+     sizeof(struct per_session_data),
+     WSBUFFERSIZE,
+     0, NULL, 0},
+    {"listen",
+     callback_listen,
+     0,
+     0,
+     0, NULL, 0},
+    {"reactor",
+     callback_reactor,
+     0,
+     0,
+     0, NULL, 0},
+    {NULL, NULL, 0, 0, 0, NULL, 0} /* terminator */
+};
+
+/**
+ * Listening socket passed by systemd socket activation.
+ * Returns -1 when not socket activated.
+ */
+static int systemd_listen_fd(void)
+{
+    const char *pid = getenv("LISTEN_PID");
+    const char *fds = getenv("LISTEN_FDS");
+    int fd = SD_LISTEN_FDS_START;
+
+    if (pid == NULL || fds == NULL || atoi(pid) != getpid() || atoi(fds) < 1)
+        return -1;
+
+    // Do not pass the socket on to children
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+/**
+ * Set affinity of calling thread to specific core on a multi-core CPU
+ */
+static int thread_to_core(int core_id)
+{
+    int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (core_id < 0 || core_id >= num_cores)
+        return EINVAL;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    pthread_t current_thread = pthread_self();
+    return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
+}
+
+/**
+ * Incoming signal handler. Close server nice and clean.
+ */
+static void sighandler(int sig)
+{
+    NOTUSED(sig);
+    stop_recording();
+    stop_timer(publish_timer);
+    stop_timer(record_timer);
+
+    finalize_timer();
+
+    pthread_mutex_unlock(&lock_packetdata_update);
+    if (reactor)
+    {
+        if (gps_available)
+            gps_close(&gpsdata);
+        close_serial();
+    }
+    else
+    {
+        gps_thread_exit = true;
+        pthread_join(gps_thread, NULL); /* Wait on GPS read thread exit */
+
+        serial_thread_exit = true;
+        pthread_join(serial_thread, NULL); /* Wait on serial read thread exit */
+    }
+    ingest_free(&ingest);
+    pthread_mutex_destroy(&lock_packetdata_update);
+
+    pthread_mutex_unlock(&lock_established_conns);
+    pthread_mutex_destroy(&lock_established_conns);
+    lws_cancel_service(context);
+    lws_context_destroy(context);
+    state_close();
+    archive_close();
+    shmring_close();
+    mcast_close();
+    assets_free();
+
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Copy a new GPS fix into packet data, caller holds the packet data lock.
+ */
+static void update_gps_data(void)
+{
+    packet_data.gps_status = (unsigned char)gpsdata.status;
+    packet_data.gps_mode = (unsigned char)gpsdata.fix.mode;
+    packet_data.gps_satellites_visible = (unsigned char)gpsdata.satellites_visible;
+    packet_data.gps_satellites_used = (unsigned char)gpsdata.satellites_used;
+    packet_data.gps_hdop = gpsdata.dop.hdop;
+    packet_data.gps_pdop = gpsdata.dop.pdop;
+    packet_data.gps_lat = gpsdata.fix.latitude;
+    packet_data.gps_lon = gpsdata.fix.longitude;
+#if GPSD_API_MAJOR_VERSION < 9
+    packet_data.gps_alt_msl = gpsdata.fix.altitude * METERS_TO_FEET;
+    packet_data.gps_time = gpsdata.fix.time;
+#else
+    packet_data.gps_alt_msl = gpsdata.fix.altMSL * METERS_TO_FEET;
+    packet_data.gps_time = (double)gpsdata.fix.time.tv_sec;
+#endif
+}
+
+/**
+ * Time of the current fix, UTC [s].
+ */
+static double gps_fix_time(void)
+{
+#if GPSD_API_MAJOR_VERSION < 9
+    return gpsdata.fix.time;
+#else
+    return (double)gpsdata.fix.time.tv_sec + (double)gpsdata.fix.time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Queue the current fix for the GPS track, the track ignores repeated fixes.
+ */
+static void push_track_fix(void)
+{
+    t_track_fix fix;
+
+    fix.mode = (unsigned char)gpsdata.fix.mode;
+    fix.satellites = (unsigned char)gpsdata.satellites_used;
+    fix.latitude = gpsdata.fix.latitude;
+    fix.longitude = gpsdata.fix.longitude;
+    fix.speed = gpsdata.fix.speed;
+    fix.course = gpsdata.fix.track;
+    fix.hdop = gpsdata.dop.hdop;
+    fix.vdop = gpsdata.dop.vdop;
+    fix.pdop = gpsdata.dop.pdop;
+    fix.time = gps_fix_time();
+#if GPSD_API_MAJOR_VERSION < 9
+    fix.altitude = gpsdata.fix.altitude;
+#else
+    fix.altitude = gpsdata.fix.altMSL;
+#endif
+    if (fix.mode < MODE_2D)
+    {
+        fix.latitude = NAN;
+        fix.longitude = NAN;
+    }
+    if (fix.mode < MODE_3D)
+    {
+        fix.altitude = NAN;
+    }
+    track_push(&fix);
+}
+
+/**
+ * True when the last report carried a new fix, sky and device reports repeat the last fix.
+ */
+static bool gps_new_fix(void)
+{
+    static double last_fix_time = 0.0;
+    double fix_time = gps_fix_time();
+
+    if (!(fix_time > last_fix_time))
+    {
+        return false;
+    }
+    last_fix_time = fix_time;
+    return true;
+}
+
+/**
+ * Connect to gpsd and start watching.
+ */
+static int open_gps(void)
+{
+    gpssource.server = (char *)"localhost";
+    gpssource.port = (char *)DEFAULT_GPSD_PORT;
+    gpssource.device = NULL;
+
+    if (gps_open(gpssource.server, gpssource.port, &gpsdata) != 0)
     {
         gps_available = false;
         lwsl_err("No gpsd running or network error: %s\n", gps_errstr(errno));
-        pthread_exit(NULL);
+        return EXIT_FAILURE;
     }
 
     unsigned int flags = WATCH_ENABLE;
     if (gpssource.device != NULL)
         flags |= WATCH_DEVICE;
     gps_stream(&gpsdata, flags, gpssource.device);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Read pending report from gpsd into packet data, caller holds the packet data lock.
+ */
+static int handle_gps_data(void)
+{
+#if GPSD_API_MAJOR_VERSION < 9
+    if (gps_read(&gpsdata) == -1)
+#else
+    if (gps_read(&gpsdata, NULL, 0) == -1)
+#endif
+    {
+        lwsl_err("GPS read error.\n");
+        return EXIT_FAILURE;
+    }
+    // Calculate difference between local and GPS time
+    // Done here to avoid any latency caused by LWS
+#if GPSD_API_MAJOR_VERSION < 9
+    ts_gps.tv_sec = (long int)gpsdata.fix.time;
+#else
+    ts_gps = gpsdata.fix.time;
+#endif
+    (void)clock_gettime(CLOCK_REALTIME, &ts_now);
+    TS_SUB(&ts_diff, &ts_now, &ts_gps);
+    update_gps_data();
+    push_track_fix();
+    publish_packet(gps_new_fix() ? BUS_SOURCE_GPS : BUS_SOURCE_STATE);
+    TRACE(snapshot, 1, trace_now_ns());
+    publish_snapshot();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * GPS read thread.
+ * This need its own thread to avoid delays in time update.
+ */
+static void *gps_read_thread(void *arg)
+{
+    NOTUSED(arg);
+    thread_to_core(2);
+
+    if (open_gps() != EXIT_SUCCESS)
+        pthread_exit(NULL);
 
     lwsl_notice("GPS read thread started.");
     while (!gps_thread_exit)
@@ -580,23 +1606,7 @@ static void *gps_read_thread(void *arg)
         {
             if (gps_waiting(&gpsdata, 500000))
             {
-#if GPSD_API_MAJOR_VERSION < 9
-                if (gps_read(&gpsdata) == -1)
-#else
-                if (gps_read(&gpsdata, NULL, 0) == -1)
-#endif
-                {
-                    lwsl_err("GPS read error.\n");
-                }
-                // Calculate difference between local and GPS time
-                // Done here to avoid any latency caused by LWS
-#if GPSD_API_MAJOR_VERSION < 9
-                ts_gps.tv_sec = (long int)gpsdata.fix.time;
-#else
-                ts_gps = gpsdata.fix.time;
-#endif
-                (void)clock_gettime(CLOCK_REALTIME, &ts_now);
-                TS_SUB(&ts_diff, &ts_now, &ts_gps);
+                handle_gps_data();
             }
         }
         pthread_mutex_unlock(&lock_packetdata_update);
@@ -607,6 +1617,51 @@ static void *gps_read_thread(void *arg)
     pthread_exit(NULL);
 }
 
+/**
+ * Process one line read from the MAWS.
+ * Called by the serial read thread or, with --reactor, from the lws loop.
+ */
+static void handle_serial_line(char *buf, ssize_t len)
+{
+    t_maws_sample sample;
+    struct timespec ts_sample;
+    struct timespec ts_wall;
+    double t_sample;
+    unsigned char changed;
+
+    if (len < 0)
+    {
+        lwsl_err("Error from read: %ld: %s\n", len, strerror(errno));
+        return;
+    }
+    TRACE(serial_line, len, trace_now_ns());
+    if (len == 0)
+        return;
+    if (maws_parse_line(buf, &sample) != EXIT_SUCCESS)
+    {
+        TRACE(parse_fail, len, trace_now_ns());
+        return;
+    }
+    TRACE(parse_ok, len, trace_now_ns());
+    clock_gettime(CLOCK_MONOTONIC, &ts_sample);
+    clock_gettime(CLOCK_REALTIME, &ts_wall);
+    t_sample = (double)ts_sample.tv_sec + (double)ts_sample.tv_nsec / 1e9;
+
+    ingest_runway(&ingest, runway_heading, runway_elevation, height_qfe);
+    if (ingest_sample(&ingest, &sample, t_sample, &ts_wall, &changed))
+    {
+        push_compliance_event(ingest.compliance.flags, changed);
+    }
+
+    // Block mutex only minimum time
+    pthread_mutex_trylock(&lock_packetdata_update);
+    ingest_packet(&ingest, &packet_data);
+    bus_publish(BUS_SOURCE_MAWS, &packet_data, t_sample, &ts_wall);
+    pthread_mutex_unlock(&lock_packetdata_update);
+    TRACE(snapshot, 0, trace_now_ns());
+    publish_snapshot();
+}
+
 /**
  * Serial read thread.
  */
@@ -622,131 +1677,11 @@ static void *serial_read_thread(void *arg)
     };
     char *buf;
     ssize_t len = 0;
-    int items = 0;
-    double temperature;
-    double temperature_mean = 0.0;
-    double pressure;
-    double windspeed;
-    double windspeed_mean = 0.0;
-    double qfe;
-    double qnh;
-    unsigned short wind_direction;
-    double wind_direction_mean = 0.0;
-    unsigned char hour;
-    unsigned char min;
-    unsigned char sec;
-    unsigned char humidity;
-    double humidity_mean = 0.0;
-    signed short difference;
-    double cross_wind;
-    double head_wind;
-    double cross_wind_mean = 0.0;
-    double head_wind_mean = 0.0;
-    double wind_comp1;
-    double wind_comp2;
 
     while (!serial_thread_exit)
     {
         buf = read_serial(&len);
-        if (len > 0)
-        {
-            items = sscanf(buf, "%lf\t%hhu\t%lf\t%lf\t%hu\t%hhu\t%hhu\t%hhu", &temperature, &humidity, &pressure, &windspeed, &wind_direction, &hour, &min, &sec);
-            if (items == 8)
-            {
-                difference = wind_direction - runway_heading;
-                cross_wind = windspeed * sin(difference * DEG_2_RAD);
-                head_wind = windspeed * cos(difference * DEG_2_RAD);
-                wind_comp1 = windspeed * sin(wind_direction * DEG_2_RAD);
-                wind_comp2 = windspeed * cos(wind_direction * DEG_2_RAD);
-
-                // Fill arrays before we calculate average
-                if (moving_avg_index < MOVING_AVG_LENGTH)
-                {
-                    temperature_arr[moving_avg_index] = temperature;
-                    humidity_arr[moving_avg_index] = humidity;
-                    windspeed_arr[moving_avg_index] = windspeed;
-                    wind_direction_arr[moving_avg_index] = wind_direction;
-                    cross_wind_arr[moving_avg_index] = cross_wind;
-                    head_wind_arr[moving_avg_index] = head_wind;
-                    wind_comp1_arr[moving_avg_index] = wind_comp1;
-                    wind_comp2_arr[moving_avg_index] = wind_comp2;
-                    moving_avg_index += 1;
-                }
-                else
-                {
-                    // Left shift all arrays
-                    memmove(&temperature_arr[0], &temperature_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    memmove(&humidity_arr[0], &humidity_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(unsigned char));
-                    memmove(&windspeed_arr[0], &windspeed_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    memmove(&wind_direction_arr[0], &wind_direction_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(unsigned short));
-                    memmove(&cross_wind_arr[0], &cross_wind_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    memmove(&head_wind_arr[0], &head_wind_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    memmove(&wind_comp1_arr[0], &wind_comp1_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    memmove(&wind_comp2_arr[0], &wind_comp2_arr[1], (MOVING_AVG_LENGTH - 1) * sizeof(double));
-                    // Add new value at the end
-                    temperature_arr[MOVING_AVG_LENGTH - 1] = temperature;
-                    humidity_arr[MOVING_AVG_LENGTH - 1] = humidity;
-                    windspeed_arr[MOVING_AVG_LENGTH - 1] = windspeed;
-                    wind_direction_arr[MOVING_AVG_LENGTH - 1] = wind_direction;
-                    cross_wind_arr[MOVING_AVG_LENGTH - 1] = cross_wind;
-                    head_wind_arr[MOVING_AVG_LENGTH - 1] = head_wind;
-                    wind_comp1_arr[MOVING_AVG_LENGTH - 1] = wind_comp1;
-                    wind_comp2_arr[MOVING_AVG_LENGTH - 1] = wind_comp2;
-                    // Calculate average
-                    for (int i = 0; i < MOVING_AVG_LENGTH; i++)
-                    {
-                        temperature_mean += temperature_arr[i];
-                        humidity_mean += humidity_arr[i];
-                        windspeed_mean += windspeed_arr[i];
-                        cross_wind_mean += cross_wind_arr[i];
-                        head_wind_mean += head_wind_arr[i];
-                        wind_comp1 += wind_comp1_arr[i];
-                        wind_comp2 += wind_comp2_arr[i];
-                    }
-
-                    temperature_mean /= (double)MOVING_AVG_LENGTH;
-                    humidity_mean /= (double)MOVING_AVG_LENGTH;
-                    windspeed_mean /= (double)MOVING_AVG_LENGTH;
-                    cross_wind_mean /= (double)MOVING_AVG_LENGTH;
-                    head_wind_mean /= (double)MOVING_AVG_LENGTH;
-                    wind_comp1 /= (double)MOVING_AVG_LENGTH;
-                    wind_comp2 /= (double)MOVING_AVG_LENGTH;
-
-                    wind_direction_mean = atan2(wind_comp1, wind_comp2) * RAD_2_DEG;
-                    if (wind_direction_mean < 0.0)
-                    {
-                        wind_direction_mean = 360.0 + wind_direction_mean;
-                    }
-                }
-
-                double elev = runway_elevation * 0.3048;
-                qfe = pressure * (1.0 + ((height_qfe * EARTH_G) / (R * (temperature + 273.15))));
-                qnh = qfe * exp((elev * EARTH_G) / (R * (TREF + (ALPHA * elev) / 2.0)));
-
-                // Block mutex only minimum time
-                pthread_mutex_trylock(&lock_packetdata_update);
-                packet_data.baro_qfe = qfe;
-                packet_data.baro_qnh = qnh;
-                packet_data.temperature = temperature_mean;
-                packet_data.humidity = humidity_mean;
-                packet_data.wind_direction = wind_direction;
-                packet_data.wind_direction_mean = (unsigned short)wind_direction_mean;
-                packet_data.windspeed = windspeed;
-                packet_data.windspeed_mean = windspeed_mean;
-                packet_data.cross_windspeed = (double)cross_wind;
-                packet_data.cross_windspeed_mean = (double)cross_wind_mean;
-                packet_data.head_windspeed = (double)head_wind_mean;
-                packet_data.baro_pressure = pressure;
-                packet_data.maws_hour = hour;
-                packet_data.maws_min = min;
-                packet_data.maws_sec = sec;
-                pthread_mutex_unlock(&lock_packetdata_update);
-            }
-        }
-        else if (len < 0)
-        {
-            lwsl_err("Error from read: %ld: %s\n", len, strerror(errno));
-        }
+        handle_serial_line(buf, len);
     }
 
     close_serial();
@@ -755,72 +1690,126 @@ static void *serial_read_thread(void *arg)
 }
 
 /**
- * Callback function for packet timer.
- * Send packet data periodically to clients.
+ * Callback function for publish timer.
+ * Republishes the last snapshot when no new data arrived for the keepalive interval.
  */
-static void packet_timer_handler(size_t timer_id, void *user_data)
+static void publish_timer_handler(size_t timer_id, void *user_data)
 {
     NOTUSED(timer_id);
     NOTUSED(user_data);
-    // Block gpsdata only a minimum time
-    pthread_mutex_trylock(&lock_packetdata_update);
-    packet_data.gps_status = (unsigned char)gpsdata.status;
-    packet_data.gps_mode = (unsigned char)gpsdata.fix.mode;
-    packet_data.gps_satellites_visible = (unsigned char)gpsdata.satellites_visible;
-    packet_data.gps_satellites_used = (unsigned char)gpsdata.satellites_used;
-    packet_data.gps_hdop = gpsdata.dop.hdop;
-    packet_data.gps_pdop = gpsdata.dop.pdop;
-    packet_data.gps_lat = gpsdata.fix.latitude;
-    packet_data.gps_lon = gpsdata.fix.longitude;
-#if GPSD_API_MAJOR_VERSION < 9
-    packet_data.gps_alt_msl = gpsdata.fix.altitude * METERS_TO_FEET;
-    packet_data.gps_time = gpsdata.fix.time;
-#else
-    packet_data.gps_alt_msl = gpsdata.fix.altMSL * METERS_TO_FEET;
-    packet_data.gps_time = (double)gpsdata.fix.time.tv_sec;
-#endif
-    packet_data.runway_elevation = runway_elevation;
-    packet_data.runway_heading = runway_heading;
-    pthread_mutex_unlock(&lock_packetdata_update);
 
-    lws_callback_on_writable_all_protocol(context, &protocols[1]);
+    TRACE(publish_timer, 0, atomic_load(&publish_pending), trace_now_ns());
+    // A silent serial line leaves the last values in the packet, mark them stale
+    if (qc_stale(&ingest.qc, (double)monotonic_ms() / 1000.0) && !(packet_data.qc_windspeed & QC_STALE))
+    {
+        lwsl_warn("No MAWS data for %.0f s\n", QC_STALE_AGE);
+        pthread_mutex_trylock(&lock_packetdata_update);
+        packet_data.qc_temperature |= QC_STALE;
+        packet_data.qc_humidity |= QC_STALE;
+        packet_data.qc_pressure |= QC_STALE;
+        packet_data.qc_windspeed |= QC_STALE;
+        packet_data.qc_wind_direction |= QC_STALE;
+        publish_packet(BUS_SOURCE_STATE);
+        pthread_mutex_unlock(&lock_packetdata_update);
+        publish_snapshot();
+    }
+    if (atomic_load(&publish_pending) || monotonic_ms() - atomic_load(&last_publish) >= keepalive)
+    {
+        publish_snapshot();
+    }
 }
 
 /**
- * Callback function for record timer.
- * Log data packet into file if record is active.
+ * Callback function for flush timer.
+ * Armed by a publish deferred by the minimum interval.
  */
-static void record_timer_handler(size_t timer_id, void *user_data)
+static void flush_timer_handler(size_t timer_id, void *user_data)
 {
     NOTUSED(timer_id);
     NOTUSED(user_data);
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
 
-    if (record_fp != NULL && packet_data.record_status != 0)
+    TRACE(publish_timer, 1, atomic_load(&publish_pending), trace_now_ns());
+    if (atomic_load(&publish_pending))
+    {
+        publish_snapshot();
+    }
+}
+
+/**
+ * Hand a descriptor to the lws loop, its events arrive in callback_reactor.
+ */
+static int reactor_adopt(int fd)
+{
+    lws_sock_file_fd_type sock;
+
+    sock.filefd = fd;
+    if (lws_adopt_descriptor_vhost(lws_get_vhost_by_name(context, "default"),
+                                   LWS_ADOPT_RAW_FILE_DESC, sock, "reactor", NULL) == NULL)
+    {
+        lwsl_err("Failed to adopt descriptor %d\n", fd);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Log the joined MAWS and GPS samples ready at monotonic time now [s] if record is active.
+ * INFINITY joins the waiting samples with the latest fix. Caller holds lock_record.
+ */
+static void record_drain(double now)
+{
+    t_bus_sample in;
+    t_fusion_sample sample;
+    unsigned long dropped = record_cursor.dropped;
+    unsigned long fusion_dropped = fusion.dropped;
+    struct tm t;
+    char row[RECORD_ROW_SIZE];
+
+    while (bus_read(&record_cursor, &in) == BUS_OK)
+    {
+        if (in.source == BUS_SOURCE_MAWS)
+            fusion_add_maws(&fusion, &in.packet, in.t, &in.wall);
+        else if (in.source == BUS_SOURCE_GPS)
+            fusion_add_gps(&fusion, &in.packet, in.t);
+    }
+    if (record_cursor.dropped != dropped)
+    {
+        lwsl_warn("Recorder fell behind, %lu samples lost\n", record_cursor.dropped - dropped);
+    }
+    if (fusion.dropped != fusion_dropped)
+    {
+        lwsl_warn("GPS join overflowed, %lu samples lost\n", fusion.dropped - fusion_dropped);
+    }
+
+    // One row per joined sample, rows carry the time the MAWS line was read
+    while (fusion_next(&fusion, now, &sample))
     {
+        if (!record_is_open() || packet_data.record_status == 0 || sample.wall.tv_sec < run_summary.start)
+        {
+            continue;
+        }
+        localtime_r(&sample.wall.tv_sec, &t);
+        record_format_row(row, sizeof(row), &sample.packet, &t);
         pthread_mutex_trylock(&lock_packetdata_update);
-        fprintf(record_fp, "%02u:%02u:%02u;%0.1f;%u;%0.1f;%u;%0.1f;%0.1f;%0.1f;%0.1f;%.0f;%02u:%02u:%02u;%u\n",
-                t->tm_hour,
-                t->tm_min,
-                t->tm_sec,
-                packet_data.temperature,
-                packet_data.humidity,
-                packet_data.baro_pressure,
-                packet_data.wind_direction,
-                fabs(packet_data.windspeed),
-                fabs(packet_data.cross_windspeed),
-                fabs(packet_data.windspeed_mean),
-                fabs(packet_data.cross_windspeed_mean),
-                packet_data.gps_time,
-                packet_data.maws_hour,
-                packet_data.maws_min,
-                packet_data.maws_sec,
-                packet_data.top_number);
+        summary_update(&run_summary, &sample.packet);
         pthread_mutex_unlock(&lock_packetdata_update);
+        record_write_row(row);
     }
 }
 
+/**
+ * Callback function for record timer.
+ */
+static void record_timer_handler(size_t timer_id, void *user_data)
+{
+    NOTUSED(timer_id);
+    NOTUSED(user_data);
+
+    pthread_mutex_lock(&lock_record);
+    record_drain((double)monotonic_ms() / 1000.0);
+    pthread_mutex_unlock(&lock_record);
+}
+
 /**
  * Well, it's main.
  */
@@ -887,6 +1876,80 @@ int main(int argc, char **argv)
     info.max_http_header_pool = 16;
     info.timeout_secs = 5;
 
+    // Without GPS there is no fix to wait for
+    fusion_init(&fusion, gps_available ? FUSION_LATENCY : 0.0);
+    record_set_options(&record_options);
+
+    if (http_root != NULL && assets_load(http_root) != EXIT_SUCCESS)
+    {
+        lwsl_warn("Web client not served\n");
+    }
+
+    if (ingest_init(&ingest, &compliance_limits) != EXIT_SUCCESS)
+    {
+        lwsl_err("Rollup init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Restore state of a previous run */
+    if (state_open(state_path) == EXIT_SUCCESS)
+    {
+        t_state_settings settings;
+        if (state_restore_settings(&settings))
+        {
+            runway_heading = settings.runway_heading;
+            runway_elevation = settings.runway_elevation;
+            packet_data.runway_heading = runway_heading;
+            packet_data.runway_elevation = runway_elevation;
+            packet_data.flight_number = settings.flight_number;
+            packet_data.top_number = settings.top_number;
+            packet_data.from_to_status = settings.from_to_status;
+            lwsl_notice("Settings restored from %s\n", state_path);
+        }
+        t_mean_values mean;
+        if (state_restore_average(&ingest.avg))
+        {
+            lwsl_notice("Averaging window restored from %s\n", state_path);
+        }
+        // A restart is no transition, start from the conditions of the restored window
+        if (moving_avg_mean(&ingest.avg, &mean))
+        {
+            ingest.compliance.flags = compliance_evaluate(&ingest.compliance.limits, mean.temperature,
+                                                          mean.humidity, mean.windspeed, mean.cross_wind);
+        }
+        size_t n = state_restore_rollup(&ingest.rollup);
+        if (n > 0)
+        {
+            lwsl_notice("Wind rollups restored from %zu samples of %s\n", n, state_path);
+        }
+    }
+
+    if (archive_path != NULL && archive_open(archive_path) == EXIT_SUCCESS)
+    {
+        lwsl_notice("Archiving to %s\n", archive_path);
+    }
+
+    if (shm_name != NULL && shmring_open(shm_name) == EXIT_SUCCESS)
+    {
+        lwsl_notice("Publishing to shared memory %s\n", shm_name);
+    }
+
+    if (mcast_group[0] != '\0' && mcast_open(mcast_group, mcast_port, mcast_iface) == EXIT_SUCCESS)
+    {
+        // Events before this start are not sent
+        mcast_event_seq = event_seq;
+        lwsl_notice("Sending to multicast group %s:%u\n", mcast_group, mcast_port);
+    }
+
+    /* With systemd socket activation lws does not bind itself,
+     * the inherited socket is adopted after context creation.
+     */
+    listen_fd = systemd_listen_fd();
+    if (listen_fd >= 0)
+    {
+        info.port = CONTEXT_PORT_NO_LISTEN_SERVER;
+    }
+
     /* Create libwebsocket context representing this server */
     context = lws_create_context(&info);
 
@@ -896,20 +1959,67 @@ int main(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    /* Start reading serial data from weather station */
-    pthread_create(&serial_thread, NULL, serial_read_thread, NULL);
+    if (listen_fd >= 0)
+    {
+        lws_sock_file_fd_type sock;
+        sock.filefd = listen_fd;
+        if (lws_adopt_descriptor_vhost(lws_get_vhost_by_name(context, "default"),
+                                       LWS_ADOPT_RAW_FILE_DESC, sock, "listen", NULL) == NULL)
+        {
+            lwsl_err("Failed to adopt inherited listening socket\n");
+            return EXIT_FAILURE;
+        }
+        lwsl_notice("Using listening socket from systemd\n");
+    }
 
     /* Initialize GPS data so we read back zero if no GPS is available */
     memset(&gpsdata, 0, sizeof(gpsdata));
-    if (gps_available)
+
+    // Sinks read the bus through their own cursors, the first sample is the initial state
+    bus_subscribe(&ws_cursor, BUS_LATEST);
+    bus_subscribe(&record_cursor, BUS_OLDEST);
+    publish_packet(BUS_SOURCE_STATE);
+
+    // Publishing is driven by new data, the timers only flush deferred publishes and send keepalives
+    publish_timer = start_timer(keepalive, publish_timer_handler, TIMER_PERIODIC, NULL);
+    flush_timer = start_timer(0, flush_timer_handler, TIMER_SINGLE_SHOT, NULL);
+    record_timer = start_timer(1000, record_timer_handler, TIMER_PERIODIC, NULL);
+    sync_timer = start_timer(0, sync_timer_handler, TIMER_SINGLE_SHOT, NULL);
+
+    if (reactor)
     {
-        /* Start reading GPS data */
-        pthread_create(&gps_thread, NULL, gps_read_thread, NULL);
+        /* Serial, gpsd and timer descriptors are served by the lws loop */
+        if (open_serial() == EXIT_FAILURE || reactor_adopt(get_serial_fd()) != EXIT_SUCCESS)
+        {
+            lwsl_err("Serial device init failed\n");
+            sighandler(0);
+        }
+        if (gps_available && (open_gps() != EXIT_SUCCESS || reactor_adopt(gpsdata.gps_fd) != EXIT_SUCCESS))
+        {
+            gps_available = false;
+        }
+        if (reactor_adopt(timer_fd(publish_timer)) != EXIT_SUCCESS ||
+            reactor_adopt(timer_fd(flush_timer)) != EXIT_SUCCESS ||
+            reactor_adopt(timer_fd(record_timer)) != EXIT_SUCCESS ||
+            reactor_adopt(timer_fd(sync_timer)) != EXIT_SUCCESS)
+        {
+            sighandler(0);
+        }
+        lwsl_notice("Running single threaded reactor\n");
     }
+    else
+    {
+        /* Start reading serial data from weather station */
+        pthread_create(&serial_thread, NULL, serial_read_thread, NULL);
 
-    initialize_timer();
-    packet_timer = start_timer(500, packet_timer_handler, TIMER_PERIODIC, NULL);
-    record_timer = start_timer(1000, record_timer_handler, TIMER_PERIODIC, NULL);
+        if (gps_available)
+        {
+            /* Start reading GPS data */
+            pthread_create(&gps_thread, NULL, gps_read_thread, NULL);
+        }
+
+        initialize_timer();
+    }
 
     // Check if serial thread is running.
     // Exit if not, e.g. serial interface not open.
@@ -921,12 +2031,14 @@ int main(int argc, char **argv)
     // Infinite loop, to end this server send SIGTERM. (CTRL+C) */
     for (;;)
     {
-        lws_service(context, 100);
+        lws_service(context, reactor ? REACTOR_SERVICE_TIMEOUT : 100);
         /* libwebsocket_service will process all waiting events with
          * their callback functions and then wait 100 ms.
          * (This is a single threaded web server and this will keep our
          * server from generating load while there are not
          * requests to process)
+         * In reactor mode all sources wake the loop, the timeout only
+         * bounds the wait for older lws versions.
          */
     }
 
@@ -18,6 +18,9 @@
 #ifndef METEOSERVER_H
 #define METEOSERVER_H
 
+#include <stddef.h>
+#include "schema.h"
+
 #define SERVER_CMD_START 0x1a
 #define SERVER_CMD_STOP 0x2b
 #define SERVER_CMD_FROMTO 0x3c
@@ -25,43 +28,28 @@
 #define SERVER_CMD_HEADING 0x5e
 #define SERVER_CMD_SYNC_TIME 0x6f
 
-typedef struct __attribute__((__packed__))
+#define SERVER_EVT_COMPLIANCE 0x81
+#define SERVER_EVT_SUMMARY 0x82
+
+#define PACKET_STRUCT_F(type, name, js_name, js_type) type name;
+#define PACKET_STRUCT_A(type, name, count, js_name, fields) type name[count];
+#define PACKET_SIZE_F(type, name, js_name, js_type) +sizeof(type)
+#define PACKET_SIZE_A(type, name, count, js_name, fields) +sizeof(type) * (count)
+#define PACKET_FIELDS_SIZE (0 PACKET_FIELDS(PACKET_SIZE_F, PACKET_SIZE_A)) // End of last field
+
+/**
+ * Packet sent to clients, generated from PACKET_FIELDS in schema.h.
+ * Naturally aligned, the wire format is the struct in little endian.
+ */
+typedef struct
 {
-    double gps_hdop;
-    double gps_pdop;
-    double gps_lat;
-    double gps_lon;
-    double gps_alt_msl;
-    double temperature;
-    double baro_pressure;
-    double windspeed;
-    double windspeed_mean;
-    double cross_windspeed;
-    double cross_windspeed_mean;
-    double head_windspeed;
-    double baro_qfe;
-    double baro_qnh;
-    double gps_time;
-    double local_time;
-    unsigned short flight_number;
-    unsigned short runway_heading;
-    unsigned short runway_elevation;
-    unsigned short wind_direction;
-    unsigned short wind_direction_mean;
-    unsigned char barometer_height;
-    unsigned char maws_hour;
-    unsigned char maws_min;
-    unsigned char maws_sec;
-    unsigned char humidity;
-    unsigned char top_number;
-    unsigned char gps_status;
-    unsigned char gps_mode;
-    unsigned char gps_satellites_visible;
-    unsigned char gps_satellites_used;
-    unsigned char record_status;
-    unsigned char from_to_status;
+    PACKET_FIELDS(PACKET_STRUCT_F, PACKET_STRUCT_A)
 } t_packet_data;
 
+// Fields are sorted by alignment, only tail padding is allowed
+_Static_assert(sizeof(t_packet_data) == ((PACKET_FIELDS_SIZE + 7) & ~(size_t)7),
+               "Packet fields out of alignment order");
+
 typedef struct __attribute__((__packed__))
 {
     unsigned char id;
@@ -75,4 +63,15 @@ typedef struct __attribute__((__packed__))
     unsigned short val;
 } t_ushort_cmd;
 
+/**
+ * Pushed to clients when compliance flags change.
+ */
+typedef struct __attribute__((__packed__))
+{
+    unsigned char id;
+    unsigned char compliance; // Flags after the transition
+    unsigned char changed;    // Toggled flags
+    double local_time;
+} t_compliance_event;
+
 #endif /* METEOSERVER_H */
\ No newline at end of file
@@ -0,0 +1,76 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
+#include "packet.h"
+
+static inline void put_Float64(unsigned char *b, double v)
+{
+    uint64_t u;
+
+    memcpy(&u, &v, sizeof(u));
+    u = htole64(u);
+    memcpy(b, &u, sizeof(u));
+}
+
+static inline void put_Uint32(unsigned char *b, unsigned int v)
+{
+    uint32_t u = htole32(v);
+
+    memcpy(b, &u, sizeof(u));
+}
+
+static inline void put_Uint16(unsigned char *b, unsigned short v)
+{
+    uint16_t u = htole16(v);
+
+    memcpy(b, &u, sizeof(u));
+}
+
+static inline void put_Uint8(unsigned char *b, unsigned char v)
+{
+    *b = v;
+}
+
+// Every field is stored at its struct offset, offsets are compile time constants
+#define PACKET_ENCODE_F(type, name, js_name, js_type) put_##js_type(&buf[offsetof(t_packet_data, name)], p->name);
+#define PACKET_ENCODE_SUB_F(type, name, js_name, js_type) \
+    put_##js_type(&b[(const unsigned char *)&e->name - (const unsigned char *)e], e->name);
+#define PACKET_ENCODE_A(type, name, count, js_name, fields)                    \
+    for (size_t i = 0; i < (count); i++)                                       \
+    {                                                                          \
+        const type *e = &p->name[i];                                           \
+        unsigned char *b = &buf[offsetof(t_packet_data, name) + i * sizeof(type)]; \
+        fields(PACKET_ENCODE_SUB_F)                                            \
+    }
+
+/**
+ * Encode packet data into websocket frame payload, little endian in struct layout.
+ * Returns the payload length or 0 if buf is too small.
+ */
+size_t packet_encode(unsigned char *buf, size_t size, const t_packet_data *p)
+{
+    if (size < PACKET_SIZE)
+        return 0;
+
+    PACKET_FIELDS(PACKET_ENCODE_F, PACKET_ENCODE_A)
+    // Tail padding
+    memset(&buf[PACKET_FIELDS_SIZE], 0, PACKET_SIZE - PACKET_FIELDS_SIZE);
+    return PACKET_SIZE;
+}
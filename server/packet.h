@@ -0,0 +1,28 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stddef.h>
+#include "meteoserver.h"
+
+#define PACKET_SIZE sizeof(t_packet_data) // Encoded size [Byte]
+
+size_t packet_encode(unsigned char *buf, size_t size, const t_packet_data *p);
+
+#endif /* PACKET_H */
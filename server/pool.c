@@ -0,0 +1,267 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Work-stealing thread pool.
+// Every worker owns a deque of tasks. A worker takes new work from the tail
+// of its own deque and steals from the head of the other deques once its own
+// is empty, so long and short tasks even out across the workers.
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include "pool.h"
+
+typedef struct
+{
+    pool_task task;
+    void *arg;
+} t_pool_item;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    t_pool_item *items;
+    size_t head;
+    size_t tail;
+    size_t size;
+} t_pool_deque;
+
+typedef struct
+{
+    t_pool *pool;
+    pthread_t thread;
+    int id;
+} t_pool_worker;
+
+struct t_pool
+{
+    int num_workers;
+    t_pool_worker *workers;
+    t_pool_deque *deques;
+    unsigned int next; // Round robin submit index
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    size_t queued;  // Tasks waiting in any deque
+    size_t pending; // Tasks queued or running
+    bool shutdown;
+};
+
+static int deque_push(t_pool_deque *d, pool_task task, void *arg)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->size)
+    {
+        // Compact or grow
+        if (d->head > 0)
+        {
+            for (size_t i = d->head; i < d->tail; i++)
+                d->items[i - d->head] = d->items[i];
+            d->tail -= d->head;
+            d->head = 0;
+        }
+        else
+        {
+            size_t size = d->size ? d->size * 2 : 64;
+            t_pool_item *items = realloc(d->items, size * sizeof(t_pool_item));
+            if (items == NULL)
+            {
+                pthread_mutex_unlock(&d->lock);
+                return EXIT_FAILURE;
+            }
+            d->items = items;
+            d->size = size;
+        }
+    }
+    d->items[d->tail].task = task;
+    d->items[d->tail].arg = arg;
+    d->tail++;
+    pthread_mutex_unlock(&d->lock);
+    return EXIT_SUCCESS;
+}
+
+static bool deque_pop_tail(t_pool_deque *d, t_pool_item *item)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head)
+    {
+        *item = d->items[--d->tail];
+        found = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static bool deque_steal_head(t_pool_deque *d, t_pool_item *item)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head)
+    {
+        *item = d->items[d->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+static bool find_work(t_pool *pool, int id, t_pool_item *item)
+{
+    if (deque_pop_tail(&pool->deques[id], item))
+        return true;
+
+    for (int i = 1; i < pool->num_workers; i++)
+    {
+        if (deque_steal_head(&pool->deques[(id + i) % pool->num_workers], item))
+            return true;
+    }
+    return false;
+}
+
+static void *worker_thread(void *arg)
+{
+    t_pool_worker *w = (t_pool_worker *)arg;
+    t_pool *pool = w->pool;
+    t_pool_item item;
+
+    for (;;)
+    {
+        if (find_work(pool, w->id, &item))
+        {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+
+            item.task(item.arg);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+                pthread_cond_broadcast(&pool->done_cond);
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->queued == 0 && pool->shutdown)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+t_pool *pool_create(int num_workers)
+{
+    t_pool *pool = calloc(1, sizeof(t_pool));
+
+    if (pool == NULL)
+        return NULL;
+    if (num_workers < 1)
+        num_workers = 1;
+
+    pool->num_workers = num_workers;
+    pool->workers = calloc((size_t)num_workers, sizeof(t_pool_worker));
+    pool->deques = calloc((size_t)num_workers, sizeof(t_pool_deque));
+    if (pool->workers == NULL || pool->deques == NULL)
+    {
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 0; i < num_workers; i++)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        pthread_create(&pool->workers[i].thread, NULL, worker_thread, &pool->workers[i]);
+    }
+
+    return pool;
+}
+
+/**
+ * Queue a task, tasks are distributed round robin over the workers.
+ */
+int pool_submit(t_pool *pool, pool_task task, void *arg)
+{
+    unsigned int id;
+
+    pthread_mutex_lock(&pool->lock);
+    id = pool->next++ % (unsigned int)pool->num_workers;
+    pool->queued++;
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (deque_push(&pool->deques[id], task, arg) != EXIT_SUCCESS)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pool->pending--;
+        pthread_mutex_unlock(&pool->lock);
+        return EXIT_FAILURE;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Wait until all submitted tasks are done.
+ */
+void pool_wait(t_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(t_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_workers; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+}
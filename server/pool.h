@@ -0,0 +1,29 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef POOL_H
+#define POOL_H
+
+typedef void (*pool_task)(void *arg);
+typedef struct t_pool t_pool;
+
+t_pool *pool_create(int num_workers);
+int pool_submit(t_pool *pool, pool_task task, void *arg);
+void pool_wait(t_pool *pool);
+void pool_destroy(t_pool *pool);
+
+#endif /* POOL_H */
@@ -0,0 +1,106 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "qc.h"
+
+void qc_init(t_qc *qc)
+{
+    memset(qc, 0, sizeof(*qc));
+    // Stale until the first sample
+    atomic_init(&qc->last_update_ms, 0);
+}
+
+/**
+ * Monotonic time t [s] as wrapping millisecond counter.
+ */
+static uint32_t to_ms(double t)
+{
+    return (uint32_t)(uint64_t)(t * 1000.0);
+}
+
+/**
+ * Check one value, returns its flags.
+ */
+static unsigned char check(t_qc_field *f, double v, double t, double min, double max, double max_rate,
+                           unsigned int flat_samples, bool count_flat)
+{
+    unsigned char flags = 0;
+
+    if (v < min || v > max)
+        flags |= QC_RANGE;
+    if (f->started)
+    {
+        if (max_rate > 0.0 && !(flags & QC_RANGE))
+        {
+            double dt = fmax(t - f->ref_time, QC_MIN_INTERVAL);
+            if (fabs(v - f->ref) > max_rate * dt && ++f->spike_run < QC_SPIKE_PERSIST)
+                flags |= QC_SPIKE;
+        }
+        if (flat_samples > 0 && count_flat && v == f->last)
+        {
+            if (f->flat < UINT_MAX)
+                f->flat++;
+        }
+        else
+        {
+            f->flat = 0;
+        }
+        if (flat_samples > 0 && f->flat >= flat_samples)
+            flags |= QC_STUCK;
+    }
+    f->last = v;
+    if (!(flags & (QC_RANGE | QC_SPIKE)))
+    {
+        f->ref = v;
+        f->ref_time = t;
+        f->spike_run = 0;
+        f->started = true;
+    }
+    f->flags = flags;
+    return flags;
+}
+
+/**
+ * Check a sample taken at monotonic time t [s].
+ * Returns the flags of all fields combined, per field flags are in qc.
+ */
+unsigned char qc_sample(t_qc *qc, const t_maws_sample *s, double t)
+{
+    bool wind = s->windspeed >= QC_CALM_WIND;
+    unsigned char flags = 0;
+
+#define QC_CHECK_Q(name, min, max, rate, flat, gated) \
+    flags |= check(&qc->name, (double)s->name, t, min, max, rate, flat, !(gated) || wind);
+    QC_FIELDS(QC_CHECK_Q)
+    uint32_t ms = to_ms(t);
+    // 0 is reserved for no sample yet
+    atomic_store_explicit(&qc->last_update_ms, ms != 0 ? ms : 1, memory_order_relaxed);
+    return flags;
+}
+
+/**
+ * True when the last sample is older than QC_STALE_AGE at monotonic time t [s].
+ */
+bool qc_stale(const t_qc *qc, double t)
+{
+    uint32_t last = atomic_load_explicit(&qc->last_update_ms, memory_order_relaxed);
+    // Unsigned difference is correct across the wrap
+    return last == 0 || to_ms(t) - last > (uint32_t)(QC_STALE_AGE * 1000.0);
+}
@@ -0,0 +1,80 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Quality control of MAWS samples.
+//
+// Every sample is checked field by field in constant time: range, rate of
+// change against the last accepted value, and a flat line over a number of
+// identical samples. A sample failing range or rate is not accepted as the
+// new reference, unless the step persists for QC_SPIKE_PERSIST samples. The
+// age of the last sample is checked by the publish timer, so a silent serial
+// line is flagged even though no sample arrives. The timer runs on its own
+// thread, the time of the last sample is kept as an atomic 32 bit millisecond
+// counter so the read cannot tear on 32 bit targets.
+
+#ifndef QC_H
+#define QC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "maws.h"
+
+// Per field quality flags, in the packet and the recordings
+#define QC_RANGE 0x01 // Outside physical range
+#define QC_SPIKE 0x02 // Rate of change above limit
+#define QC_STUCK 0x04 // Flat line, sensor frozen
+#define QC_STALE 0x08 // No sample for QC_STALE_AGE
+
+#define QC_STALE_AGE 5.0     // [s]
+#define QC_SPIKE_PERSIST 3   // Samples after which a step is accepted as real
+#define QC_MIN_INTERVAL 0.25 // Shortest interval for rate checks, MAWS outputs at most 4 Hz [s]
+#define QC_CALM_WIND 0.5     // Wind below this stops flat line counting of gated fields [kt]
+
+// Checked fields of t_maws_sample,
+// Q(name, min, max, max_rate per second or 0, flat samples or 0, flat line only with wind)
+#define QC_FIELDS(Q)                                   \
+    Q(temperature, -50.0, 60.0, 1.0, 600, false)       \
+    Q(humidity, 1.0, 100.0, 10.0, 0, false)            \
+    Q(pressure, 500.0, 1100.0, 0.5, 1800, false)       \
+    Q(windspeed, 0.0, 150.0, 20.0, 120, true)          \
+    Q(wind_direction, 0.0, 360.0, 0.0, 120, true)
+
+typedef struct
+{
+    double ref;      // Last accepted value
+    double ref_time; // [s]
+    double last;     // Previous sample
+    unsigned int spike_run;
+    unsigned int flat; // Identical samples in a row
+    bool started;
+    unsigned char flags;
+} t_qc_field;
+
+#define QC_MEMBER_Q(name, min, max, rate, flat, gated) t_qc_field name;
+
+typedef struct
+{
+    QC_FIELDS(QC_MEMBER_Q)
+    _Atomic uint32_t last_update_ms; // Monotonic time of last sample, wraps, 0 before the first [ms]
+} t_qc;
+
+void qc_init(t_qc *qc);
+unsigned char qc_sample(t_qc *qc, const t_maws_sample *s, double t);
+bool qc_stale(const t_qc *qc, double t);
+
+#endif /* QC_H */
@@ -0,0 +1,308 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "record.h"
+#include "compliance.h"
+#include "trace.h"
+
+// Recording files are either plain CSV or a sequence of gzip members, one per
+// frame of rows. Every member is a complete gzip stream, so zcat reads the
+// whole file and any frame can be decoded alone. The index file next to the
+// recording lists offset, length, row count and first LOG_TIME of each frame.
+
+static pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+static t_record_options record_options = {0, 0, 0};
+static FILE *record_fp = NULL;
+static FILE *index_fp = NULL;
+static unsigned short record_flight_number;
+static unsigned char record_top_number;
+static time_t record_start;
+static unsigned long record_offset;  // End of current file [Byte]
+static unsigned long record_written; // Bytes written since open, for rotation
+
+// Pending frame
+static z_stream zs;
+static char frame[RECORD_FRAME_SIZE];
+static size_t frame_len = 0;
+static unsigned int frame_rows = 0;
+static char frame_time[16];
+
+/**
+ * Set compression and rotation, applies from next opened file.
+ */
+void record_set_options(const t_record_options *options)
+{
+    pthread_mutex_lock(&record_lock);
+    record_options = *options;
+    if (record_options.compress_level > 9)
+        record_options.compress_level = 9;
+    pthread_mutex_unlock(&record_lock);
+}
+
+/**
+ * Compress pending frame into one gzip member and add it to the index.
+ */
+static void flush_frame(void)
+{
+    unsigned char out[16384];
+    unsigned long offset = record_offset;
+    int ret;
+
+    if (frame_len == 0)
+        return;
+
+    deflateReset(&zs);
+    zs.next_in = (Bytef *)frame;
+    zs.avail_in = (uInt)frame_len;
+    do
+    {
+        zs.next_out = out;
+        zs.avail_out = sizeof(out);
+        ret = deflate(&zs, Z_FINISH);
+        fwrite(out, 1, sizeof(out) - zs.avail_out, record_fp);
+    } while (ret == Z_OK);
+    record_offset += zs.total_out;
+    record_written += zs.total_out;
+
+    fprintf(index_fp, "%lu;%lu;%u;%s\n", offset, (unsigned long)zs.total_out, frame_rows, frame_time);
+    fflush(record_fp);
+    fflush(index_fp);
+    frame_len = 0;
+    frame_rows = 0;
+    frame_time[0] = '\0';
+}
+
+/**
+ * Append text to the recording, buffered in the frame when compressing.
+ */
+static void put_text(const char *text, size_t len)
+{
+    if (record_options.compress_level == 0)
+    {
+        fwrite(text, 1, len, record_fp);
+        record_offset += len;
+        record_written += len;
+        return;
+    }
+    if (frame_len + len > sizeof(frame))
+        flush_frame();
+    memcpy(&frame[frame_len], text, len);
+    frame_len += len;
+}
+
+/**
+ * Path of a run file named by flight and top number, kind and time of day,
+ * in the folder of the date of t. The folder is created if missing.
+ */
+int record_file_path(char *buf, size_t size, unsigned short flight_number, unsigned char top_number,
+                     const char *kind, time_t t, const char *suffix)
+{
+    struct stat st = {0};
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    // Create subfolder by date if not exists
+    snprintf(buf, size, RECORD_PATH "/%02u%02u%04u", tm.tm_mday, tm.tm_mon + 1, 1900 + tm.tm_year);
+    if (stat(buf, &st) == -1)
+    {
+        mkdir(buf, 0755);
+    }
+    // Create file by flight and top number
+    return snprintf(buf, size, RECORD_PATH "/%02u%02u%04u/F%04u_REC%03u_%s_%02u%02u%02u%s",
+                    tm.tm_mday,
+                    tm.tm_mon + 1,
+                    1900 + tm.tm_year,
+                    flight_number,
+                    top_number,
+                    kind,
+                    tm.tm_hour,
+                    tm.tm_min,
+                    tm.tm_sec,
+                    suffix) < (int)size
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+}
+
+/**
+ * Create a new recording file for time t, named by flight and top number.
+ * A rotation or restart within the same second gets the next free name
+ * with a _1, _2, ... suffix, an existing recording is never appended to.
+ */
+static FILE *create_file(char *path, size_t size, time_t t, const char *extension)
+{
+    char suffix[16];
+    FILE *fp;
+    unsigned int n;
+
+    for (n = 0; n < RECORD_NAME_TRIES; n++)
+    {
+        if (n == 0)
+            snprintf(suffix, sizeof(suffix), "%s", extension);
+        else
+            snprintf(suffix, sizeof(suffix), "_%u%s", n, extension);
+        if (record_file_path(path, size, record_flight_number, record_top_number, RECORD_KIND, t, suffix) !=
+            EXIT_SUCCESS)
+            return NULL;
+        fp = fopen(path, "wx");
+        if (fp != NULL || errno != EEXIST)
+            return fp;
+    }
+    return NULL;
+}
+
+/**
+ * Open recording file for current time, named by flight and top number.
+ */
+static int open_file(void)
+{
+    char path[FILENAME_MAX];
+    char index_path[FILENAME_MAX + sizeof(RECORD_INDEX_SUFFIX)];
+    time_t now = time(NULL);
+    bool compress = record_options.compress_level > 0;
+
+    record_fp = create_file(path, sizeof(path), now, compress ? ".csv.gz" : ".csv");
+    if (record_fp == NULL)
+        return EXIT_FAILURE;
+    record_offset = 0;
+    record_written = 0;
+    record_start = now;
+
+    if (compress)
+    {
+        snprintf(index_path, sizeof(index_path), "%s" RECORD_INDEX_SUFFIX, path);
+        index_fp = fopen(index_path, "w");
+        if (index_fp == NULL ||
+            deflateInit2(&zs, record_options.compress_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            if (index_fp != NULL)
+                fclose(index_fp);
+            index_fp = NULL;
+            fclose(record_fp);
+            record_fp = NULL;
+            return EXIT_FAILURE;
+        }
+        fputs(RECORD_INDEX_HEADER "\n", index_fp);
+        frame_len = 0;
+        frame_rows = 0;
+        frame_time[0] = '\0';
+    }
+
+    // Add file header, every rotated file is a complete recording
+    put_text(RECORD_CSV_HEADER "\n", sizeof(RECORD_CSV_HEADER "\n") - 1);
+    put_text(RECORD_CSV_UNITS "\n", sizeof(RECORD_CSV_UNITS "\n") - 1);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Flush pending frame and close current file.
+ */
+static void close_file(void)
+{
+    if (record_fp == NULL)
+        return;
+    if (index_fp != NULL)
+    {
+        flush_frame();
+        deflateEnd(&zs);
+        fclose(index_fp);
+        index_fp = NULL;
+    }
+    fclose(record_fp);
+    record_fp = NULL;
+}
+
+/**
+ * Open a new recording file named by flight and top number.
+ */
+int record_open(unsigned short flight_number, unsigned char top_number)
+{
+    int ret;
+
+    pthread_mutex_lock(&record_lock);
+    close_file();
+    record_flight_number = flight_number;
+    record_top_number = top_number;
+    ret = open_file();
+    pthread_mutex_unlock(&record_lock);
+    return ret;
+}
+
+/**
+ * Close current recording file.
+ */
+void record_close(void)
+{
+    pthread_mutex_lock(&record_lock);
+    close_file();
+    pthread_mutex_unlock(&record_lock);
+}
+
+bool record_is_open(void)
+{
+    return record_fp != NULL;
+}
+
+/**
+ * Format one CSV row of packet data.
+ * Returns the row length as snprintf does.
+ */
+int record_format_row(char *buf, size_t size, const t_packet_data *p, const struct tm *t)
+{
+    return snprintf(buf, size, "%02u:%02u:%02u" RECORD_COLUMNS(RECORD_FORMAT_X) "\n",
+                    t->tm_hour, t->tm_min, t->tm_sec RECORD_COLUMNS(RECORD_ARG_X));
+}
+
+/**
+ * Append a formatted row to the recording file.
+ * Rotates to a new file once the size or duration limit is reached.
+ */
+void record_write_row(const char *row)
+{
+    size_t len = strlen(row);
+
+    pthread_mutex_lock(&record_lock);
+    if (record_fp == NULL)
+    {
+        pthread_mutex_unlock(&record_lock);
+        return;
+    }
+    if (record_options.compress_level > 0 && frame_rows == 0)
+        snprintf(frame_time, sizeof(frame_time), "%.8s", row);
+    put_text(row, len);
+    frame_rows++;
+    TRACE(record_row, len, record_offset, trace_now_ns());
+    if (record_options.compress_level > 0 && frame_rows >= RECORD_FRAME_ROWS)
+        flush_frame();
+
+    if ((record_options.max_size > 0 && record_written >= record_options.max_size) ||
+        (record_options.max_duration > 0 && time(NULL) - record_start >= (time_t)record_options.max_duration))
+    {
+        close_file();
+        if (open_file() != EXIT_SUCCESS)
+            fprintf(stderr, "Failed to rotate recording file\n");
+    }
+    pthread_mutex_unlock(&record_lock);
+}
@@ -0,0 +1,55 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>
+#include <time.h>
+#include "meteoserver.h"
+
+#define RECORD_PATH "/var/meteodata"
+#define RECORD_KIND "MeteoData" /* File name part of the recordings */
+#define RECORD_ROW_SIZE 1024 /* Byte */
+#define RECORD_FRAME_ROWS 60      /* Rows per compressed frame */
+#define RECORD_FRAME_SIZE 65536   /* Uncompressed frame buffer [Byte] */
+#define RECORD_COMPRESS_LEVEL 6   /* Default gzip level */
+#define RECORD_INDEX_SUFFIX ".idx"
+#define RECORD_NAME_TRIES 100     /* Numbered names tried when the time of day is taken */
+#define RECORD_INDEX_HEADER "OFFSET;LENGTH;ROWS;FIRST_TIME"
+// Columns are defined by RECORD_COLUMNS in schema.h
+#define RECORD_CSV_HEADER "LOG_TIME" RECORD_COLUMNS(RECORD_HEADER_X)
+#define RECORD_CSV_UNITS "HH:MM:SS" RECORD_COLUMNS(RECORD_UNIT_X)
+#define RECORD_NUM_COLUMNS (1 RECORD_COLUMNS(RECORD_COUNT_X)) /* LOG_TIME and the schema columns */
+
+typedef struct
+{
+    int compress_level;        // 0 plain CSV, 1 to 9 gzip frames with index
+    unsigned long max_size;    // Rotate after this many bytes written [Byte], 0 never
+    unsigned int max_duration; // Rotate after this time [s], 0 never
+} t_record_options;
+
+void record_set_options(const t_record_options *options);
+int record_file_path(char *buf, size_t size, unsigned short flight_number, unsigned char top_number,
+                     const char *kind, time_t t, const char *suffix);
+int record_open(unsigned short flight_number, unsigned char top_number);
+void record_close(void);
+bool record_is_open(void);
+int record_format_row(char *buf, size_t size, const t_packet_data *p, const struct tm *t);
+void record_write_row(const char *row);
+
+#endif /* RECORD_H */
@@ -0,0 +1,178 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Extract a time range from a compressed recording.
+// Reads the frame index next to a .csv.gz recording and decodes only the
+// frames that overlap the requested range, without inflating the whole file.
+// Prints the recording header followed by the matching rows.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <zlib.h>
+#include "record.h"
+
+typedef struct
+{
+    long offset;
+    unsigned long length;
+    unsigned int rows;
+    char first_time[16];
+} t_frame;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] recording.csv.gz\n"
+            "  -f HH:MM:SS  First row time [default: start]\n"
+            "  -t HH:MM:SS  Last row time [default: end]\n",
+            name);
+}
+
+/**
+ * Decode one gzip member of the recording into buf.
+ * Returns the decoded length or -1 on error.
+ */
+static long read_frame(FILE *fp, const t_frame *f, char *buf, size_t size)
+{
+    unsigned char *in = malloc(f->length);
+    z_stream zs = {0};
+    long len = -1;
+
+    if (in == NULL)
+        return -1;
+    if (fseek(fp, f->offset, SEEK_SET) == 0 && fread(in, 1, f->length, fp) == f->length &&
+        inflateInit2(&zs, 15 + 16) == Z_OK)
+    {
+        zs.next_in = in;
+        zs.avail_in = (uInt)f->length;
+        zs.next_out = (Bytef *)buf;
+        zs.avail_out = (uInt)size;
+        if (inflate(&zs, Z_FINISH) == Z_STREAM_END)
+            len = (long)zs.total_out;
+        inflateEnd(&zs);
+    }
+    free(in);
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    const char *from = "00:00:00", *to = "99:99:99";
+    char path[PATH_MAX + sizeof(RECORD_INDEX_SUFFIX)];
+    char line[128];
+    static char buf[RECORD_FRAME_SIZE + 1];
+    t_frame *frames = NULL;
+    size_t num_frames = 0, max_frames = 0, i;
+    bool header = true;
+    FILE *fp, *index;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:t:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            from = optarg;
+            break;
+        case 't':
+            to = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    snprintf(path, sizeof(path), "%s" RECORD_INDEX_SUFFIX, argv[optind]);
+    index = fopen(path, "r");
+    if (index == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    while (fgets(line, sizeof(line), index) != NULL)
+    {
+        t_frame f = {0};
+        if (sscanf(line, "%ld;%lu;%u;%15[0-9:]", &f.offset, &f.length, &f.rows, f.first_time) < 3)
+            continue; // Index header
+        if (num_frames == max_frames)
+        {
+            size_t n = max_frames ? max_frames * 2 : 256;
+            t_frame *p = realloc(frames, n * sizeof(t_frame));
+            if (p == NULL)
+                break;
+            frames = p;
+            max_frames = n;
+        }
+        frames[num_frames++] = f;
+    }
+    fclose(index);
+
+    fp = fopen(argv[optind], "rb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", argv[optind], strerror(errno));
+        free(frames);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < num_frames; i++)
+    {
+        // Frames ending before the range and frames starting after it are skipped, the first frame holds the header.
+        // A frame is only before the range when the next one starts before it, rows at exactly from may end it
+        bool before = i + 1 < num_frames && frames[i + 1].first_time[0] != '\0' &&
+                      strcmp(frames[i + 1].first_time, from) < 0;
+        bool after = frames[i].first_time[0] != '\0' && strcmp(frames[i].first_time, to) > 0;
+        if ((before || after) && !(header && i == 0))
+            continue;
+
+        long len = read_frame(fp, &frames[i], buf, RECORD_FRAME_SIZE);
+        if (len < 0)
+        {
+            fprintf(stderr, "Broken frame at offset %ld\n", frames[i].offset);
+            continue;
+        }
+        buf[len] = '\0';
+        for (char *row = buf, *end; *row != '\0'; row = end)
+        {
+            end = strchr(row, '\n');
+            end = end != NULL ? end + 1 : row + strlen(row);
+            if (strncmp(row, "LOG_TIME", 8) == 0 || strncmp(row, "HH:MM:SS", 8) == 0)
+            {
+                if (header)
+                    fwrite(row, 1, (size_t)(end - row), stdout);
+            }
+            else if (strncmp(row, from, 8) >= 0 && strncmp(row, to, 8) <= 0)
+            {
+                fwrite(row, 1, (size_t)(end - row), stdout);
+            }
+        }
+        header = false;
+    }
+    fclose(fp);
+    free(frames);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,566 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Offline reprocessing of recordings with corrected runway parameters.
+// Recomputes cross-wind, head-wind, QFE and QNH of recorded CSV files, plain or
+// gzip compressed, single files or whole /var/meteodata day folders, in parallel on a work-stealing
+// thread pool. Rows are streamed in blocks through the derived quantities
+// batch kernel, memory use does not depend on the file size. Columns are
+// found by their header name, the cross-wind and compliance columns are
+// rewritten and all other recorded columns are copied through unchanged.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <zlib.h>
+#include "maws.h"
+#include "derived.h"
+#include "average.h"
+#include "record.h"
+#include "compliance.h"
+#include "pool.h"
+
+#define REPROCESS_SUFFIX "_reprocessed.csv"
+#define LINE_SIZE (sizeof(RECORD_CSV_HEADER) + RECORD_ROW_SIZE) /* Longer than header and rows [Byte] */
+#define MAX_COLUMNS (RECORD_NUM_COLUMNS + 16) /* Room for columns added by newer recordings */
+
+typedef struct
+{
+    char in[PATH_MAX];
+    char out[PATH_MAX];
+    unsigned long rows;
+    unsigned long skipped;
+    int status;
+} t_job;
+
+// Recorded columns read or rewritten, found by their header name.
+// The other columns are copied through unchanged.
+#define REPROCESS_COLUMNS(X) \
+    X(TEMP, true)            \
+    X(HUM, true)             \
+    X(PRESSURE, true)        \
+    X(DIRECTION, true)       \
+    X(WIND_TOTAL, true)      \
+    X(WIND_LAT, true)        \
+    X(MEAN_WIND_TOTAL, true) \
+    X(MEAN_WIND_LAT, true)   \
+    X(VALID, false)          \
+    X(COMPLIANCE, false)
+
+#define REPROCESS_ENUM_X(name, required) COL_##name,
+#define REPROCESS_NAME_X(name, required) #name,
+#define REPROCESS_REQUIRED_X(name, required) required,
+
+typedef enum
+{
+    REPROCESS_COLUMNS(REPROCESS_ENUM_X)
+    COL_NUM
+} t_column;
+
+static const char *column_names[COL_NUM] = {REPROCESS_COLUMNS(REPROCESS_NAME_X)};
+static const bool column_required[COL_NUM] = {REPROCESS_COLUMNS(REPROCESS_REQUIRED_X)};
+
+// Position of the known columns in a recording, -1 when missing
+typedef struct
+{
+    int index[COL_NUM];
+    int num_columns;
+} t_layout;
+
+// Recorded row, split into its fields
+typedef struct
+{
+    char text[RECORD_ROW_SIZE];
+    char *fields[MAX_COLUMNS];
+    double mean_windspeed;
+    unsigned int humidity;
+} t_row;
+
+static unsigned short runway_heading = 248;    // Runway heading[deg](Manching)
+static unsigned short runway_elevation = 1204; // Elevation[ft](Manching)
+static unsigned char height_qfe = 1;           // Height difference between barometer and reference level[m]
+static bool from_to = false;
+static const char *out_dir = NULL;
+static bool overwrite = false;
+static t_compliance_limits limits = {COMPLIANCE_10DB, COMPLIANCE_WIND_LIMIT, COMPLIANCE_CROSS_WIND_LIMIT};
+
+static t_job *jobs = NULL;
+static size_t num_jobs = 0;
+static size_t max_jobs = 0;
+
+/**
+ * Mean of the samples collected so far while the moving average window fills.
+ */
+static double partial_mean(const double *arr, unsigned char n)
+{
+    double sum = 0.0;
+
+    for (unsigned char i = 0; i < n; i++)
+        sum += arr[i];
+    return n ? sum / n : 0.0;
+}
+
+/**
+ * Split a line at the separators in place, returns the number of fields.
+ */
+static int split_fields(char *line, char **fields, int max)
+{
+    int n = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    while (n < max)
+    {
+        fields[n++] = line;
+        line = strchr(line, ';');
+        if (line == NULL)
+            break;
+        *line++ = '\0';
+    }
+    return line == NULL ? n : -1;
+}
+
+/**
+ * Find the known columns in the header line.
+ */
+static int read_layout(char *header, t_layout *l)
+{
+    char *fields[MAX_COLUMNS];
+
+    l->num_columns = split_fields(header, fields, MAX_COLUMNS);
+    if (l->num_columns < 1 || strcmp(fields[0], "LOG_TIME") != 0)
+        return EXIT_FAILURE;
+    for (int c = 0; c < COL_NUM; c++)
+    {
+        l->index[c] = -1;
+        for (int i = 1; i < l->num_columns; i++)
+        {
+            if (strcmp(fields[i], column_names[c]) == 0)
+            {
+                l->index[c] = i;
+                break;
+            }
+        }
+        if (column_required[c] && l->index[c] < 0)
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Parse a number of a known column, false if it is not one.
+ */
+static bool field_number(const t_row *r, const t_layout *l, t_column c, double *v)
+{
+    char *end;
+
+    *v = strtod(r->fields[l->index[c]], &end);
+    return end != r->fields[l->index[c]] && *end == '\0';
+}
+
+static void flush_block(FILE *out, const t_layout *l, const t_derived_const *c, t_moving_avg *avg,
+                        t_row *rows, t_maws_sample *samples, const t_derived_block *b, size_t n)
+{
+    t_wind_components w;
+    t_mean_values mean = {0};
+    unsigned char flags;
+
+    derived_batch(c, b, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        w.cross_wind = b->cross_wind[i];
+        w.head_wind = b->head_wind[i];
+        w.wind_comp1 = b->wind_comp1[i];
+        w.wind_comp2 = b->wind_comp2[i];
+        flags = 0;
+        if (!moving_avg_update(avg, &samples[i], &w, &mean))
+        {
+            mean.cross_wind = partial_mean(avg->cross_wind_arr, avg->index);
+            mean.head_wind = partial_mean(avg->head_wind_arr, avg->index);
+        }
+        else
+        {
+            // Recorded temperature, humidity and mean wind are 30 s means already
+            flags = compliance_evaluate(&limits, samples[i].temperature, rows[i].humidity, rows[i].mean_windspeed,
+                                        mean.cross_wind);
+        }
+
+        // Columns derived from the runway are rewritten, all others copied
+        fputs(rows[i].fields[0], out);
+        for (int k = 1; k < l->num_columns; k++)
+        {
+            if (k == l->index[COL_WIND_LAT])
+                fprintf(out, ";%0.1f", fabs(w.cross_wind));
+            else if (k == l->index[COL_MEAN_WIND_LAT])
+                fprintf(out, ";%0.1f", fabs(mean.cross_wind));
+            else if (k == l->index[COL_VALID])
+                fprintf(out, ";%u", (flags & COMPLIANCE_VALID) ? 1 : 0);
+            else if (k == l->index[COL_COMPLIANCE])
+                fprintf(out, ";0x%02X", flags);
+            else
+                fprintf(out, ";%s", rows[i].fields[k]);
+        }
+        // Recordings older than the compliance columns get them appended
+        if (l->index[COL_VALID] < 0)
+            fprintf(out, ";%u", (flags & COMPLIANCE_VALID) ? 1 : 0);
+        if (l->index[COL_COMPLIANCE] < 0)
+            fprintf(out, ";0x%02X", flags);
+        fprintf(out, ";%0.1f;%0.1f;%0.1f;%0.1f\n", w.head_wind, mean.head_wind, b->qfe[i], b->qnh[i]);
+    }
+}
+
+/**
+ * Reprocess one recording file, pool task.
+ */
+static void process_file(void *arg)
+{
+    t_job *job = (t_job *)arg;
+    char tmp[PATH_MAX + 8];
+    char line[LINE_SIZE];
+    char header[LINE_SIZE];
+    char units[LINE_SIZE];
+    FILE *out;
+    gzFile in;
+    t_derived_const c;
+    t_moving_avg avg = {0};
+    t_layout layout;
+    // One block of rows, the only per file storage
+    t_row *rows;
+    t_maws_sample samples[DERIVED_BLOCK_SIZE];
+    double windspeed[DERIVED_BLOCK_SIZE], pressure[DERIVED_BLOCK_SIZE], temperature[DERIVED_BLOCK_SIZE];
+    unsigned short direction[DERIVED_BLOCK_SIZE];
+    double cross[DERIVED_BLOCK_SIZE], head[DERIVED_BLOCK_SIZE], comp1[DERIVED_BLOCK_SIZE], comp2[DERIVED_BLOCK_SIZE];
+    double qfe[DERIVED_BLOCK_SIZE], qnh[DERIVED_BLOCK_SIZE];
+    t_derived_block b = {windspeed, direction, pressure, temperature, cross, head, comp1, comp2, qfe, qnh};
+    size_t n = 0;
+    time_t now = time(NULL);
+    char stamp[32];
+
+    job->status = EXIT_FAILURE;
+    // Plain and compressed recordings, gzip reads plain files unchanged
+    in = gzopen(job->in, "r");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Failed to open %s: %s\n", job->in, strerror(errno));
+        return;
+    }
+    // Header and units of the recording are kept, columns are found by name
+    if (gzgets(in, header, sizeof(header)) == NULL || gzgets(in, units, sizeof(units)) == NULL ||
+        strncmp(units, "HH:MM:SS;", 9) != 0)
+    {
+        fprintf(stderr, "Not a meteo recording: %s\n", job->in);
+        gzclose(in);
+        return;
+    }
+    header[strcspn(header, "\r\n")] = '\0';
+    units[strcspn(units, "\r\n")] = '\0';
+    snprintf(line, sizeof(line), "%s", header);
+    if (read_layout(line, &layout) != EXIT_SUCCESS)
+    {
+        fprintf(stderr, "Not a meteo recording: %s\n", job->in);
+        gzclose(in);
+        return;
+    }
+
+    rows = malloc(DERIVED_BLOCK_SIZE * sizeof(t_row));
+    if (rows == NULL)
+    {
+        fprintf(stderr, "Out of memory: %s\n", job->in);
+        gzclose(in);
+        return;
+    }
+
+    // Write to temporary file, renamed when complete
+    snprintf(tmp, sizeof(tmp), "%s.tmp", job->out);
+    out = fopen(tmp, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Failed to create %s: %s\n", tmp, strerror(errno));
+        free(rows);
+        gzclose(in);
+        return;
+    }
+
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(out, "# reprocessed %s source=%s runway_heading=%u runway_elevation=%u height_qfe=%u from_to=%u "
+                 "window=%s wind_limit=%.1f cross_wind_limit=%.1f\n",
+            stamp, job->in, runway_heading, runway_elevation, height_qfe, from_to ? 1 : 0,
+            limits.window == COMPLIANCE_0DB ? "0" : limits.window == COMPLIANCE_10DB ? "10" : "12",
+            limits.wind_limit, limits.cross_wind_limit);
+    fprintf(out, "%s%s%s;HEAD_WIND;MEAN_HEAD_WIND;QFE;QNH\n", header,
+            layout.index[COL_VALID] < 0 ? ";VALID" : "", layout.index[COL_COMPLIANCE] < 0 ? ";COMPLIANCE" : "");
+    fprintf(out, "%s%s%s;kt;kt;mbar;mbar\n", units,
+            layout.index[COL_VALID] < 0 ? ";#" : "", layout.index[COL_COMPLIANCE] < 0 ? ";flags" : "");
+
+    derived_const_init(&c, from_to ? (runway_heading + 180) % 360 : runway_heading, runway_elevation, height_qfe);
+
+    while (gzgets(in, line, sizeof(line)) != NULL)
+    {
+        t_row *r = &rows[n];
+        t_maws_sample *s = &samples[n];
+        double direction_deg;
+        double humidity;
+
+        // Comments, repeated headers and broken rows
+        if (strlen(line) >= sizeof(r->text))
+        {
+            job->skipped++;
+            continue;
+        }
+        memcpy(r->text, line, strlen(line) + 1);
+        if (split_fields(r->text, r->fields, MAX_COLUMNS) != layout.num_columns ||
+            !field_number(r, &layout, COL_TEMP, &s->temperature) ||
+            !field_number(r, &layout, COL_HUM, &humidity) ||
+            !field_number(r, &layout, COL_PRESSURE, &s->pressure) ||
+            !field_number(r, &layout, COL_DIRECTION, &direction_deg) ||
+            !field_number(r, &layout, COL_WIND_TOTAL, &s->windspeed) ||
+            !field_number(r, &layout, COL_MEAN_WIND_TOTAL, &r->mean_windspeed))
+        {
+            job->skipped++;
+            continue;
+        }
+        r->humidity = (unsigned int)humidity;
+        s->humidity = (unsigned char)r->humidity;
+        s->wind_direction = (unsigned short)direction_deg;
+        windspeed[n] = s->windspeed;
+        direction[n] = s->wind_direction;
+        pressure[n] = s->pressure;
+        temperature[n] = s->temperature;
+        job->rows++;
+
+        if (++n == DERIVED_BLOCK_SIZE)
+        {
+            flush_block(out, &layout, &c, &avg, rows, samples, &b, n);
+            n = 0;
+        }
+    }
+    if (n > 0)
+        flush_block(out, &layout, &c, &avg, rows, samples, &b, n);
+
+    free(rows);
+    gzclose(in);
+    if (fclose(out) != 0 || rename(tmp, job->out) != 0)
+    {
+        fprintf(stderr, "Failed to write %s: %s\n", job->out, strerror(errno));
+        unlink(tmp);
+        return;
+    }
+    job->status = EXIT_SUCCESS;
+}
+
+static bool has_suffix(const char *name, const char *suffix)
+{
+    size_t n = strlen(name);
+    size_t m = strlen(suffix);
+    return n >= m && strcmp(name + n - m, suffix) == 0;
+}
+
+static void add_file(const char *path)
+{
+    t_job *job;
+    char copy[PATH_MAX];
+
+    size_t ext = has_suffix(path, ".csv.gz") ? 7 : 4;
+
+    if ((!has_suffix(path, ".csv") && ext == 4) || has_suffix(path, REPROCESS_SUFFIX))
+        return;
+
+    if (num_jobs == max_jobs)
+    {
+        size_t n = max_jobs ? max_jobs * 2 : 256;
+        t_job *p = realloc(jobs, n * sizeof(t_job));
+        if (p == NULL)
+            return;
+        jobs = p;
+        max_jobs = n;
+    }
+    job = &jobs[num_jobs];
+    memset(job, 0, sizeof(t_job));
+    snprintf(job->in, sizeof(job->in), "%s", path);
+
+    if (out_dir != NULL)
+    {
+        // Mirror day folder below output directory
+        char dir[PATH_MAX];
+        snprintf(copy, sizeof(copy), "%s", path);
+        snprintf(dir, sizeof(dir), "%s/%s", out_dir, basename(dirname(copy)));
+        mkdir(out_dir, 0755);
+        mkdir(dir, 0755);
+        snprintf(copy, sizeof(copy), "%s", path);
+        // Output is always plain CSV
+        snprintf(job->out, sizeof(job->out), "%.2047s/%.*s.csv", dir, (int)(strlen(basename(copy)) - ext),
+                 basename(copy));
+    }
+    else
+    {
+        snprintf(job->out, sizeof(job->out), "%.*s" REPROCESS_SUFFIX, (int)(strlen(path) - ext), path);
+    }
+
+    if (!overwrite && access(job->out, F_OK) == 0)
+    {
+        fprintf(stderr, "Skipping %s, output exists\n", path);
+        return;
+    }
+    num_jobs++;
+}
+
+/**
+ * Collect recordings from a file, a day folder or the data root.
+ */
+static void add_path(const char *path, int depth)
+{
+    struct stat st;
+    struct dirent *e;
+    DIR *d;
+    char child[PATH_MAX];
+
+    if (stat(path, &st) != 0)
+    {
+        fprintf(stderr, "Failed to access %s: %s\n", path, strerror(errno));
+        return;
+    }
+    if (!S_ISDIR(st.st_mode))
+    {
+        // Summaries and tracks share the day folders, named files are taken as given
+        if (depth > 0 && strstr(path, "_" RECORD_KIND "_") == NULL)
+            return;
+        add_file(path);
+        return;
+    }
+    if (depth > 1 || (d = opendir(path)) == NULL)
+        return;
+
+    while ((e = readdir(d)) != NULL)
+    {
+        if (e->d_name[0] == '.')
+            continue;
+        snprintf(child, sizeof(child), "%.2047s/%.2047s", path, e->d_name);
+        add_path(child, depth + 1);
+    }
+    closedir(d);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] path...\n"
+            "  path         Recording file, day folder or data root (" RECORD_PATH ")\n"
+            "  -H heading   Runway heading [deg] [default: 248]\n"
+            "  -E elevation Runway elevation [ft] [default: 1204]\n"
+            "  -B height    Barometer height above reference level [m] [default: 1]\n"
+            "  -F           Runway from to flipped, heading + 180 deg\n"
+            "  -W dB        Temperature/humidity window 0, 10 or 12 [default: 10]\n"
+            "  -L kt        Mean wind speed limit [default: 10]\n"
+            "  -C kt        Mean cross wind limit [default: 5]\n"
+            "  -o dir       Output directory, day folders are mirrored [default: next to input]\n"
+            "  -f           Overwrite existing outputs\n"
+            "  -j threads   Worker threads [default: online CPUs]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long rows = 0, failed = 0;
+    struct timespec start, end;
+
+    while ((opt = getopt(argc, argv, "H:E:B:FW:L:C:o:fj:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'H':
+            runway_heading = (unsigned short)(atoi(optarg) % 360);
+            break;
+        case 'E':
+            runway_elevation = (unsigned short)atoi(optarg);
+            break;
+        case 'B':
+            height_qfe = (unsigned char)atoi(optarg);
+            break;
+        case 'F':
+            from_to = true;
+            break;
+        case 'W':
+            if (compliance_set_window(&limits, atoi(optarg)) != EXIT_SUCCESS)
+            {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'L':
+            limits.wind_limit = atof(optarg);
+            break;
+        case 'C':
+            limits.cross_wind_limit = atof(optarg);
+            break;
+        case 'o':
+            out_dir = optarg;
+            break;
+        case 'f':
+            overwrite = true;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (int i = optind; i < argc; i++)
+        add_path(argv[i], 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t_pool *pool = pool_create(threads);
+    if (pool == NULL)
+        return EXIT_FAILURE;
+    for (size_t i = 0; i < num_jobs; i++)
+        pool_submit(pool, process_file, &jobs[i]);
+    pool_wait(pool);
+    pool_destroy(pool);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (size_t i = 0; i < num_jobs; i++)
+    {
+        rows += jobs[i].rows;
+        if (jobs[i].status != EXIT_SUCCESS)
+            failed++;
+    }
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "files=%zu failed=%lu rows=%lu threads=%d elapsed_s=%.3f rows_per_s=%.0f\n",
+            num_jobs, failed, rows, threads, elapsed, elapsed > 0.0 ? (double)rows / elapsed : 0.0);
+
+    free(jobs);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,237 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Sliding window rollups with constant cost per sample.
+// Mean and standard deviation come from running sums, minimum and maximum of
+// the samples and of the 3 s running mean (WMO gust and lull) from monotonic
+// deques, wind direction statistics from circular running sums. Windows are time based, samples older than the window length drop
+// out of the front.
+
+#include <stdlib.h>
+#include <math.h>
+#include <stdbool.h>
+#include "rollup.h"
+
+const double rollup_lengths[ROLLUP_NUM_WINDOWS] = {3.0, 60.0, 120.0, ROLLUP_MAX_LENGTH};
+
+static int deque_init(t_mono_deque *d, size_t cap)
+{
+    d->seq = calloc(cap, sizeof(unsigned long long));
+    d->cap = cap;
+    d->head = 0;
+    d->count = 0;
+    return d->seq != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static inline unsigned long long deque_front(const t_mono_deque *d)
+{
+    return d->seq[d->head];
+}
+
+static inline unsigned long long deque_back(const t_mono_deque *d)
+{
+    return d->seq[(d->head + d->count - 1) % d->cap];
+}
+
+static inline void deque_pop_front(t_mono_deque *d)
+{
+    d->head = (d->head + 1) % d->cap;
+    d->count--;
+}
+
+/**
+ * Push sample, dropping all samples from the back that can never become
+ * the extremum again.
+ */
+static inline void deque_push(t_mono_deque *d, const double *values, size_t cap,
+                              unsigned long long seq, bool is_max)
+{
+    double v = values[seq % cap];
+
+    while (d->count > 0)
+    {
+        double b = values[deque_back(d) % cap];
+        if (is_max ? (b > v) : (b < v))
+            break;
+        d->count--;
+    }
+    d->seq[(d->head + d->count) % d->cap] = seq;
+    d->count++;
+}
+
+static int window_init(t_rollup_window *w, double length)
+{
+    size_t cap = (size_t)ceil(length * ROLLUP_MAX_RATE) + 1;
+
+    w->length = length;
+    w->cap = cap;
+    w->t = calloc(cap, sizeof(double));
+    w->v = calloc(cap, sizeof(double));
+    w->g = calloc(cap, sizeof(double));
+    w->d = calloc(cap, sizeof(t_circular_sample));
+    w->count = 0;
+    w->first_seq = 0;
+    w->sum = 0.0;
+    w->sum_sq = 0.0;
+    circular_clear(&w->dir);
+    if (w->t == NULL || w->v == NULL || w->g == NULL || w->d == NULL)
+        return EXIT_FAILURE;
+    if (deque_init(&w->max_v, cap) || deque_init(&w->min_v, cap) ||
+        deque_init(&w->max_g, cap) || deque_init(&w->min_g, cap))
+        return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+static void window_free(t_rollup_window *w)
+{
+    free(w->t);
+    free(w->v);
+    free(w->g);
+    free(w->d);
+    free(w->max_v.seq);
+    free(w->min_v.seq);
+    free(w->max_g.seq);
+    free(w->min_g.seq);
+}
+
+static void window_pop(t_rollup_window *w)
+{
+    unsigned long long seq = w->first_seq;
+    double v = w->v[seq % w->cap];
+
+    w->sum -= v;
+    w->sum_sq -= v * v;
+    circular_remove(&w->dir, &w->d[seq % w->cap]);
+    if (w->max_v.count && deque_front(&w->max_v) == seq)
+        deque_pop_front(&w->max_v);
+    if (w->min_v.count && deque_front(&w->min_v) == seq)
+        deque_pop_front(&w->min_v);
+    if (w->max_g.count && deque_front(&w->max_g) == seq)
+        deque_pop_front(&w->max_g);
+    if (w->min_g.count && deque_front(&w->min_g) == seq)
+        deque_pop_front(&w->min_g);
+    w->count--;
+    w->first_seq++;
+}
+
+/**
+ * Add sample with its 3 s mean g, expire samples older than the window.
+ */
+static void window_push(t_rollup_window *w, unsigned long long seq, double t, double v, double g,
+                        const t_circular_sample *d)
+{
+    size_t i;
+
+    while (w->count > 0 && (t - w->t[w->first_seq % w->cap] >= w->length || w->count == w->cap))
+        window_pop(w);
+    if (w->count == 0)
+        w->first_seq = seq;
+
+    i = seq % w->cap;
+    w->t[i] = t;
+    w->v[i] = v;
+    w->g[i] = g;
+    w->d[i] = *d;
+    w->count++;
+    w->sum += v;
+    w->sum_sq += v * v;
+    circular_add(&w->dir, d);
+    deque_push(&w->max_v, w->v, w->cap, seq, true);
+    deque_push(&w->min_v, w->v, w->cap, seq, false);
+    deque_push(&w->max_g, w->g, w->cap, seq, true);
+    deque_push(&w->min_g, w->g, w->cap, seq, false);
+
+    // Running sums drift, resum once per ring turn
+    if (seq % w->cap == 0)
+    {
+        w->sum = 0.0;
+        w->sum_sq = 0.0;
+        circular_clear(&w->dir);
+        for (size_t k = 0; k < w->count; k++)
+        {
+            double x = w->v[(w->first_seq + k) % w->cap];
+            w->sum += x;
+            w->sum_sq += x * x;
+            circular_add(&w->dir, &w->d[(w->first_seq + k) % w->cap]);
+        }
+    }
+}
+
+int rollup_init(t_rollup *r)
+{
+    r->seq = 0;
+    if (window_init(&r->gust, ROLLUP_GUST_LENGTH) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    for (int i = 0; i < ROLLUP_NUM_WINDOWS; i++)
+    {
+        if (window_init(&r->windows[i], rollup_lengths[i]) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void rollup_free(t_rollup *r)
+{
+    window_free(&r->gust);
+    for (int i = 0; i < ROLLUP_NUM_WINDOWS; i++)
+        window_free(&r->windows[i]);
+}
+
+/**
+ * Add a wind sample taken at time t [s].
+ */
+void rollup_update(t_rollup *r, double t, double value, unsigned short direction)
+{
+    unsigned long long seq = r->seq++;
+    t_circular_sample d;
+    double g;
+
+    circular_sample(&d, value, direction);
+    window_push(&r->gust, seq, t, value, 0.0, &d);
+    g = r->gust.sum / (double)r->gust.count;
+    for (int i = 0; i < ROLLUP_NUM_WINDOWS; i++)
+        window_push(&r->windows[i], seq, t, value, g, &d);
+}
+
+void rollup_stats(const t_rollup *r, t_rollup_stats stats[ROLLUP_NUM_WINDOWS])
+{
+    for (int i = 0; i < ROLLUP_NUM_WINDOWS; i++)
+    {
+        const t_rollup_window *w = &r->windows[i];
+        t_rollup_stats *s = &stats[i];
+        t_circular_stats dir;
+
+        if (w->count == 0)
+        {
+            s->mean = s->min = s->max = s->std = s->gust = s->lull = 0.0;
+            s->direction_mean = s->direction_std = 0.0;
+            continue;
+        }
+        double n = (double)w->count;
+        double mean = w->sum / n;
+        double var = w->sum_sq / n - mean * mean;
+        s->mean = mean;
+        s->std = var > 0.0 ? sqrt(var) : 0.0;
+        s->max = w->v[deque_front(&w->max_v) % w->cap];
+        s->min = w->v[deque_front(&w->min_v) % w->cap];
+        s->gust = w->g[deque_front(&w->max_g) % w->cap];
+        s->lull = w->g[deque_front(&w->min_g) % w->cap];
+        circular_stats(&w->dir, &dir);
+        s->direction_mean = dir.weighted_mean;
+        s->direction_std = dir.std;
+    }
+}
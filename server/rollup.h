@@ -0,0 +1,91 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include "circular.h"
+
+#define ROLLUP_GUST_LENGTH 3.0 // WMO gust averaging time [s]
+#define ROLLUP_MAX_RATE 4      // Maximum sample rate the windows are sized for [Hz]
+#define ROLLUP_NUM_WINDOWS 4   // 3 s, 1 min, 2 min, 10 min
+#define ROLLUP_MAX_LENGTH 600  // Longest window [s]
+
+// Rollup statistics, F(type, name, js_name, js_type) as in schema.h
+#define ROLLUP_STATS_FIELDS(F)                                                   \
+    F(double, mean, mean, Float64)                                               \
+    F(double, min, min, Float64)                                                 \
+    F(double, max, max, Float64)                                                 \
+    F(double, std, std, Float64)                                                 \
+    F(double, gust, gust, Float64)                     /* Maximum of 3 s running mean */ \
+    F(double, lull, lull, Float64)                     /* Minimum of 3 s running mean */ \
+    F(double, direction_mean, directionMean, Float64)  /* Speed weighted vector mean [deg] */ \
+    F(double, direction_std, directionStd, Float64)    /* Yamartino standard deviation [deg] */
+
+#define ROLLUP_STATS_STRUCT_F(type, name, js_name, js_type) type name;
+
+typedef struct
+{
+    ROLLUP_STATS_FIELDS(ROLLUP_STATS_STRUCT_F)
+} t_rollup_stats;
+
+/**
+ * Monotonic deque of sample sequence numbers, front holds the extremum.
+ */
+typedef struct
+{
+    unsigned long long *seq;
+    size_t cap;
+    size_t head;
+    size_t count;
+} t_mono_deque;
+
+typedef struct
+{
+    double length; // [s]
+    size_t cap;
+    double *t; // Sample time
+    double *v; // Sample value
+    double *g; // 3 s running mean at sample time
+    t_circular_sample *d; // Wind direction
+    size_t count;
+    unsigned long long first_seq; // Sequence number of oldest sample
+    double sum;
+    double sum_sq;
+    t_circular dir;
+    t_mono_deque max_v;
+    t_mono_deque min_v;
+    t_mono_deque max_g;
+    t_mono_deque min_g;
+} t_rollup_window;
+
+typedef struct
+{
+    t_rollup_window gust; // Running mean window for the 3 s gust
+    t_rollup_window windows[ROLLUP_NUM_WINDOWS];
+    unsigned long long seq;
+} t_rollup;
+
+extern const double rollup_lengths[ROLLUP_NUM_WINDOWS];
+
+int rollup_init(t_rollup *r);
+void rollup_free(t_rollup *r);
+void rollup_update(t_rollup *r, double t, double value, unsigned short direction);
+void rollup_stats(const t_rollup *r, t_rollup_stats stats[ROLLUP_NUM_WINDOWS]);
+
+#endif /* ROLLUP_H */
@@ -0,0 +1,172 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Single source of the packet layout and the recording columns.
+//
+// PACKET_FIELDS(F, A) lists the packet fields in wire order:
+//   F(type, name, js_name, js_type)         scalar field
+//   A(type, name, count, js_name, FIELDS)   array of structs, FIELDS(F) lists their members
+// js_type is the DataView accessor (Float64, Uint16, Uint8). Fields are ordered
+// by decreasing alignment, so the C struct is naturally aligned without padding
+// between fields. The C struct, the encoder (packet.c) and the JS decoder
+// (client/scripts/packet.js, written by server/schemagen) are generated from it.
+//
+// RECORD_COLUMNS(X) lists the recording columns after LOG_TIME:
+//   X(header, unit, format, args...)
+// args are expressions of the packet data p. Header, units and the row
+// formatter (record.c) are generated from it.
+//
+// SUMMARY_FIELDS(S) lists the fields of the run summary (summary.c), its file
+// columns and the JS decoder of the summary event.
+//
+// Adding a field: append it to PACKET_FIELDS in its alignment group, add a
+// column to RECORD_COLUMNS if it is recorded, then run make.
+
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include "rollup.h"
+#include "absorption.h"
+
+#define PACKET_FIELDS(F, A)                                                                     \
+    F(double, gps_hdop, gpsHDOP, Float64)                                                       \
+    F(double, gps_pdop, gpsPDOP, Float64)                                                       \
+    F(double, gps_lat, gpsLat, Float64)                                                         \
+    F(double, gps_lon, gpsLon, Float64)                                                         \
+    F(double, gps_alt_msl, gpsAltMsl, Float64)                                                  \
+    F(double, temperature, temperature, Float64)                                                \
+    F(double, baro_pressure, baroPressure, Float64)                                             \
+    F(double, windspeed, windspeed, Float64)                                                    \
+    F(double, windspeed_mean, windspeedMean, Float64)                                           \
+    F(double, cross_windspeed, crossWindspeed, Float64)                                         \
+    F(double, cross_windspeed_mean, crossWindspeedMean, Float64)                                \
+    F(double, head_windspeed, headWindspeed, Float64)                                           \
+    F(double, baro_qfe, QFE, Float64)                                                           \
+    F(double, baro_qnh, QNH, Float64)                                                           \
+    F(double, gps_time, gpsTime, Float64)                                                       \
+    F(double, local_time, localTime, Float64)                                                   \
+    A(t_rollup_stats, wind_rollup, ROLLUP_NUM_WINDOWS, windRollup, ROLLUP_STATS_FIELDS)         \
+    F(double, wind_direction_std, windDirectionStd, Float64) /* 30 s Yamartino std */           \
+    F(double, speed_of_sound, speedOfSound, Float64) /* From 30 s mean temperature [m/s] */      \
+    A(t_absorption_band, absorption, ABSORPTION_NUM_BANDS, absorption, ABSORPTION_BAND_FIELDS)  \
+    F(unsigned int, publish_seq, publishSeq, Uint32) /* Websocket publish counter, wraps */   \
+    F(unsigned short, flight_number, flightNumber, Uint16)                                      \
+    F(unsigned short, runway_heading, runwayHeading, Uint16)                                    \
+    F(unsigned short, runway_elevation, runwayElevation, Uint16)                                \
+    F(unsigned short, wind_direction, windDirection, Uint16)                                    \
+    F(unsigned short, wind_direction_mean, windDirectionMean, Uint16)                           \
+    F(unsigned char, barometer_height, barometerHeight, Uint8)                                  \
+    F(unsigned char, maws_hour, maws_hour, Uint8)                                               \
+    F(unsigned char, maws_min, maws_minute, Uint8)                                              \
+    F(unsigned char, maws_sec, maws_second, Uint8)                                              \
+    F(unsigned char, humidity, humidity, Uint8)                                                 \
+    F(unsigned char, top_number, topNumber, Uint8)                                              \
+    F(unsigned char, gps_status, gpsStatus, Uint8)                                              \
+    F(unsigned char, gps_mode, gpsMode, Uint8)                                                  \
+    F(unsigned char, gps_satellites_visible, gpsSatellitesVisible, Uint8)                       \
+    F(unsigned char, gps_satellites_used, gpsSatellitesUsed, Uint8)                             \
+    F(unsigned char, record_status, recordStatus, Uint8)                                        \
+    F(unsigned char, from_to_status, fromToStatus, Uint8)                                       \
+    F(unsigned char, compliance, compliance, Uint8) /* COMPLIANCE_* flags of the 30 s means */ \
+    F(unsigned char, qc_temperature, qcTemperature, Uint8) /* QC_* flags, see qc.h */         \
+    F(unsigned char, qc_humidity, qcHumidity, Uint8)                                            \
+    F(unsigned char, qc_pressure, qcPressure, Uint8)                                            \
+    F(unsigned char, qc_windspeed, qcWindspeed, Uint8)                                          \
+    F(unsigned char, qc_wind_direction, qcWindDirection, Uint8)
+
+#define RECORD_BASE_COLUMNS(X)                                                          \
+    X("TEMP", "degC", "%0.1f", p->temperature)                                          \
+    X("HUM", "%", "%u", p->humidity)                                                    \
+    X("PRESSURE", "mbar", "%0.1f", p->baro_pressure)                                    \
+    X("DIRECTION", "deg", "%u", p->wind_direction)                                      \
+    X("WIND_TOTAL", "kt", "%0.1f", fabs(p->windspeed))                                  \
+    X("WIND_LAT", "kt", "%0.1f", fabs(p->cross_windspeed))                              \
+    X("MEAN_WIND_TOTAL", "kt", "%0.1f", fabs(p->windspeed_mean))                        \
+    X("MEAN_WIND_LAT", "kt", "%0.1f", fabs(p->cross_windspeed_mean))                    \
+    X("GPS_EPOCH_RECORDED", "seconds", "%.0f", p->gps_time)                             \
+    X("TIME_MAWS_RECORDED", "HH:MM:SS", "%02u:%02u:%02u", p->maws_hour, p->maws_min, p->maws_sec) \
+    X("TOP_NUMBER", "#", "%u", p->top_number)
+
+// Position of the row, interpolated at the MAWS sample time, see fusion.h
+#define RECORD_GPS_COLUMNS(X)                                                           \
+    X("GPS_LAT", "deg", "%.6f", p->gps_lat)                                             \
+    X("GPS_LON", "deg", "%.6f", p->gps_lon)                                             \
+    X("GPS_ALT", "m MSL", "%0.1f", p->gps_alt_msl)                                      \
+    X("GPS_MODE", "#", "%u", p->gps_mode)
+
+#define RECORD_ROLLUP_COLUMNS(X, W, I)                                                  \
+    X("WIND_MEAN_" W, "kt", "%0.1f", p->wind_rollup[I].mean)                            \
+    X("WIND_MIN_" W, "kt", "%0.1f", p->wind_rollup[I].min)                              \
+    X("WIND_MAX_" W, "kt", "%0.1f", p->wind_rollup[I].max)                              \
+    X("WIND_STD_" W, "kt", "%0.2f", p->wind_rollup[I].std)                              \
+    X("GUST_" W, "kt", "%0.1f", p->wind_rollup[I].gust)                                 \
+    X("LULL_" W, "kt", "%0.1f", p->wind_rollup[I].lull)                                 \
+    X("DIRECTION_MEAN_" W, "deg", "%.0f", p->wind_rollup[I].direction_mean)             \
+    X("DIRECTION_STD_" W, "deg", "%0.1f", p->wind_rollup[I].direction_std)
+
+#define RECORD_COMPLIANCE_COLUMNS(X)                                                    \
+    X("VALID", "#", "%u", (p->compliance & COMPLIANCE_VALID) ? 1 : 0)                   \
+    X("COMPLIANCE", "flags", "0x%02X", p->compliance)
+
+#define RECORD_QC_COLUMNS(X)                                                            \
+    X("QC_TEMP", "flags", "0x%02X", p->qc_temperature)                                  \
+    X("QC_HUM", "flags", "0x%02X", p->qc_humidity)                                      \
+    X("QC_PRESSURE", "flags", "0x%02X", p->qc_pressure)                                 \
+    X("QC_WIND", "flags", "0x%02X", p->qc_windspeed)                                    \
+    X("QC_DIRECTION", "flags", "0x%02X", p->qc_wind_direction)
+
+// Sound speed and absorption of every one-third octave band, see absorption.h
+#define RECORD_ABSORPTION_B(X, i, nominal, f) X("ABS_" nominal, "dB/100m", "%0.3f", p->absorption[i].alpha)
+#define RECORD_ABSORPTION_COLUMNS(X)                                                    \
+    X("SOUND_SPEED", "m/s", "%0.1f", p->speed_of_sound)                                 \
+    ABSORPTION_BANDS(RECORD_ABSORPTION_B, X)
+
+#define RECORD_COLUMNS(X)                                                               \
+    RECORD_BASE_COLUMNS(X)                                                              \
+    RECORD_GPS_COLUMNS(X)                                                               \
+    RECORD_ROLLUP_COLUMNS(X, "3S", 0)                                                   \
+    RECORD_ROLLUP_COLUMNS(X, "1M", 1)                                                   \
+    RECORD_ROLLUP_COLUMNS(X, "2M", 2)                                                   \
+    RECORD_ROLLUP_COLUMNS(X, "10M", 3)                                                  \
+    X("DIRECTION_MEAN", "deg", "%u", p->wind_direction_mean)                            \
+    X("DIRECTION_STD", "deg", "%0.1f", p->wind_direction_std)                           \
+    RECORD_COMPLIANCE_COLUMNS(X)                                                        \
+    RECORD_QC_COLUMNS(X)                                                                \
+    RECORD_ABSORPTION_COLUMNS(X)
+
+// Run summary fields, S(name, js_name, header, unit, value), value is an
+// expression of the packet data p. Mean, minimum and maximum are kept of each.
+#define SUMMARY_FIELDS(S)                                                               \
+    S(temperature, temperature, "TEMP", "degC", p->temperature)                         \
+    S(humidity, humidity, "HUM", "%", p->humidity)                                      \
+    S(pressure, pressure, "PRESSURE", "mbar", p->baro_pressure)                         \
+    S(qnh, QNH, "QNH", "mbar", p->baro_qnh)                                             \
+    S(windspeed, windspeed, "WIND_TOTAL", "kt", fabs(p->windspeed))                     \
+    S(windspeed_mean, windspeedMean, "MEAN_WIND_TOTAL", "kt", fabs(p->windspeed_mean))  \
+    S(cross_wind, crossWind, "WIND_LAT", "kt", fabs(p->cross_windspeed))                \
+    S(cross_wind_mean, crossWindMean, "MEAN_WIND_LAT", "kt", fabs(p->cross_windspeed_mean)) \
+    S(head_wind_mean, headWindMean, "MEAN_WIND_HEAD", "kt", p->head_windspeed)          \
+    S(gust, gust, "GUST_3S", "kt", p->wind_rollup[0].gust)
+
+// Expanders for the recording columns
+#define RECORD_HEADER_X(header, unit, format, ...) ";" header
+#define RECORD_UNIT_X(header, unit, format, ...) ";" unit
+#define RECORD_FORMAT_X(header, unit, format, ...) ";" format
+#define RECORD_ARG_X(header, unit, format, ...) , __VA_ARGS__
+#define RECORD_COUNT_X(header, unit, format, ...) +1
+
+#endif /* SCHEMA_H */
@@ -0,0 +1,100 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Writes the JS packet and run summary decoders generated from PACKET_FIELDS
+// and SUMMARY_FIELDS in schema.h.
+// Run by make, output is client/scripts/packet.js.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "meteoserver.h"
+#include "packet.h"
+#include "summary.h"
+
+// DataView accessors of one byte take no endianness argument
+static const char *endian(const char *js_type)
+{
+    return strcmp(js_type, "Uint8") == 0 ? "" : ", true";
+}
+
+#define INIT_F(type, name, js_name, js_type) printf("    %s: 0,\n", #js_name);
+#define INIT_SUB_F(type, name, js_name, js_type) printf("      %s: 0,\n", #js_name);
+#define INIT_A(type, name, count, js_name, fields)                                     \
+    printf("    %s: Array.from({ length: %zu }, () => ({\n", #js_name, (size_t)(count)); \
+    fields(INIT_SUB_F)                                                                 \
+    printf("    })),\n");
+
+#define DECODE_F(type, name, js_name, js_type)                     \
+    printf("  d.%s = dv.get%s(%zu%s);\n", #js_name, #js_type,      \
+           offsetof(t_packet_data, name), endian(#js_type));
+// Array members are offsets into t_element, the element type of the enclosing DECODE_A
+#define DECODE_SUB_F(type, name, js_name, js_type) \
+    printf("    e.%s = dv.get%s(o + %zu%s);\n", #js_name, #js_type, offsetof(t_element, name), endian(#js_type));
+#define DECODE_A(type, name, count, js_name, fields)                                              \
+    {                                                                                             \
+        typedef type t_element;                                                                   \
+        printf("  for (let i = 0; i < %zu; i += 1) {\n", (size_t)(count));                        \
+        printf("    const o = %zu + i * %zu;\n", offsetof(t_packet_data, name), sizeof(type));    \
+        printf("    const e = d.%s[i];\n", #js_name);                                              \
+        fields(DECODE_SUB_F)                                                                      \
+        printf("  }\n");                                                                         \
+    }
+
+#define SUMMARY_NAME_S(name, js_name, header, unit, value) printf("  '%s',\n", #js_name);
+#define SUMMARY_HEADER_F(name, js_name, type)                                           \
+    printf("    %s: dv.get%s(%zu%s),\n", #js_name, #type, offsetof(t_summary_event, name), \
+           endian(#type));
+
+int main(void)
+{
+    printf("// Generated by server/schemagen from server/schema.h, do not edit.\n"
+           "/* exported PACKET_SIZE, createPacket, decodePacket, SUMMARY_SIZE, SUMMARY_FIELDS, decodeSummary */\n\n"
+           "const PACKET_SIZE = %zu;\n\n", PACKET_SIZE);
+
+    printf("/*\n * New packet object with all fields zero.\n */\n"
+           "function createPacket() {\n  return {\n");
+    PACKET_FIELDS(INIT_F, INIT_A)
+    printf("  };\n}\n\n");
+
+    printf("/*\n * Decode packet from DataView dv into packet object d.\n */\n"
+           "function decodePacket(dv, d) {\n");
+    PACKET_FIELDS(DECODE_F, DECODE_A)
+    printf("}\n");
+
+    printf("\nconst SUMMARY_SIZE = %zu;\n\n", SUMMARY_EVENT_SIZE);
+    printf("const SUMMARY_FIELDS = Object.freeze([\n");
+    SUMMARY_FIELDS(SUMMARY_NAME_S)
+    printf("]);\n\n");
+    printf("/*\n * Decode run summary event from DataView dv.\n */\n"
+           "function decodeSummary(dv) {\n  const d = {\n");
+    SUMMARY_HEADER_F(top_number, topNumber, Uint8)
+    SUMMARY_HEADER_F(flight_number, flightNumber, Uint16)
+    SUMMARY_HEADER_F(start, start, Uint32)
+    SUMMARY_HEADER_F(seconds, seconds, Uint32)
+    SUMMARY_HEADER_F(seconds_valid, secondsValid, Uint32)
+    SUMMARY_HEADER_F(seconds_gps_3d, secondsGps3d, Uint32)
+    SUMMARY_HEADER_F(gps_satellites_min, gpsSatellitesMin, Uint8)
+    SUMMARY_HEADER_F(gps_hdop_max, gpsHdopMax, Float64)
+    printf("    fields: {}\n  };\n"
+           "  SUMMARY_FIELDS.forEach((name, i) => {\n"
+           "    const o = %zu + i * 24;\n"
+           "    d.fields[name] = { mean: dv.getFloat64(o, true), min: dv.getFloat64(o + 8, true), max: dv.getFloat64(o + 16, true) };\n"
+           "  });\n  return d;\n}\n",
+           sizeof(t_summary_event));
+    return EXIT_SUCCESS;
+}
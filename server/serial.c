@@ -142,6 +142,16 @@ int open_serial(void)
 void close_serial(void)
 {
     close(serial_fd);
+    serial_fd = -1;
+}
+
+/**
+ * Descriptor of the open serial device, -1 if closed.
+ * In canonical mode it becomes readable once a full line is received.
+ */
+int get_serial_fd(void)
+{
+    return serial_fd;
 }
 
 char *read_serial(ssize_t *len)
@@ -26,5 +26,6 @@ void set_baudrate(const char *arg);
 void set_serial_interface(const char *dname);
 char *read_serial(ssize_t *len);
 ssize_t write_serial(const char *buf, size_t len);
+int get_serial_fd(void);
 
 #endif /* SERIAL_H */
\ No newline at end of file
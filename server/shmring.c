@@ -0,0 +1,123 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmring.h"
+
+_Static_assert(sizeof(t_packet_data) <= SHMRING_SLOT_SIZE, "packet does not fit a shared memory slot");
+
+static t_shmring *ring = NULL;
+
+/**
+ * Create or reuse the shared memory ring.
+ * A ring left by a previous run is continued, so mapped readers survive a restart.
+ */
+int shmring_open(const char *name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open shared memory %s: %s\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (ftruncate(fd, sizeof(t_shmring)) != 0)
+    {
+        fprintf(stderr, "Failed to size shared memory %s: %s\n", name, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    ring = mmap(NULL, sizeof(t_shmring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map shared memory %s: %s\n", name, strerror(errno));
+        ring = NULL;
+        return EXIT_FAILURE;
+    }
+
+    if (!shmring_valid(ring))
+    {
+        memset(ring, 0, sizeof(t_shmring));
+        ring->num_slots = SHMRING_SLOTS;
+        ring->slot_size = SHMRING_SLOT_SIZE;
+        ring->packet_size = sizeof(t_packet_data);
+        ring->version = SHMRING_VERSION;
+        // Magic last, readers check it first
+        atomic_thread_fence(memory_order_release);
+        ring->magic = SHMRING_MAGIC;
+    }
+    else
+    {
+        // A slot left odd by a crash would block readers
+        for (int i = 0; i < SHMRING_SLOTS; i++)
+        {
+            if (atomic_load(&ring->slots[i].seq) & 1)
+                atomic_fetch_add(&ring->slots[i].seq, 1);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Publish one packet as raw t_packet_data. Single writer only.
+ */
+void shmring_publish(const void *data, size_t len)
+{
+    t_shmring_slot *slot;
+    uint64_t head;
+    struct timespec ts;
+
+    if (ring == NULL || len > SHMRING_SLOT_SIZE)
+        return;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    slot = &ring->slots[head % SHMRING_SLOTS];
+
+    atomic_fetch_add_explicit(&slot->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(slot->data, data, len);
+    slot->size = (uint32_t)len;
+    slot->index = head;
+    slot->time = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+    atomic_fetch_add_explicit(&slot->seq, 1, memory_order_release);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * Unmap the ring, the shared memory object is kept for readers.
+ */
+void shmring_close(void)
+{
+    if (ring != NULL)
+    {
+        munmap(ring, sizeof(t_shmring));
+        ring = NULL;
+    }
+}
@@ -0,0 +1,157 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Shared memory ring of published packets for local consumer processes.
+//
+// meteoserver started with --shm publishes every packet it sends to websocket
+// clients into a POSIX shared memory object (default "/meteo"). Consumers on
+// the same machine map the object read-only and read packets without syscalls
+// or copies through a socket stack. The object survives server restarts,
+// mapped readers keep working when the server comes back.
+//
+// Reader example, see also server/shmtail.c:
+//
+//     int fd = shm_open(SHMRING_NAME, O_RDONLY, 0);
+//     const t_shmring *r = mmap(NULL, sizeof(t_shmring), PROT_READ, MAP_SHARED, fd, 0);
+//     uint64_t next = shmring_head(r);
+//     t_packet_data p;
+//     for (;;) // Poll at the rate you need
+//         if (shmring_read(r, next, &p) == SHMRING_OK)
+//             next++; // use p
+//
+// Every slot carries a sequence counter (seqlock). It is odd while the server
+// writes the slot. A reader copies the slot and accepts the copy only if the
+// counter was even and unchanged across the copy. There is a single writer,
+// readers never block it and never write to the mapping.
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "meteoserver.h"
+
+#define SHMRING_NAME "/meteo"
+#define SHMRING_MAGIC 0x4d52494eU // "NIRM"
+#define SHMRING_VERSION 3
+#define SHMRING_SLOTS 64       // Power of two, about 1 min of packets at 1 Hz
+#define SHMRING_SLOT_SIZE 1024 // Payload capacity of a slot [Byte]
+#define SHMRING_RETRIES 100    // Read attempts while the writer holds a slot
+
+// shmring_read() results
+#define SHMRING_OK 0
+#define SHMRING_EMPTY 1   // Index not yet published
+#define SHMRING_OVERRUN 2 // Index already overwritten, reader fell behind
+#define SHMRING_BUSY 3    // Slot kept changing during all retries
+#define SHMRING_SIZE 4    // Buffer too small for the payload
+
+typedef struct
+{
+    _Atomic uint32_t seq; // Odd while written
+    uint32_t size;        // Payload size [Byte]
+    uint64_t index;       // Publish index of the payload
+    double time;          // Publish time, CLOCK_REALTIME [s]
+    unsigned char data[SHMRING_SLOT_SIZE]; // t_packet_data as laid out in the writer, host byte order
+} __attribute__((aligned(64))) t_shmring_slot;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_size;
+    uint32_t packet_size; // sizeof(t_packet_data) of the writer
+    uint32_t reserved;
+    _Atomic uint64_t head; // Number of published packets, latest has index head - 1
+    t_shmring_slot slots[SHMRING_SLOTS];
+} t_shmring;
+
+/**
+ * Check a mapping before use, layout must match this header.
+ */
+static inline int shmring_valid(const t_shmring *r)
+{
+    return r->magic == SHMRING_MAGIC && r->version == SHMRING_VERSION && r->num_slots == SHMRING_SLOTS &&
+           r->slot_size == SHMRING_SLOT_SIZE && r->packet_size == sizeof(t_packet_data);
+}
+
+/**
+ * Index of the next packet to be published.
+ */
+static inline uint64_t shmring_head(const t_shmring *r)
+{
+    return atomic_load_explicit((_Atomic uint64_t *)&r->head, memory_order_acquire);
+}
+
+/**
+ * Copy packet with publish index into buf.
+ * Returns SHMRING_OK and sets *len to the payload size on success.
+ */
+static inline int shmring_read_slot(const t_shmring *r, uint64_t index, void *buf, size_t size,
+                                    size_t *len, double *time)
+{
+    t_shmring_slot *slot = (t_shmring_slot *)&r->slots[index % SHMRING_SLOTS];
+    uint32_t s1, s2;
+    uint32_t n;
+    uint64_t idx;
+
+    if (index >= shmring_head(r))
+        return SHMRING_EMPTY;
+    for (int i = 0; i < SHMRING_RETRIES; i++)
+    {
+        s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (s1 & 1)
+            continue;
+        idx = slot->index;
+        n = slot->size;
+        if (idx == index && n <= size)
+        {
+            memcpy(buf, slot->data, n);
+            if (time != NULL)
+                *time = slot->time;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+        if (s1 != s2)
+            continue;
+        if (idx != index)
+            return SHMRING_OVERRUN;
+        if (n > size)
+            return SHMRING_SIZE;
+        if (len != NULL)
+            *len = n;
+        return SHMRING_OK;
+    }
+    return SHMRING_BUSY;
+}
+
+/**
+ * Copy packet with publish index into p.
+ */
+static inline int shmring_read(const t_shmring *r, uint64_t index, t_packet_data *p)
+{
+    return shmring_read_slot(r, index, p, sizeof(*p), NULL, NULL);
+}
+
+// Writer side, used by meteoserver
+int shmring_open(const char *name);
+void shmring_publish(const void *data, size_t len);
+void shmring_close(void);
+
+#endif /* SHMRING_H */
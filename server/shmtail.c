@@ -0,0 +1,144 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Example reader of the shared memory ring.
+// Follows the ring and prints every packet as one JSON object per line, with
+// the delay between publish and read. Packets overwritten before they were
+// read are reported as lost on stderr.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "shmring.h"
+
+#define NOTUSED(V) ((void)V)
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void sighandler(int sig)
+{
+    NOTUSED(sig);
+    interrupted = 1;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n name      Shared memory name [default: " SHMRING_NAME "]\n"
+            "  -i ms        Poll interval [default: 1]\n"
+            "  -c count     Exit after count packets [default: unlimited]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = SHMRING_NAME;
+    unsigned int poll_ms = 1;
+    unsigned long count = 0, packets = 0, lost = 0;
+    struct timespec ts;
+    t_packet_data p;
+    double time;
+    size_t len;
+    int opt, fd;
+
+    while ((opt = getopt(argc, argv, "n:i:c:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            name = optarg;
+            break;
+        case 'i':
+            poll_ms = (unsigned int)atoi(optarg);
+            break;
+        case 'c':
+            count = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open shared memory %s: %s\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    const t_shmring *r = mmap(NULL, sizeof(t_shmring), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map shared memory %s: %s\n", name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (!shmring_valid(r))
+    {
+        fprintf(stderr, "Shared memory %s has an unknown layout\n", name);
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, sighandler);
+    signal(SIGTERM, sighandler);
+
+    uint64_t next = shmring_head(r);
+    while (!interrupted && (count == 0 || packets < count))
+    {
+        switch (shmring_read_slot(r, next, &p, sizeof(p), &len, &time))
+        {
+        case SHMRING_OK:
+            clock_gettime(CLOCK_REALTIME, &ts);
+            printf("{\"index\":%llu,\"delay_ms\":%.3f,\"temperature\":%.1f,\"humidity\":%u,"
+                   "\"windspeed\":%.1f,\"wind_direction\":%u,\"compliance\":%u}\n",
+                   (unsigned long long)next,
+                   ((double)ts.tv_sec + (double)ts.tv_nsec / 1e9 - time) * 1000.0,
+                   p.temperature, p.humidity, p.windspeed, p.wind_direction, p.compliance);
+            fflush(stdout);
+            packets++;
+            next++;
+            break;
+        case SHMRING_OVERRUN:
+        {
+            // Continue with the oldest packet still in the ring
+            uint64_t oldest = shmring_head(r) - SHMRING_SLOTS + 1;
+            lost += oldest - next;
+            fprintf(stderr, "Lost %llu packets\n", (unsigned long long)(oldest - next));
+            next = oldest;
+            break;
+        }
+        default:
+            // Ring was recreated by a server with a new layout
+            if (shmring_head(r) < next)
+                next = shmring_head(r);
+            usleep(poll_ms * 1000);
+            break;
+        }
+    }
+
+    fprintf(stderr, "packets=%lu lost=%lu\n", packets, lost);
+    munmap((void *)r, sizeof(t_shmring));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,240 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Checkpoint of state that is expensive to rebuild after a restart.
+// The state file is mapped shared, every checkpoint is a plain memory write
+// that survives a crash of the process through the page cache. A sequence
+// counter per section is odd while a write is in progress, a section caught
+// in the middle of a write is not restored. The rollups are rebuilt by
+// replaying the wind samples of their longest window.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "state.h"
+
+#define STATE_MAGIC 0x4d54454fU // "OETM"
+#define STATE_VERSION 4
+
+typedef struct
+{
+    double t; // Wall clock time [s]
+    double windspeed;
+    unsigned short wind_direction;
+} t_state_wind;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t settings_seq;
+    uint32_t average_seq;
+    uint32_t wind_seq;
+    uint32_t wind_next;  // Slot of the next wind sample
+    uint32_t wind_count; // Wind samples in the ring
+    int64_t settings_time;
+    int64_t average_time;
+    t_state_settings settings;
+    t_moving_avg average;
+    t_state_wind wind[STATE_WIND_LENGTH];
+} t_state;
+
+static t_state *state = NULL;
+static t_state restored;
+static bool restored_valid = false;
+static pthread_mutex_t lock_state = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Map state file, keep a copy of the previous state for restore.
+ */
+int state_open(const char *path)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat st;
+
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to open state file %s: %s\n", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &st) == 0 && st.st_size == (off_t)sizeof(t_state))
+    {
+        if (pread(fd, &restored, sizeof(t_state), 0) == (ssize_t)sizeof(t_state))
+        {
+            restored_valid = restored.magic == STATE_MAGIC &&
+                             restored.version == STATE_VERSION &&
+                             restored.size == sizeof(t_state);
+        }
+    }
+
+    if (ftruncate(fd, sizeof(t_state)) != 0)
+    {
+        fprintf(stderr, "Failed to size state file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    state = mmap(NULL, sizeof(t_state), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (state == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map state file %s: %s\n", path, strerror(errno));
+        state = NULL;
+        return EXIT_FAILURE;
+    }
+
+    if (!restored_valid)
+    {
+        memset(state, 0, sizeof(t_state));
+        state->magic = STATE_MAGIC;
+        state->version = STATE_VERSION;
+        state->size = sizeof(t_state);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void state_close(void)
+{
+    pthread_mutex_lock(&lock_state);
+    if (state != NULL)
+    {
+        munmap(state, sizeof(t_state));
+        state = NULL;
+    }
+    pthread_mutex_unlock(&lock_state);
+}
+
+bool state_restore_settings(t_state_settings *settings)
+{
+    if (!restored_valid || (restored.settings_seq & 1) || restored.settings_seq == 0)
+        return false;
+
+    *settings = restored.settings;
+    return true;
+}
+
+/**
+ * Restore averaging window, only if it was saved recently.
+ */
+bool state_restore_average(t_moving_avg *avg)
+{
+    int64_t age = (int64_t)time(NULL) - restored.average_time;
+
+    if (!restored_valid || (restored.average_seq & 1) || restored.average_seq == 0)
+        return false;
+    if (age < 0 || age > STATE_MAX_AGE)
+        return false;
+
+    *avg = restored.average;
+    return true;
+}
+
+/**
+ * Replay the wind samples of the longest rollup window into r.
+ * Samples are stored with wall clock time and moved to the monotonic clock,
+ * which restarts with a reboot. Returns the number of samples replayed.
+ */
+size_t state_restore_rollup(t_rollup *r)
+{
+    struct timespec ts_mono;
+    struct timespec ts_wall;
+    double now;
+    double offset;
+    double last = 0.0;
+    size_t n = 0;
+
+    if (!restored_valid || (restored.wind_seq & 1) || restored.wind_seq == 0 ||
+        restored.wind_count > STATE_WIND_LENGTH || restored.wind_next >= STATE_WIND_LENGTH)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts_mono);
+    clock_gettime(CLOCK_REALTIME, &ts_wall);
+    now = (double)ts_wall.tv_sec + (double)ts_wall.tv_nsec / 1e9;
+    offset = (double)ts_mono.tv_sec + (double)ts_mono.tv_nsec / 1e9 - now;
+
+    for (size_t i = 0; i < restored.wind_count; i++)
+    {
+        size_t slot = (restored.wind_next + STATE_WIND_LENGTH - restored.wind_count + i) % STATE_WIND_LENGTH;
+        const t_state_wind *w = &restored.wind[slot];
+
+        // Windows need ascending time, a clock step drops the samples before it
+        if (w->t <= last || w->t > now || now - w->t >= ROLLUP_MAX_LENGTH)
+            continue;
+        rollup_update(r, w->t + offset, w->windspeed, w->wind_direction);
+        last = w->t;
+        n++;
+    }
+    return n;
+}
+
+void state_save_settings(const t_state_settings *settings)
+{
+    pthread_mutex_lock(&lock_state);
+    if (state != NULL)
+    {
+        state->settings_seq++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->settings = *settings;
+        state->settings_time = (int64_t)time(NULL);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->settings_seq++;
+    }
+    pthread_mutex_unlock(&lock_state);
+}
+
+void state_save_average(const t_moving_avg *avg)
+{
+    pthread_mutex_lock(&lock_state);
+    if (state != NULL)
+    {
+        state->average_seq++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->average = *avg;
+        state->average_time = (int64_t)time(NULL);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->average_seq++;
+    }
+    pthread_mutex_unlock(&lock_state);
+}
+
+void state_save_wind(double t, double windspeed, unsigned short direction)
+{
+    pthread_mutex_lock(&lock_state);
+    if (state != NULL)
+    {
+        state->wind_seq++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->wind[state->wind_next] = (t_state_wind){t, windspeed, direction};
+        state->wind_next = (state->wind_next + 1) % STATE_WIND_LENGTH;
+        if (state->wind_count < STATE_WIND_LENGTH)
+            state->wind_count++;
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        state->wind_seq++;
+    }
+    pthread_mutex_unlock(&lock_state);
+}
@@ -0,0 +1,50 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+#include "average.h"
+#include "rollup.h"
+
+#define STATE_PATH "/var/lib/meteo/state"
+#define STATE_MAX_AGE MOVING_AVG_LENGTH // Averaging window older than this is discarded [s]
+#define STATE_WIND_LENGTH ((size_t)ROLLUP_MAX_LENGTH * ROLLUP_MAX_RATE + 1) // Wind samples of the longest rollup window
+
+/**
+ * Runway and recording settings surviving a restart.
+ */
+typedef struct
+{
+    unsigned short flight_number;
+    unsigned short runway_heading;
+    unsigned short runway_elevation;
+    unsigned char top_number;
+    unsigned char from_to_status;
+} t_state_settings;
+
+int state_open(const char *path);
+void state_close(void);
+bool state_restore_settings(t_state_settings *settings);
+bool state_restore_average(t_moving_avg *avg);
+size_t state_restore_rollup(t_rollup *r);
+void state_save_settings(const t_state_settings *settings);
+void state_save_average(const t_moving_avg *avg);
+void state_save_wind(double t, double windspeed, unsigned short direction);
+
+#endif /* STATE_H */
@@ -0,0 +1,164 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+#include <endian.h>
+#include "summary.h"
+#include "compliance.h"
+
+#define SUMMARY_HEADER_S(name, js_name, header, unit, value) ";" header "_MEAN;" header "_MIN;" header "_MAX"
+#define SUMMARY_UNIT_S(name, js_name, header, unit, value) ";" unit ";" unit ";" unit
+#define SUMMARY_VALUE_S(name, js_name, header, unit, value) value,
+
+#define SUMMARY_CSV_HEADER "FLIGHT;TOP;START;STOP;SECONDS;IN_LIMITS;GPS_3D;GPS_SATELLITES_MIN;GPS_HDOP_MAX" \
+    SUMMARY_FIELDS(SUMMARY_HEADER_S)
+#define SUMMARY_CSV_UNITS "#;#;HH:MM:SS;HH:MM:SS;s;%;%;#;#" SUMMARY_FIELDS(SUMMARY_UNIT_S)
+
+_Static_assert(sizeof(t_summary_event) == 32, "summary event layout changed");
+
+/**
+ * Clear the summary for a new run.
+ */
+void summary_start(t_summary *s, unsigned short flight_number, unsigned char top_number, time_t now)
+{
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->flight_number = flight_number;
+    s->top_number = top_number;
+    s->start = now;
+    s->stop = now;
+    s->gps_satellites_min = UINT8_MAX;
+    for (i = 0; i < SUMMARY_NUM_FIELDS; i++)
+    {
+        s->min[i] = DBL_MAX;
+        s->max[i] = -DBL_MAX;
+    }
+}
+
+/**
+ * Add one recorded row.
+ */
+void summary_update(t_summary *s, const t_packet_data *p)
+{
+    const double values[SUMMARY_NUM_FIELDS] = {SUMMARY_FIELDS(SUMMARY_VALUE_S)};
+    int i;
+
+    for (i = 0; i < SUMMARY_NUM_FIELDS; i++)
+    {
+        s->sum[i] += values[i];
+        if (values[i] < s->min[i])
+            s->min[i] = values[i];
+        if (values[i] > s->max[i])
+            s->max[i] = values[i];
+    }
+    s->seconds++;
+    if (p->compliance & COMPLIANCE_VALID)
+        s->seconds_valid++;
+    if (p->gps_mode >= SUMMARY_GPS_3D)
+    {
+        s->seconds_gps_3d++;
+        if (p->gps_satellites_used < s->gps_satellites_min)
+            s->gps_satellites_min = p->gps_satellites_used;
+        if (p->gps_hdop > s->gps_hdop_max)
+            s->gps_hdop_max = p->gps_hdop;
+    }
+}
+
+static double percent(unsigned int part, unsigned int whole)
+{
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+/**
+ * Write the summary as CSV with header, units and one row.
+ */
+int summary_write(const t_summary *s, const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    char start[16];
+    char stop[16];
+    struct tm tm;
+    int i;
+
+    if (fp == NULL)
+        return EXIT_FAILURE;
+    strftime(start, sizeof(start), "%H:%M:%S", localtime_r(&s->start, &tm));
+    strftime(stop, sizeof(stop), "%H:%M:%S", localtime_r(&s->stop, &tm));
+    fputs(SUMMARY_CSV_HEADER "\n" SUMMARY_CSV_UNITS "\n", fp);
+    fprintf(fp, "%u;%u;%s;%s;%u;%0.1f;%0.1f;%u;%0.1f",
+            s->flight_number, s->top_number, start, stop, s->seconds,
+            percent(s->seconds_valid, s->seconds), percent(s->seconds_gps_3d, s->seconds),
+            s->seconds_gps_3d > 0 ? s->gps_satellites_min : 0, s->gps_hdop_max);
+    for (i = 0; i < SUMMARY_NUM_FIELDS; i++)
+    {
+        if (s->seconds > 0)
+            fprintf(fp, ";%0.2f;%0.2f;%0.2f", s->sum[i] / s->seconds, s->min[i], s->max[i]);
+        else
+            fputs(";;;", fp);
+    }
+    fputc('\n', fp);
+    return fclose(fp) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void put_double(unsigned char *b, double v)
+{
+    uint64_t u;
+
+    memcpy(&u, &v, sizeof(u));
+    u = htole64(u);
+    memcpy(b, &u, sizeof(u));
+}
+
+/**
+ * Encode the summary event for clients.
+ * Returns the event length or 0 if buf is too small.
+ */
+size_t summary_encode(unsigned char *buf, size_t size, const t_summary *s)
+{
+    t_summary_event e;
+    unsigned char *b = buf + sizeof(e);
+    int i;
+
+    if (size < SUMMARY_EVENT_SIZE)
+        return 0;
+    memset(&e, 0, sizeof(e));
+    e.id = SERVER_EVT_SUMMARY;
+    e.top_number = s->top_number;
+    e.flight_number = htole16(s->flight_number);
+    e.start = htole32((uint32_t)s->start);
+    e.seconds = htole32(s->seconds);
+    e.seconds_valid = htole32(s->seconds_valid);
+    e.seconds_gps_3d = htole32(s->seconds_gps_3d);
+    e.gps_satellites_min = s->seconds_gps_3d > 0 ? s->gps_satellites_min : 0;
+    memcpy(buf, &e, sizeof(e));
+    put_double(buf + offsetof(t_summary_event, gps_hdop_max), s->gps_hdop_max);
+    for (i = 0; i < SUMMARY_NUM_FIELDS; i++)
+    {
+        bool any = s->seconds > 0;
+        put_double(b, any ? s->sum[i] / s->seconds : 0.0);
+        put_double(b + 8, any ? s->min[i] : 0.0);
+        put_double(b + 16, any ? s->max[i] : 0.0);
+        b += 24;
+    }
+    return SUMMARY_EVENT_SIZE;
+}
@@ -0,0 +1,76 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Running summary of a recording run, fields are SUMMARY_FIELDS in schema.h.
+//
+// Updated with every recorded row in constant memory. At stop it is written
+// next to the recording as a CSV file with header, units and one row, and
+// pushed to clients as SERVER_EVT_SUMMARY: a t_summary_event followed by
+// mean, minimum and maximum of every field as Float64, all little endian.
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "meteoserver.h"
+
+#define SUMMARY_KIND "Summary" // File name part, recordings use MeteoData
+#define SUMMARY_GPS_3D 3       // gpsd MODE_3D
+
+#define SUMMARY_COUNT_S(name, js_name, header, unit, value) +1
+#define SUMMARY_NUM_FIELDS (0 SUMMARY_FIELDS(SUMMARY_COUNT_S))
+
+typedef struct
+{
+    unsigned short flight_number;
+    unsigned char top_number;
+    time_t start;
+    time_t stop;
+    unsigned int seconds;        // Recorded rows
+    unsigned int seconds_valid;  // Rows within all limits
+    unsigned int seconds_gps_3d; // Rows with 3D GPS fix
+    unsigned char gps_satellites_min; // Satellites used, rows with 3D fix
+    double gps_hdop_max;              // Rows with 3D fix
+    double sum[SUMMARY_NUM_FIELDS];
+    double min[SUMMARY_NUM_FIELDS];
+    double max[SUMMARY_NUM_FIELDS];
+} t_summary;
+
+typedef struct __attribute__((__packed__))
+{
+    uint8_t id; // SERVER_EVT_SUMMARY
+    uint8_t top_number;
+    uint16_t flight_number;
+    uint32_t start; // UNIX time [s]
+    uint32_t seconds;
+    uint32_t seconds_valid;
+    uint32_t seconds_gps_3d;
+    uint8_t gps_satellites_min;
+    uint8_t reserved[3];
+    double gps_hdop_max;
+} t_summary_event;
+
+#define SUMMARY_EVENT_SIZE (sizeof(t_summary_event) + SUMMARY_NUM_FIELDS * 3 * sizeof(double))
+
+void summary_start(t_summary *s, unsigned short flight_number, unsigned char top_number, time_t now);
+void summary_update(t_summary *s, const t_packet_data *p);
+int summary_write(const t_summary *s, const char *path);
+size_t summary_encode(unsigned char *buf, size_t size, const t_summary *s);
+
+#endif /* SUMMARY_H */
@@ -42,7 +42,9 @@ struct timer_node
 };
 
 static void *_timer_thread(void *data);
+static void _set_timer(struct timer_node *node, unsigned int interval);
 static pthread_t g_thread_id;
+static int g_thread_started = 0;
 static struct timer_node *g_head = NULL;
 
 int initialize_timer()
@@ -52,6 +54,7 @@ int initialize_timer()
         /*Thread creation failed*/
         return 0;
     }
+    g_thread_started = 1;
 
     return 1;
 }
@@ -59,7 +62,6 @@ int initialize_timer()
 size_t start_timer(unsigned int interval, time_handler handler, t_timer type, void *user_data)
 {
     struct timer_node *new_node = NULL;
-    struct itimerspec new_value;
 
     new_node = (struct timer_node *)malloc(sizeof(struct timer_node));
 
@@ -79,10 +81,27 @@ size_t start_timer(unsigned int interval, time_handler handler, t_timer type, vo
         return 0;
     }
 
+    _set_timer(new_node, interval);
+
+    /*Inserting the timer node into the list*/
+    new_node->next = g_head;
+    g_head = new_node;
+
+    return (size_t)new_node;
+}
+
+/*
+ * Arm timer to expire after interval, periodic timers repeat with it.
+ * Interval 0 disarms the timer.
+ */
+static void _set_timer(struct timer_node *node, unsigned int interval)
+{
+    struct itimerspec new_value;
+
     new_value.it_value.tv_sec = interval / 1000;
     new_value.it_value.tv_nsec = (interval % 1000) * 1000000;
 
-    if (type == TIMER_PERIODIC)
+    if (node->type == TIMER_PERIODIC)
     {
         new_value.it_interval.tv_sec = interval / 1000;
         new_value.it_interval.tv_nsec = (interval % 1000) * 1000000;
@@ -93,13 +112,25 @@ size_t start_timer(unsigned int interval, time_handler handler, t_timer type, vo
         new_value.it_interval.tv_nsec = 0;
     }
 
-    timerfd_settime(new_node->fd, 0, &new_value, NULL);
+    timerfd_settime(node->fd, 0, &new_value, NULL);
+}
 
-    /*Inserting the timer node into the list*/
-    new_node->next = g_head;
-    g_head = new_node;
+void restart_timer(size_t timer_id, unsigned int interval)
+{
+    struct timer_node *node = (struct timer_node *)timer_id;
 
-    return (size_t)new_node;
+    if (node == NULL)
+        return;
+
+    node->interval = interval;
+    _set_timer(node, interval);
+}
+
+int timer_fd(size_t timer_id)
+{
+    struct timer_node *node = (struct timer_node *)timer_id;
+
+    return node != NULL ? node->fd : -1;
 }
 
 void stop_timer(size_t timer_id)
@@ -139,8 +170,12 @@ void finalize_timer()
     while (g_head)
         stop_timer((size_t)g_head);
 
-    pthread_cancel(g_thread_id);
-    pthread_join(g_thread_id, NULL);
+    if (g_thread_started)
+    {
+        pthread_cancel(g_thread_id);
+        pthread_join(g_thread_id, NULL);
+        g_thread_started = 0;
+    }
 }
 
 static struct timer_node *_get_timer_from_fd(int fd)
@@ -157,14 +192,27 @@ static struct timer_node *_get_timer_from_fd(int fd)
     return NULL;
 }
 
+void timer_dispatch(int fd)
+{
+    struct timer_node *tmp = NULL;
+    uint64_t exp;
+
+    if (read(fd, &exp, sizeof(uint64_t)) != sizeof(uint64_t))
+        return;
+
+    tmp = _get_timer_from_fd(fd);
+
+    if (tmp && tmp->callback)
+        tmp->callback((size_t)tmp, tmp->user_data);
+}
+
 void *_timer_thread(void *data)
 {
     NOTUSED(data);
     struct pollfd ufds[MAX_TIMER_COUNT] = {{0}};
     int iMaxCount = 0;
     struct timer_node *tmp = NULL;
-    int read_fds = 0, i, s;
-    uint64_t exp;
+    int read_fds = 0, i;
 
     while (1)
     {
@@ -192,17 +240,7 @@ void *_timer_thread(void *data)
         for (i = 0; i < iMaxCount; i++)
         {
             if (ufds[i].revents & POLLIN)
-            {
-                s = read(ufds[i].fd, &exp, sizeof(uint64_t));
-
-                if (s != sizeof(uint64_t))
-                    continue;
-
-                tmp = _get_timer_from_fd(ufds[i].fd);
-
-                if (tmp && tmp->callback)
-                    tmp->callback((size_t)tmp, tmp->user_data);
-            }
+                timer_dispatch(ufds[i].fd);
         }
     }
 
@@ -33,6 +33,10 @@ typedef void (*time_handler)(size_t timer_id, void *user_data);
 int initialize_timer();
 size_t start_timer(unsigned int interval, time_handler handler, t_timer type, void *user_data);
 void stop_timer(size_t timer_id);
+void restart_timer(size_t timer_id, unsigned int interval);
+// Without the timer thread, timers are run from an external event loop
+int timer_fd(size_t timer_id);
+void timer_dispatch(int fd);
 void finalize_timer();
 
 #endif
@@ -0,0 +1,27 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Semaphores of the static probes in trace.h. Tracers find them through the
+// probe notes and increment them while a probe is attached.
+
+#include "trace.h"
+
+#ifdef METEO_TRACE
+#define TRACE_DEFINE_X(name, args) \
+    volatile unsigned short TRACE_SEMAPHORE(name) __attribute__((unused, section(".probes")));
+TRACE_PROBES(TRACE_DEFINE_X)
+#endif
@@ -0,0 +1,79 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Static USDT probes, provider "meteo", for perf, bpftrace and systemtap.
+// Built in with -DMETEO_TRACE (make trace), which needs sys/sdt.h from
+// systemtap-sdt-dev. Every probe has a semaphore that the tracer raises on
+// attach, arguments and timestamps are only computed while a probe is attached.
+// Without METEO_TRACE the probes compile to nothing.
+
+// X(name, argument description)
+#define TRACE_PROBES(X)                                                      \
+    X(serial_line, "len, t_ns")           /* Line read from MAWS */          \
+    X(parse_ok, "len, t_ns")              /* MAWS line parsed */             \
+    X(parse_fail, "len, t_ns")            /* MAWS line rejected */           \
+    X(snapshot, "source, t_ns")           /* Packet data committed, 0 MAWS, 1 GPS */ \
+    X(publish_timer, "timer, pending, t_ns") /* Timer fired, 0 keepalive, 1 flush */ \
+    X(publish, "len, t_ns")               /* Packet stamped for all outputs */ \
+    X(client_write, "fd, len, written, t_ns") /* lws_write to one client */ \
+    X(record_row, "len, offset, t_ns")    /* Row appended to recording */
+
+#ifdef METEO_TRACE
+
+#include <time.h>
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define TRACE_SEMAPHORE(name) meteo_##name##_semaphore
+#define TRACE_DECLARE_X(name, args) extern volatile unsigned short TRACE_SEMAPHORE(name);
+TRACE_PROBES(TRACE_DECLARE_X)
+
+#define TRACE_ENABLED(name) __builtin_expect(TRACE_SEMAPHORE(name) != 0, 0)
+#define TRACE_SELECT(_1, _2, _3, _4, PROBE, ...) PROBE
+#define TRACE(name, ...)                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        if (TRACE_ENABLED(name))                                                                \
+            TRACE_SELECT(__VA_ARGS__, DTRACE_PROBE4, DTRACE_PROBE3, DTRACE_PROBE2, DTRACE_PROBE1) \
+            (meteo, name, __VA_ARGS__);                                                         \
+    } while (0)
+
+/**
+ * Monotonic time for probe arguments [ns].
+ */
+static inline long long trace_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#else
+
+#define TRACE_ENABLED(name) 0
+#define TRACE(name, ...) \
+    do                   \
+    {                    \
+    } while (0)
+
+#endif /* METEO_TRACE */
+
+#endif /* TRACE_H */
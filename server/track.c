@@ -0,0 +1,341 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <endian.h>
+#include <pthread.h>
+#include "track.h"
+
+#define TRACK_COUNT_T(name, scale, header, unit) +1
+
+_Static_assert((0 TRACK_FIELDS(TRACK_COUNT_T)) <= 8, "track fields exceed the presence byte");
+_Static_assert(sizeof(t_track_header) == 8, "track header layout changed");
+
+static FILE *track_fp = NULL;
+static pthread_t track_thread;
+static pthread_mutex_t track_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t track_cond = PTHREAD_COND_INITIALIZER;
+static t_track_fix track_queue[TRACK_QUEUE_SIZE];
+static unsigned int queue_head = 0; // Fixes queued
+static unsigned int queue_tail = 0; // Fixes taken by the writer
+static bool track_active = false;
+static bool track_exit = false;
+static bool track_write_error = false;
+static double track_last_time = 0.0;
+static t_track_codec track_codec;
+static t_track_stats track_stats;
+
+static unsigned char *put_varint(unsigned char *p, int64_t v)
+{
+    uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); // Zigzag, small magnitudes take few bytes
+
+    while (u >= 0x80)
+    {
+        *p++ = (unsigned char)(u | 0x80);
+        u >>= 7;
+    }
+    *p++ = (unsigned char)u;
+    return p;
+}
+
+static const unsigned char *get_varint(const unsigned char *p, const unsigned char *end, int64_t *v)
+{
+    uint64_t u = 0;
+    unsigned int shift = 0;
+
+    while (p < end && shift < 64)
+    {
+        unsigned char b = *p++;
+        u |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+/**
+ * Encode one fix into buf of at least TRACK_MAX_RECORD bytes.
+ * Returns the record length.
+ */
+size_t track_encode(t_track_codec *c, const t_track_fix *fix, unsigned char *buf)
+{
+    unsigned char *p = buf + 1;
+    unsigned int fields = 0;
+    unsigned int bit = 1;
+    int64_t time = llround(fix->time * 1000.0);
+    int64_t q;
+
+    p = put_varint(p, time - c->time);
+    c->time = time;
+    *p++ = fix->mode;
+    *p++ = fix->satellites;
+#define TRACK_ENCODE_T(name, scale, header, unit) \
+    if (isfinite(fix->name))                      \
+    {                                             \
+        q = llround(fix->name * scale);           \
+        p = put_varint(p, q - c->name);           \
+        c->name = q;                              \
+        fields |= bit;                            \
+    }                                             \
+    bit <<= 1;
+    TRACK_FIELDS(TRACK_ENCODE_T)
+    buf[0] = (unsigned char)fields;
+    return (size_t)(p - buf);
+}
+
+/**
+ * Decode one record from buf.
+ * Returns the record length, or 0 when buf holds no complete record.
+ */
+size_t track_decode(t_track_codec *c, const unsigned char *buf, size_t len, t_track_fix *fix)
+{
+    const unsigned char *p = buf;
+    const unsigned char *end = buf + len;
+    t_track_codec next = *c;
+    unsigned int fields;
+    unsigned int bit = 1;
+    int64_t d;
+
+    if (len < 1)
+        return 0;
+    fields = *p++;
+    p = get_varint(p, end, &d);
+    if (p == NULL || end - p < 2)
+        return 0;
+    next.time += d;
+    fix->time = (double)next.time / 1000.0;
+    fix->mode = *p++;
+    fix->satellites = *p++;
+#define TRACK_DECODE_T(name, scale, header, unit)     \
+    fix->name = NAN;                                  \
+    if (fields & bit)                                 \
+    {                                                 \
+        p = get_varint(p, end, &d);                   \
+        if (p == NULL)                                \
+            return 0;                                 \
+        next.name += d;                               \
+        fix->name = (double)next.name / scale;        \
+    }                                                 \
+    bit <<= 1;
+    TRACK_FIELDS(TRACK_DECODE_T)
+    *c = next;
+    return (size_t)(p - buf);
+}
+
+/**
+ * Encode and write queued fixes until the track is closed.
+ * Encoding and I/O run without the queue lock held.
+ */
+static void *track_write_thread(void *arg)
+{
+    t_track_fix batch[TRACK_QUEUE_SIZE];
+    unsigned char buf[TRACK_MAX_RECORD];
+    unsigned int n;
+    unsigned int i;
+
+    (void)arg;
+    pthread_mutex_lock(&track_lock);
+    for (;;)
+    {
+        while (queue_head == queue_tail && !track_exit)
+            pthread_cond_wait(&track_cond, &track_lock);
+        n = queue_head - queue_tail;
+        if (n == 0)
+            break; // Closed and drained
+        for (i = 0; i < n; i++)
+            batch[i] = track_queue[(queue_tail + i) % TRACK_QUEUE_SIZE];
+        queue_tail += n;
+        pthread_mutex_unlock(&track_lock);
+
+        for (i = 0; i < n; i++)
+        {
+            size_t len = track_encode(&track_codec, &batch[i], buf);
+            if (fwrite(buf, len, 1, track_fp) != 1)
+                track_write_error = true;
+            track_stats.bytes += len;
+        }
+        track_stats.fixes += n;
+        if (fflush(track_fp) != 0)
+            track_write_error = true;
+
+        pthread_mutex_lock(&track_lock);
+    }
+    pthread_mutex_unlock(&track_lock);
+    return NULL;
+}
+
+/**
+ * Create a track file and start its writer thread.
+ */
+int track_open(const char *path)
+{
+    t_track_header hdr;
+
+    if (track_is_open())
+        track_close(NULL);
+
+    memcpy(hdr.magic, TRACK_MAGIC, sizeof(hdr.magic));
+    hdr.version = htole16(TRACK_VERSION);
+    hdr.reserved = 0;
+    track_fp = fopen(path, "wb");
+    if (track_fp == NULL)
+        return EXIT_FAILURE;
+    if (fwrite(&hdr, sizeof(hdr), 1, track_fp) != 1)
+    {
+        fclose(track_fp);
+        track_fp = NULL;
+        return EXIT_FAILURE;
+    }
+
+    memset(&track_codec, 0, sizeof(track_codec));
+    memset(&track_stats, 0, sizeof(track_stats));
+    track_stats.bytes = sizeof(hdr);
+    track_write_error = false;
+    queue_head = 0;
+    queue_tail = 0;
+    track_last_time = 0.0;
+    track_exit = false;
+    if (pthread_create(&track_thread, NULL, track_write_thread, NULL) != 0)
+    {
+        fclose(track_fp);
+        track_fp = NULL;
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_lock(&track_lock);
+    track_active = true;
+    pthread_mutex_unlock(&track_lock);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Queue a fix for writing, never blocks on I/O.
+ * Fixes not newer than the last queued one are ignored, gpsd repeats the
+ * fix with every sky and device report. The fix is dropped when the queue
+ * is full.
+ */
+void track_push(const t_track_fix *fix)
+{
+    pthread_mutex_lock(&track_lock);
+    if (track_active && fix->time > track_last_time)
+    {
+        if (queue_head - queue_tail < TRACK_QUEUE_SIZE)
+        {
+            track_queue[queue_head % TRACK_QUEUE_SIZE] = *fix;
+            queue_head++;
+            track_last_time = fix->time;
+            pthread_cond_signal(&track_cond);
+        }
+        else
+        {
+            track_stats.dropped++;
+        }
+    }
+    pthread_mutex_unlock(&track_lock);
+}
+
+/**
+ * Write remaining fixes and close the track file.
+ */
+void track_close(t_track_stats *stats)
+{
+    pthread_mutex_lock(&track_lock);
+    if (!track_active)
+    {
+        pthread_mutex_unlock(&track_lock);
+        return;
+    }
+    track_active = false;
+    track_exit = true;
+    pthread_cond_signal(&track_cond);
+    pthread_mutex_unlock(&track_lock);
+
+    pthread_join(track_thread, NULL);
+    if (fclose(track_fp) != 0 || track_write_error)
+        fprintf(stderr, "Error writing GPS track\n");
+    track_fp = NULL;
+    if (stats != NULL)
+        *stats = track_stats;
+}
+
+bool track_is_open(void)
+{
+    bool active;
+
+    pthread_mutex_lock(&track_lock);
+    active = track_active;
+    pthread_mutex_unlock(&track_lock);
+    return active;
+}
+
+/**
+ * Decode a track file and call cb for every fix.
+ */
+int track_read(const char *path, t_track_callback cb, void *user)
+{
+    FILE *fp = fopen(path, "rb");
+    t_track_header hdr;
+    t_track_codec codec;
+    t_track_fix fix;
+    unsigned char *buf;
+    long size;
+    size_t len;
+    size_t pos = 0;
+    size_t used;
+
+    if (fp == NULL)
+        return EXIT_FAILURE;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, TRACK_MAGIC, sizeof(hdr.magic)) != 0 ||
+        le16toh(hdr.version) != TRACK_VERSION)
+    {
+        fprintf(stderr, "%s is not a track file of this version\n", path);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    // Tracks are small, about 60 kB per hour at 1 Hz
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 || fseek(fp, sizeof(hdr), SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    len = (size_t)size - sizeof(hdr);
+    buf = malloc(len > 0 ? len : 1);
+    if (buf == NULL || fread(buf, 1, len, fp) != len)
+    {
+        free(buf);
+        fclose(fp);
+        return EXIT_FAILURE;
+    }
+    fclose(fp);
+
+    memset(&codec, 0, sizeof(codec));
+    while ((used = track_decode(&codec, buf + pos, len - pos, &fix)) > 0)
+    {
+        pos += used;
+        if (cb(&fix, user) != 0)
+            break;
+    }
+    if (used == 0 && pos < len)
+        fprintf(stderr, "Ignoring %zu bytes of incomplete record at end of %s\n", len - pos, path);
+    free(buf);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,112 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// GPS track of a recording run.
+//
+// Every new gpsd fix during a run is queued by track_push() and written by
+// a writer thread, so file I/O never delays the GPS or MAWS input. A track
+// file, F0001_REC001_Track_HHMMSS.trk next to the recording, starts with a
+// t_track_header followed by one variable length record per fix:
+//
+//     fields   1 byte, bit i set when TRACK_FIELDS entry i is present
+//     time     zigzag varint, delta to previous fix [ms]
+//     mode     1 byte, gpsd fix mode
+//     sats     1 byte, satellites used
+//     values   zigzag varint per present field, delta of the quantized
+//              value to the last present value of that field
+//
+// The first record holds deltas to zero. A fix at 1 Hz takes 12 to 20 bytes.
+// A record cut off by a crash at the end of the file is ignored by the reader.
+
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define TRACK_KIND "Track" // File name part, recordings use MeteoData
+#define TRACK_SUFFIX ".trk"
+#define TRACK_MAGIC "MTRK"
+#define TRACK_VERSION 1
+#define TRACK_QUEUE_SIZE 64   // Fixes queued for the writer thread
+#define TRACK_MAX_RECORD 96   // Longest encoded record [Byte]
+
+// Recorded fields, T(name, quantization scale, CSV header, unit)
+#define TRACK_FIELDS(T)                     \
+    T(latitude, 1e7, "LAT", "deg")          \
+    T(longitude, 1e7, "LON", "deg")         \
+    T(altitude, 100.0, "ALT_MSL", "m")      \
+    T(speed, 100.0, "SPEED", "m/s")         \
+    T(course, 100.0, "COURSE", "deg")       \
+    T(hdop, 100.0, "HDOP", "#")             \
+    T(vdop, 100.0, "VDOP", "#")             \
+    T(pdop, 100.0, "PDOP", "#")
+
+#define TRACK_FIX_T(name, scale, header, unit) double name;
+#define TRACK_CODEC_T(name, scale, header, unit) int64_t name;
+
+/**
+ * One fix, absent fields are NaN.
+ */
+typedef struct
+{
+    double time; // UNIX time, UTC [s]
+    unsigned char mode;
+    unsigned char satellites;
+    TRACK_FIELDS(TRACK_FIX_T)
+} t_track_fix;
+
+/**
+ * Last values written or read, deltas are taken against them.
+ */
+typedef struct
+{
+    int64_t time; // [ms]
+    TRACK_FIELDS(TRACK_CODEC_T)
+} t_track_codec;
+
+typedef struct
+{
+    char magic[4];
+    uint16_t version;  // Little endian
+    uint16_t reserved;
+} t_track_header;
+
+typedef struct
+{
+    unsigned long fixes;
+    unsigned long dropped; // Queue was full
+    unsigned long bytes;
+} t_track_stats;
+
+typedef int (*t_track_callback)(const t_track_fix *fix, void *user);
+
+// Codec
+size_t track_encode(t_track_codec *c, const t_track_fix *fix, unsigned char *buf);
+size_t track_decode(t_track_codec *c, const unsigned char *buf, size_t len, t_track_fix *fix);
+
+// Writer, used by meteoserver
+int track_open(const char *path);
+void track_push(const t_track_fix *fix);
+void track_close(t_track_stats *stats);
+bool track_is_open(void);
+
+// Reader, cb returns non-zero to stop
+int track_read(const char *path, t_track_callback cb, void *user);
+
+#endif /* TRACK_H */
@@ -0,0 +1,140 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Export a GPS track recorded by meteoserver as CSV or GPX.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include "track.h"
+
+#define TRACK_HEADER_T(name, scale, header, unit) ";" header
+#define TRACK_UNIT_T(name, scale, header, unit) ";" unit
+#define TRACK_PRINT_T(name, scale, header, unit) \
+    if (isnan(fix->name))                        \
+        fputs(";", stdout);                      \
+    else                                         \
+        printf(";%.*f", (int)log10(scale), fix->name);
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] track.trk\n"
+            "  -f FORMAT     csv or gpx [default: csv]\n",
+            name);
+}
+
+static void format_time(char *buf, size_t size, double t)
+{
+    time_t sec = (time_t)floor(t);
+    struct tm tm;
+    size_t len;
+
+    gmtime_r(&sec, &tm);
+    len = strftime(buf, size, "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + len, size - len, ".%03dZ", (int)lround((t - (double)sec) * 1000.0) % 1000);
+}
+
+static int print_csv(const t_track_fix *fix, void *user)
+{
+    char date[40];
+
+    (void)user;
+    format_time(date, sizeof(date), fix->time);
+    printf("%s;%.3f;%u;%u", date, fix->time, fix->mode, fix->satellites);
+    TRACK_FIELDS(TRACK_PRINT_T)
+    putchar('\n');
+    return 0;
+}
+
+static int print_gpx(const t_track_fix *fix, void *user)
+{
+    static const char *const fix_names[] = {"none", "none", "2d", "3d"};
+    char date[40];
+
+    (void)user;
+    if (isnan(fix->latitude) || isnan(fix->longitude))
+        return 0;
+    format_time(date, sizeof(date), fix->time);
+    printf("<trkpt lat=\"%.7f\" lon=\"%.7f\">", fix->latitude, fix->longitude);
+    if (!isnan(fix->altitude))
+        printf("<ele>%.2f</ele>", fix->altitude);
+    printf("<time>%s</time>", date);
+    if (fix->mode < sizeof(fix_names) / sizeof(fix_names[0]))
+        printf("<fix>%s</fix>", fix_names[fix->mode]);
+    printf("<sat>%u</sat>", fix->satellites);
+    if (!isnan(fix->hdop))
+        printf("<hdop>%.2f</hdop>", fix->hdop);
+    if (!isnan(fix->vdop))
+        printf("<vdop>%.2f</vdop>", fix->vdop);
+    if (!isnan(fix->pdop))
+        printf("<pdop>%.2f</pdop>", fix->pdop);
+    puts("</trkpt>");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool gpx = false;
+    int rc;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (strcmp(optarg, "gpx") == 0)
+                gpx = true;
+            else if (strcmp(optarg, "csv") == 0)
+                gpx = false;
+            else
+            {
+                fprintf(stderr, "Unknown format %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (gpx)
+    {
+        printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+               "<gpx version=\"1.1\" creator=\"meteo\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n"
+               "<trk><trkseg>\n");
+        rc = track_read(argv[optind], print_gpx, NULL);
+        puts("</trkseg></trk>\n</gpx>");
+    }
+    else
+    {
+        puts("UTC;EPOCH;MODE;SATS" TRACK_FIELDS(TRACK_HEADER_T));
+        puts("YYYY-MM-DDTHH:MM:SS;s;#;#" TRACK_FIELDS(TRACK_UNIT_T));
+        rc = track_read(argv[optind], print_csv, NULL);
+    }
+    return rc;
+}
@@ -0,0 +1,471 @@
+// Part of WebMeteo, a Vaisalla weather data visualization.
+//
+// Copyright (c) 2021 Michael Wolf <michael@mictronics.de>
+//
+// This file is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// any later version.
+//
+// This file is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+// Websocket load generator for meteoserver.
+// Opens N broadcast protocol connections, decodes every frame and compares
+// the embedded send time (local_time) with the receive time. Reports latency
+// percentiles and frame loss per client, plus server CPU usage when a pid
+// is given. Lost frames are gaps in the publish sequence number, publishes
+// missed while a client reconnects are not counted. Slow readers pause reception with rx flow control and churn
+// closes and reopens random connections while the test runs.
+
+#include <libwebsockets.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include <stdbool.h>
+#include "meteoserver.h"
+
+#define NOTUSED(V) ((void)V)
+
+typedef struct
+{
+    struct lws *wsi;
+    bool connected;
+    bool slow;
+    bool close_pending;
+    double paused_until;
+    bool seq_valid;
+    unsigned int last_seq; // publish_seq of the last frame
+    unsigned long frames;
+    unsigned long lost;
+    unsigned long errors;
+    unsigned long connects;
+    unsigned long short_frames;
+    unsigned long events;
+    double *latency;   // Latency samples in ms
+    size_t num_latency;
+    size_t max_latency;
+    unsigned char rx[sizeof(t_packet_data)];
+    size_t rx_len;
+} t_client;
+
+static const char *host = "127.0.0.1";
+static int port = 8080;
+static int num_clients = 10;
+static double duration = 10.0;         // Test duration in seconds
+static double slow_fraction = 0.0;     // Fraction of slow reading clients
+static double slow_pause = 1.0;        // Reception pause of slow clients in seconds
+static double churn_rate = 0.0;        // Reconnects per second
+static int server_pid = 0;
+
+static struct lws_context *context;
+static t_client *clients;
+static volatile sig_atomic_t interrupted = 0;
+
+static double now_realtime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void sighandler(int sig)
+{
+    NOTUSED(sig);
+    interrupted = 1;
+}
+
+static void add_latency(t_client *c, double ms)
+{
+    if (c->num_latency == c->max_latency)
+    {
+        size_t n = c->max_latency ? c->max_latency * 2 : 256;
+        double *p = realloc(c->latency, n * sizeof(double));
+        if (p == NULL)
+            return;
+        c->latency = p;
+        c->max_latency = n;
+    }
+    c->latency[c->num_latency++] = ms;
+}
+
+static void handle_frame(t_client *c)
+{
+    t_packet_data p;
+    double rx_time = now_realtime();
+
+    memcpy(&p, c->rx, sizeof(p));
+    c->frames++;
+    if (p.local_time <= 0.0)
+        return;
+
+    add_latency(c, (rx_time - p.local_time) * 1000.0);
+    // Every publish is sent to every client, a gap is a publish this client missed
+    if (c->seq_valid && p.publish_seq - c->last_seq > 1)
+        c->lost += p.publish_seq - c->last_seq - 1;
+    c->seq_valid = true;
+    c->last_seq = p.publish_seq;
+}
+
+static int callback_client(struct lws *wsi, enum lws_callback_reasons reason,
+                           void *user, void *in, size_t len)
+{
+    NOTUSED(user);
+    t_client *c = NULL;
+
+    for (int i = 0; i < num_clients; i++)
+    {
+        if (clients[i].wsi == wsi)
+        {
+            c = &clients[i];
+            break;
+        }
+    }
+
+    switch (reason)
+    {
+    case LWS_CALLBACK_CLIENT_ESTABLISHED:
+        if (c != NULL)
+        {
+            c->connected = true;
+            c->connects++;
+            c->rx_len = 0;
+        }
+        break;
+
+    case LWS_CALLBACK_CLIENT_RECEIVE:
+        if (c == NULL)
+            break;
+        if (lws_is_first_fragment(wsi))
+            c->rx_len = 0;
+        if (c->rx_len + len <= sizeof(c->rx))
+            memcpy(&c->rx[c->rx_len], in, len);
+        c->rx_len += len;
+        if (lws_is_final_fragment(wsi))
+        {
+            // Compliance and summary events are shorter than a packet and carry no send time
+            if (c->rx_len > 0 && c->rx_len < sizeof(t_packet_data) &&
+                (c->rx[0] == SERVER_EVT_COMPLIANCE || c->rx[0] == SERVER_EVT_SUMMARY))
+                c->events++;
+            else if (c->rx_len >= sizeof(t_packet_data))
+                handle_frame(c);
+            else
+                c->short_frames++;
+            c->rx_len = 0;
+        }
+        break;
+
+    case LWS_CALLBACK_CLIENT_WRITEABLE:
+        // Used to close a connection from outside the callback
+        if (c != NULL && c->close_pending)
+            return -1;
+        break;
+
+    case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+        if (c != NULL)
+        {
+            c->errors++;
+            c->connected = false;
+            c->wsi = NULL;
+        }
+        break;
+
+    case LWS_CALLBACK_CLIENT_CLOSED:
+        if (c != NULL)
+        {
+            c->connected = false;
+            c->close_pending = false;
+            c->wsi = NULL;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+static struct lws_protocols protocols[] = {
+    {"broadcast",
+     callback_client,
+     0,
+     512,
+     0, NULL, 0},
+    {NULL, NULL, 0, 0, 0, NULL, 0} /* terminator */
+};
+
+static void connect_client(t_client *c)
+{
+    struct lws_client_connect_info i;
+
+    memset(&i, 0, sizeof(i));
+    i.context = context;
+    i.address = host;
+    i.port = port;
+    i.path = "/";
+    i.host = host;
+    i.origin = host;
+    i.protocol = protocols[0].name;
+    i.pwsi = &c->wsi;
+    c->seq_valid = false;
+    lws_client_connect_via_info(&i);
+}
+
+/**
+ * Read utime + stime of a process in clock ticks.
+ */
+static long long process_cpu_ticks(int pid)
+{
+    char path[64];
+    char buf[1024];
+    long long utime = 0, stime = 0;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    if (fgets(buf, sizeof(buf), fp) == NULL)
+    {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    // Skip pid and comm, which may contain spaces
+    char *p = strrchr(buf, ')');
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lld %lld", &utime, &stime) != 2)
+        return -1;
+    return utime + stime;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return NAN;
+    size_t i = (size_t)ceil(p / 100.0 * (double)n);
+    return sorted[i > 0 ? i - 1 : 0];
+}
+
+static void report(double elapsed, long long cpu_ticks)
+{
+    size_t total = 0;
+    unsigned long frames = 0, lost = 0, errors = 0, connects = 0, short_frames = 0, events = 0;
+
+    for (int i = 0; i < num_clients; i++)
+        total += clients[i].num_latency;
+
+    double *all = malloc((total ? total : 1) * sizeof(double));
+    size_t k = 0;
+
+    for (int i = 0; i < num_clients; i++)
+    {
+        t_client *c = &clients[i];
+        qsort(c->latency, c->num_latency, sizeof(double), compare_double);
+        printf("{\"client\":%d,\"slow\":%s,\"connects\":%lu,\"errors\":%lu,\"frames\":%lu,\"lost\":%lu,"
+               "\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}\n",
+               i, c->slow ? "true" : "false", c->connects, c->errors, c->frames, c->lost,
+               percentile(c->latency, c->num_latency, 50.0),
+               percentile(c->latency, c->num_latency, 90.0),
+               percentile(c->latency, c->num_latency, 99.0),
+               percentile(c->latency, c->num_latency, 100.0));
+        if (all != NULL)
+        {
+            memcpy(&all[k], c->latency, c->num_latency * sizeof(double));
+            k += c->num_latency;
+        }
+        frames += c->frames;
+        lost += c->lost;
+        errors += c->errors;
+        connects += c->connects;
+        short_frames += c->short_frames;
+        events += c->events;
+    }
+
+    if (all != NULL)
+        qsort(all, k, sizeof(double), compare_double);
+    printf("{\"summary\":true,\"clients\":%d,\"elapsed_s\":%.3f,\"connects\":%lu,\"errors\":%lu,"
+           "\"frames\":%lu,\"short_frames\":%lu,\"events\":%lu,\"lost\":%lu,\"loss_pct\":%.3f,"
+           "\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f",
+           num_clients, elapsed, connects, errors, frames, short_frames, events, lost,
+           frames + lost ? 100.0 * (double)lost / (double)(frames + lost) : 0.0,
+           percentile(all, k, 50.0), percentile(all, k, 90.0),
+           percentile(all, k, 99.0), percentile(all, k, 100.0));
+    if (cpu_ticks >= 0)
+        printf(",\"server_cpu_pct\":%.2f", 100.0 * (double)cpu_ticks / (double)sysconf(_SC_CLK_TCK) / elapsed);
+    printf("}\n");
+    free(all);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -a host      Server address [default: 127.0.0.1]\n"
+            "  -p port      Server port [default: 8080]\n"
+            "  -n clients   Number of connections [default: 10]\n"
+            "  -d seconds   Test duration [default: 10]\n"
+            "  -s fraction  Fraction of slow reading clients [0..1]\n"
+            "  -w seconds   Reception pause of slow clients [default: 1]\n"
+            "  -c rate      Reconnects per second [default: 0]\n"
+            "  -P pid       Server pid for CPU usage\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    struct lws_context_creation_info info;
+    int opt;
+    long long cpu_start = -1, cpu_end = -1;
+
+    while ((opt = getopt(argc, argv, "a:p:n:d:s:w:c:P:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            host = optarg;
+            break;
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'n':
+            num_clients = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 's':
+            slow_fraction = atof(optarg);
+            break;
+        case 'w':
+            slow_pause = atof(optarg);
+            break;
+        case 'c':
+            churn_rate = atof(optarg);
+            break;
+        case 'P':
+            server_pid = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (num_clients <= 0)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    clients = calloc((size_t)num_clients, sizeof(t_client));
+    if (clients == NULL)
+        return EXIT_FAILURE;
+
+    signal(SIGINT, sighandler);
+    lws_set_log_level(LLL_ERR, NULL);
+
+    memset(&info, 0, sizeof(info));
+    info.port = CONTEXT_PORT_NO_LISTEN;
+    info.protocols = protocols;
+    info.gid = -1;
+    info.uid = -1;
+    context = lws_create_context(&info);
+    if (context == NULL)
+    {
+        fprintf(stderr, "lws init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+    for (int i = 0; i < num_clients; i++)
+    {
+        clients[i].slow = i < (int)lround(slow_fraction * num_clients);
+        connect_client(&clients[i]);
+    }
+
+    if (server_pid > 0)
+        cpu_start = process_cpu_ticks(server_pid);
+
+    double start = now_realtime();
+    double next_churn = start + (churn_rate > 0.0 ? 1.0 / churn_rate : 0.0);
+    double now = start;
+
+    while (!interrupted && now - start < duration)
+    {
+        lws_service(context, 10);
+        now = now_realtime();
+
+        for (int i = 0; i < num_clients; i++)
+        {
+            t_client *c = &clients[i];
+            if (!c->connected)
+            {
+                // Reconnect lost clients
+                if (c->wsi == NULL)
+                    connect_client(c);
+                continue;
+            }
+            if (c->slow)
+            {
+                // Alternate between reading and not reading for slow_pause
+                if (c->paused_until == 0.0)
+                {
+                    c->paused_until = now + slow_pause;
+                    lws_rx_flow_control(c->wsi, 0);
+                }
+                else if (now >= c->paused_until && now < c->paused_until + slow_pause)
+                {
+                    lws_rx_flow_control(c->wsi, 1);
+                }
+                else if (now >= c->paused_until + slow_pause)
+                {
+                    c->paused_until = 0.0;
+                }
+            }
+        }
+
+        if (churn_rate > 0.0 && now >= next_churn)
+        {
+            t_client *c = &clients[rand() % num_clients];
+            if (c->connected && c->wsi != NULL)
+            {
+                c->close_pending = true;
+                lws_callback_on_writable(c->wsi);
+            }
+            next_churn += 1.0 / churn_rate;
+        }
+    }
+
+    if (server_pid > 0 && cpu_start >= 0)
+    {
+        cpu_end = process_cpu_ticks(server_pid);
+        if (cpu_end >= 0)
+            cpu_end -= cpu_start;
+    }
+
+    report(now - start, cpu_end);
+
+    lws_context_destroy(context);
+    for (int i = 0; i < num_clients; i++)
+        free(clients[i].latency);
+    free(clients);
+
+    return EXIT_SUCCESS;
+}